@@ -0,0 +1,734 @@
+/****************************************************
+ * 2016-2020 Eric Bachmann and Mike Zmuda
+ * All Rights Reserved.
+ * NOTICE:
+ * Dissemination of this information or reproduction
+ * of this material is prohibited unless prior written
+ * permission is granted..
+ ****************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include "BVH.h"
+#include "RenderStats.h"
+
+bool BVH::logBuilds = false;
+
+/**
+ * @fn	BVH::BVH()
+ * @brief	Constructs an empty hierarchy.
+ */
+
+BVH::BVH() {
+	buildTimeMs = 0.0;
+	maxDepth = 0;
+}
+
+/**
+ * @fn	LayeredHit::LayeredHit(const HitRecord &opaqueHit, const HitRecord &transparentHit)
+ * @brief	Constructs the layers known from a closest opaque and a closest transparent
+ * 			hit found separately. If the transparent hit is in front, it is the only
+ * 			layer, and nothing beyond it is known.
+ * @param	opaqueHit	  	Closest opaque hit.
+ * @param	transparentHit	Closest transparent hit.
+ */
+
+LayeredHit::LayeredHit(const HitRecord &opaqueHit, const HitRecord &transparentHit)
+	: opaque(opaqueHit), numLayers(0), tComplete(FLT_MAX) {
+	if (transparentHit.t < opaqueHit.t) {
+		layers[numLayers++] = transparentHit;
+		tComplete = transparentHit.t;
+	}
+}
+
+/**
+ * @struct	BVH::LayerSearch
+ * @brief	The state of a findLayers traversal: the closest opaque hit so far and the
+ * 			nearest transparent crossings in front of it.
+ */
+
+struct BVH::LayerSearch {
+	double opaqueT = FLT_MAX;
+	const VisibleIShape *opaque = nullptr;
+	Layer layers[LayeredHit::MAX_LAYERS];
+	int numLayers = 0;
+	double tComplete = FLT_MAX;
+
+	/** Hits at or beyond this distance cannot change the result. */
+	double limit() const { return std::min(opaqueT, tComplete); }
+
+	/** Inserts a crossing closer than limit(), dropping the farthest if full. */
+	void addLayer(double t, const VisibleIShape *surface) {
+		int i = numLayers < LayeredHit::MAX_LAYERS ? numLayers++ : LayeredHit::MAX_LAYERS - 1;
+		while (i > 0 && layers[i - 1].t > t) {
+			layers[i] = layers[i - 1];
+			i--;
+		}
+		layers[i] = { t, surface };
+		if (numLayers == LayeredHit::MAX_LAYERS) {
+			tComplete = std::min(tComplete, layers[numLayers - 1].t);
+		}
+	}
+};
+
+/**
+ * @fn	void BVH::build(const vector<VisibleIShapePtr> &surfaces)
+ * @brief	(Re)builds the hierarchy over a set of opaque surfaces.
+ * @param	surfaces	The surfaces to organize.
+ */
+
+void BVH::build(const vector<VisibleIShapePtr> &surfaces) {
+	build(surfaces, vector<VisibleIShapePtr>());
+}
+
+/**
+ * @fn	void BVH::build(const vector<VisibleIShapePtr> &surfaces, const vector<VisibleIShapePtr> &transparentSurfaces)
+ * @brief	(Re)builds the hierarchy over a set of opaque and a set of transparent
+ * 			surfaces. Surfaces that cannot be bounded are set aside and tested linearly.
+ * @param	surfaces		   	The opaque surfaces to organize.
+ * @param	transparentSurfaces	The transparent surfaces to organize.
+ */
+
+void BVH::build(const vector<VisibleIShapePtr> &surfaces, const vector<VisibleIShapePtr> &transparentSurfaces) {
+	auto startTime = std::chrono::steady_clock::now();
+
+	nodes.clear();
+	spans.clear();
+	objects.clear();
+	unbounded.clear();
+	unboundedTransparent.clear();
+	transparentObjects.assign(transparentSurfaces.begin(), transparentSurfaces.end());
+	std::sort(transparentObjects.begin(), transparentObjects.end());
+	maxDepth = 0;
+
+	vector<BuildItem> items;
+	const vector<VisibleIShapePtr> *lists[2] = { &surfaces, &transparentSurfaces };
+	for (int transparent = 0; transparent < 2; transparent++) {
+		for (VisibleIShapePtr surface : *lists[transparent]) {
+			BuildItem item;
+			if (surface->shape->getBounds(item.box)) {
+				item.centroid = item.box.centroid();
+				item.surface = surface;
+				item.type = CompiledScene::classify(surface->shape);
+				item.transparent = transparent == 1;
+				items.push_back(item);
+			} else if (transparent == 1) {
+				unboundedTransparent.add(surface);
+			} else {
+				unbounded.add(surface);
+			}
+		}
+	}
+
+	if (!items.empty()) {
+		nodes.reserve(2 * items.size());
+		nodes.push_back(BVHNode());
+		buildNode(0, items, 0, (int)items.size(), 1);
+		compileLeaves(items);
+	}
+
+	auto endTime = std::chrono::steady_clock::now();
+	buildTimeMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+}
+
+/**
+ * @fn	void BVH::buildNode(int nodeIndex, vector<BuildItem> &items, int first, int count, int depth)
+ * @brief	Fills in a node covering items[first, first+count), splitting it when the
+ * 			surface area heuristic says that two children are cheaper than a leaf.
+ * @param 		  	nodeIndex	Index of the node being built.
+ * @param [in,out]	items	 	The build items; reordered so the node's items are contiguous.
+ * @param 		  	first	 	First item covered by this node.
+ * @param 		  	count	 	Number of items covered by this node.
+ * @param 		  	depth	 	Depth of this node; the root is at depth 1.
+ */
+
+void BVH::buildNode(int nodeIndex, vector<BuildItem> &items, int first, int count, int depth) {
+	maxDepth = std::max(maxDepth, depth);
+
+	AABB box, centroidBox;
+	for (int i = first; i < first + count; i++) {
+		box.expand(items[i].box);
+		centroidBox.expand(items[i].centroid);
+	}
+	nodes[nodeIndex].box = box;
+	nodes[nodeIndex].leftOrFirst = first;
+	nodes[nodeIndex].count = count;
+
+	int axis = centroidBox.longestAxis();
+	double cMin = centroidBox.lo[axis];
+	double cExtent = centroidBox.hi[axis] - cMin;
+	if (count <= MAX_LEAF_SIZE || depth >= MAX_DEPTH - 1 || cExtent <= 0.0) {
+		return;
+	}
+
+	// Bin the centroids along each axis and find the cheapest split plane.
+	double bestCost = DBL_MAX;
+	int bestAxis = -1;
+	int bestBin = 0;
+	for (int a = 0; a < 3; a++) {
+		double lo = centroidBox.lo[a];
+		double extent = centroidBox.hi[a] - lo;
+		if (extent <= 0.0) {
+			continue;
+		}
+		AABB binBoxes[NUM_BINS];
+		int binCounts[NUM_BINS] = { 0 };
+		double scale = NUM_BINS / extent;
+		for (int i = first; i < first + count; i++) {
+			int b = std::min(NUM_BINS - 1, (int)((items[i].centroid[a] - lo) * scale));
+			binCounts[b]++;
+			binBoxes[b].expand(items[i].box);
+		}
+
+		double rightArea[NUM_BINS];
+		int rightCount[NUM_BINS];
+		AABB rightBox;
+		int rightSum = 0;
+		for (int b = NUM_BINS - 1; b > 0; b--) {
+			rightBox.expand(binBoxes[b]);
+			rightSum += binCounts[b];
+			rightArea[b] = rightBox.surfaceArea();
+			rightCount[b] = rightSum;
+		}
+
+		AABB leftBox;
+		int leftSum = 0;
+		for (int b = 0; b < NUM_BINS - 1; b++) {
+			leftBox.expand(binBoxes[b]);
+			leftSum += binCounts[b];
+			if (leftSum == 0 || rightCount[b + 1] == 0) {
+				continue;
+			}
+			double cost = leftSum * leftBox.surfaceArea() + rightCount[b + 1] * rightArea[b + 1];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = a;
+				bestBin = b;
+			}
+		}
+	}
+
+	// Traversal cost is taken as 1 and each object test as 1, relative to this node's area.
+	double parentArea = box.surfaceArea();
+	double splitCost = parentArea > 0.0 ? 1.0 + bestCost / parentArea : DBL_MAX;
+	if (bestAxis < 0 || splitCost >= count) {
+		return;
+	}
+
+	double lo = centroidBox.lo[bestAxis];
+	double scale = NUM_BINS / (centroidBox.hi[bestAxis] - lo);
+	BuildItem *middle = std::partition(items.data() + first, items.data() + first + count,
+		[&](const BuildItem &item) {
+			int b = std::min(NUM_BINS - 1, (int)((item.centroid[bestAxis] - lo) * scale));
+			return b <= bestBin;
+		});
+	int leftCount = (int)(middle - (items.data() + first));
+	if (leftCount == 0 || leftCount == count) {
+		return;
+	}
+
+	int leftIndex = (int)nodes.size();
+	nodes.push_back(BVHNode());
+	nodes.push_back(BVHNode());
+	nodes[nodeIndex].leftOrFirst = leftIndex;
+	nodes[nodeIndex].count = 0;
+	buildNode(leftIndex, items, first, leftCount, depth + 1);
+	buildNode(leftIndex + 1, items, first + leftCount, count - leftCount, depth + 1);
+}
+
+/**
+ * @fn	void BVH::compileLeaves(vector<BuildItem> &items)
+ * @brief	Copies the objects into the compiled blocks, leaf by leaf. Each leaf's
+ * 			objects are grouped by transparency and type, and each group becomes one
+ * 			span, so a leaf is tested with one tight loop per type.
+ * @param [in,out]	items	The build items; each leaf's items are reordered by type.
+ */
+
+void BVH::compileLeaves(vector<BuildItem> &items) {
+	for (BVHNode &node : nodes) {
+		if (!node.isLeaf()) {
+			continue;
+		}
+		BuildItem *first = items.data() + node.leftOrFirst;
+		BuildItem *last = first + node.count;
+		std::stable_sort(first, last, [](const BuildItem &a, const BuildItem &b) {
+			return a.transparent != b.transparent ? b.transparent : a.type < b.type;
+		});
+
+		int firstSpan = (int)spans.size();
+		for (BuildItem *item = first; item != last; item++) {
+			CompiledSpan span = objects.add(item->surface);
+			span.transparent = item->transparent;
+			if ((int)spans.size() > firstSpan && spans.back().type == span.type &&
+				spans.back().transparent == span.transparent) {
+				spans.back().count++;
+			} else {
+				spans.push_back(span);
+			}
+		}
+		node.leftOrFirst = firstSpan;
+		node.count = (int)spans.size() - firstSpan;
+	}
+}
+
+/**
+ * @fn	double BVH::intersectBox(const AABB &box, const dvec3 &origin, const dvec3 &invDir, double tMax)
+ * @brief	Slab test between a ray and a box.
+ * @param	box   	The box.
+ * @param	origin	The ray's origin.
+ * @param	invDir	Componentwise reciprocal of the ray's direction.
+ * @param	tMax  	Ignore intersections at or beyond this distance.
+ * @return	The distance at which the ray enters the box (0 if the origin is inside),
+ * 			or DBL_MAX if the ray misses the box before tMax.
+ */
+
+double BVH::intersectBox(const AABB &box, const dvec3 &origin, const dvec3 &invDir, double tMax) {
+	double t1 = (box.lo.x - origin.x) * invDir.x;
+	double t2 = (box.hi.x - origin.x) * invDir.x;
+	double tNear = std::min(t1, t2);
+	double tFar = std::max(t1, t2);
+
+	t1 = (box.lo.y - origin.y) * invDir.y;
+	t2 = (box.hi.y - origin.y) * invDir.y;
+	tNear = std::max(tNear, std::min(t1, t2));
+	tFar = std::min(tFar, std::max(t1, t2));
+
+	t1 = (box.lo.z - origin.z) * invDir.z;
+	t2 = (box.hi.z - origin.z) * invDir.z;
+	tNear = std::max(tNear, std::min(t1, t2));
+	tFar = std::min(tFar, std::max(t1, t2));
+
+	tNear = std::max(tNear, 0.0);
+	return (tNear <= tFar && tNear < tMax) ? tNear : DBL_MAX;
+}
+
+/**
+ * @fn	HitRecord BVH::findIntersection(const Ray &ray) const
+ * @brief	Finds the closest intersection within the ray's interval. Produces the
+ * 			same result as VisibleIShape::findIntersection over the original surfaces.
+ * 			Traversal tracks only the closest t and the object that produced it; the
+ * 			full hit record is filled in once, for that object.
+ * @param	ray	The ray.
+ * @return	The closest intersection; t is FLT_MAX if nothing was hit.
+ */
+
+HitRecord BVH::findIntersection(const Ray &ray) const {
+	double closestT = ray.tMax;
+	const VisibleIShape *closest = nullptr;
+	unbounded.intersect(ray, closestT, closest);
+	unboundedTransparent.intersect(ray, closestT, closest);
+
+	const dvec3 invDir(1.0 / ray.dir.x, 1.0 / ray.dir.y, 1.0 / ray.dir.z);
+	if (!nodes.empty() && intersectBox(nodes[0].box, ray.origin, invDir, closestT) != DBL_MAX) {
+		intersectSubtree(0, ray, invDir, closestT, closest);
+	}
+
+	HitRecord theHit;
+	if (closest != nullptr) {
+		RenderStats::count(RAY_HITS);
+		closest->computeAttributes(ray, closestT, theHit);
+	}
+	return theHit;
+}
+
+/**
+ * @fn	void BVH::intersectSubtree(int root, const Ray &ray, const dvec3 &invDir, double &closestT, const VisibleIShape *&closest) const
+ * @brief	Closest hit search below a node whose box the ray is already known to hit.
+ * @param 		  	root		The node to start at.
+ * @param 		  	ray			The ray.
+ * @param 		  	invDir  	Componentwise reciprocal of the ray's direction.
+ * @param [in,out]	closestT	The closest t found so far; FLT_MAX if none.
+ * @param [in,out]	closest 	The surface that produced closestT.
+ */
+
+void BVH::intersectSubtree(int root, const Ray &ray, const dvec3 &invDir, double &closestT,
+							const VisibleIShape *&closest) const {
+	int stack[MAX_DEPTH + 1];
+	int stackSize = 0;
+	stack[stackSize++] = root;
+	while (stackSize > 0) {
+		const BVHNode &node = nodes[stack[--stackSize]];
+		if (node.isLeaf()) {
+			for (int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+				objects.intersect(spans[i], ray, closestT, closest);
+			}
+			continue;
+		}
+
+		// Visit the nearer child first so that its hits can prune the farther one.
+		int near = node.leftOrFirst;
+		int far = node.leftOrFirst + 1;
+		double tNear = intersectBox(nodes[near].box, ray.origin, invDir, closestT);
+		double tFar = intersectBox(nodes[far].box, ray.origin, invDir, closestT);
+		if (tFar < tNear) {
+			std::swap(near, far);
+			std::swap(tNear, tFar);
+		}
+		if (tFar != DBL_MAX) {
+			stack[stackSize++] = far;
+		}
+		if (tNear != DBL_MAX) {
+			stack[stackSize++] = near;
+		}
+	}
+}
+
+/**
+ * @fn	unsigned BVH::intersectBox(const AABB &box, const RayPacket &packet, unsigned lanes)
+ * @brief	Slab test between a box and each lane of a packet, SIMD_WIDTH lanes at a
+ * 			time. Each lane uses its own closest t as the far limit.
+ * @param	box   	The box.
+ * @param	packet	The packet.
+ * @param	lanes 	The lanes to test.
+ * @return	The lanes, out of those given, that hit the box.
+ */
+
+unsigned BVH::intersectBox(const AABB &box, const RayPacket &packet, unsigned lanes) {
+	const vdouble loX = vset1(box.lo.x), loY = vset1(box.lo.y), loZ = vset1(box.lo.z);
+	const vdouble hiX = vset1(box.hi.x), hiY = vset1(box.hi.y), hiZ = vset1(box.hi.z);
+	const vdouble zero = vset1(0.0);
+	unsigned result = 0;
+	for (int base = 0; base < RayPacket::SIZE; base += SIMD_WIDTH) {
+		unsigned chunk = (lanes >> base) & SIMD_LANES;
+		if (chunk == 0) {
+			continue;
+		}
+		vdouble ox = vload(packet.ox + base);
+		vdouble idx = vload(packet.idx + base);
+		vdouble t1 = vmul(vsub(loX, ox), idx);
+		vdouble t2 = vmul(vsub(hiX, ox), idx);
+		vdouble tNear = vmin(t2, t1);
+		vdouble tFar = vmax(t2, t1);
+
+		vdouble oy = vload(packet.oy + base);
+		vdouble idy = vload(packet.idy + base);
+		t1 = vmul(vsub(loY, oy), idy);
+		t2 = vmul(vsub(hiY, oy), idy);
+		tNear = vmax(vmin(t2, t1), tNear);
+		tFar = vmin(vmax(t2, t1), tFar);
+
+		vdouble oz = vload(packet.oz + base);
+		vdouble idz = vload(packet.idz + base);
+		t1 = vmul(vsub(loZ, oz), idz);
+		t2 = vmul(vsub(hiZ, oz), idz);
+		tNear = vmax(vmin(t2, t1), tNear);
+		tFar = vmin(vmax(t2, t1), tFar);
+
+		tNear = vmax(zero, tNear);
+		vmask hit = vand(vle(tNear, tFar), vlt(tNear, vload(packet.closestT + base)));
+		result |= (vbits(hit) & chunk) << base;
+	}
+	return result;
+}
+
+/**
+ * @fn	void BVH::intersectPacket(RayPacket &packet, unsigned lanes) const
+ * @brief	Closest hit search for a packet. The packet descends the tree together,
+ * 			carrying the mask of lanes that hit each node. When too few lanes are left
+ * 			for SIMD to pay off, each remaining lane finishes that subtree on its own.
+ * @param [in,out]	packet	The packet; each lane's closest hit is updated.
+ * @param 		  	lanes 	The lanes to trace.
+ */
+
+void BVH::intersectPacket(RayPacket &packet, unsigned lanes) const {
+	struct Entry {
+		int node;
+		unsigned lanes;
+	};
+	Entry stack[MAX_DEPTH + 1];
+	int stackSize = 0;
+	stack[stackSize++] = { 0, lanes };
+	while (stackSize > 0) {
+		Entry entry = stack[--stackSize];
+		const BVHNode &node = nodes[entry.node];
+		unsigned live = intersectBox(node.box, packet, entry.lanes);
+		if (live == 0) {
+			continue;
+		}
+		if (RayPacket::countLanes(live) < MIN_PACKET_LANES) {
+			for (int lane = 0; lane < RayPacket::SIZE; lane++) {
+				if ((live >> lane) & 1) {
+					const dvec3 invDir(packet.idx[lane], packet.idy[lane], packet.idz[lane]);
+					intersectSubtree(entry.node, packet.rays[lane], invDir, packet.closestT[lane], packet.closest[lane]);
+				}
+			}
+			continue;
+		}
+		if (node.isLeaf()) {
+			for (int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+				objects.intersect(spans[i], packet, live);
+			}
+			continue;
+		}
+
+		// Order the children by the direction of the first live ray, so that the
+		// nearer one is visited first for most of the packet.
+		int first = 0;
+		while (((live >> first) & 1) == 0) {
+			first++;
+		}
+		int near = node.leftOrFirst;
+		int far = node.leftOrFirst + 1;
+		dvec3 between = nodes[far].box.centroid() - nodes[near].box.centroid();
+		if (between.x * packet.dx[first] + between.y * packet.dy[first] + between.z * packet.dz[first] < 0) {
+			std::swap(near, far);
+		}
+		stack[stackSize++] = { far, live };
+		stack[stackSize++] = { near, live };
+	}
+}
+
+/**
+ * @fn	void BVH::findIntersections(const Ray rays[], int numRays, HitRecord hits[]) const
+ * @brief	Finds the closest intersection for a group of up to RayPacket::SIZE rays,
+ * 			such as the primary rays through a block of neighbouring pixels. The rays
+ * 			are traced together as a packet, and each ray gets the same hit as
+ * 			findIntersection would give it.
+ * @param 		  	rays   	The rays.
+ * @param 		  	numRays	Number of rays; at most RayPacket::SIZE.
+ * @param [in,out]	hits   	The closest intersection of each ray.
+ */
+
+void BVH::findIntersections(const Ray rays[], int numRays, HitRecord hits[]) const {
+	RayPacket packet(rays, numRays);
+	unsigned lanes = RayPacket::ALL_LANES >> (RayPacket::SIZE - numRays);
+	unbounded.intersect(packet, lanes);
+	unboundedTransparent.intersect(packet, lanes);
+	if (!nodes.empty()) {
+		intersectPacket(packet, lanes);
+	}
+
+	for (int i = 0; i < numRays; i++) {
+		hits[i] = HitRecord();
+		const VisibleIShape *closest = packet.closest[i];
+		if (closest == nullptr) {
+			continue;
+		}
+		// The winner's t is recomputed by the shape's own code, so the attributes
+		// are exactly those of a single ray. Should the two ever disagree, the ray
+		// is simply traced again on its own.
+		double t = closest->intersectT(rays[i]);
+		if (t == packet.closestT[i]) {
+			RenderStats::count(RAY_HITS);
+			closest->computeAttributes(rays[i], t, hits[i]);
+		} else {
+			hits[i] = findIntersection(rays[i]);
+		}
+	}
+}
+
+/**
+ * @fn	const VisibleIShape *BVH::findOccluder(const Ray &ray) const
+ * @brief	Any-hit query for shadow feelers. Returns as soon as any object is found
+ * 			within the ray's interval, so children are visited in no particular
+ * 			order and no hit record is built.
+ * @param	ray	The ray; nodes beyond its tMax are not visited.
+ * @return	An object hit with ray.tMin < t < ray.tMax, or null if there is none.
+ */
+
+const VisibleIShape *BVH::findOccluder(const Ray &ray) const {
+	const VisibleIShape *occluder = unbounded.findOccluder(ray);
+	if (occluder == nullptr) {
+		occluder = unboundedTransparent.findOccluder(ray);
+	}
+	if (occluder != nullptr || nodes.empty()) {
+		return occluder;
+	}
+
+	const dvec3 invDir(1.0 / ray.dir.x, 1.0 / ray.dir.y, 1.0 / ray.dir.z);
+	int stack[MAX_DEPTH + 1];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		const BVHNode &node = nodes[stack[--stackSize]];
+		if (intersectBox(node.box, ray.origin, invDir, ray.tMax) == DBL_MAX) {
+			continue;
+		}
+		if (node.isLeaf()) {
+			for (int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+				occluder = objects.findOccluder(spans[i], ray);
+				if (occluder != nullptr) {
+					return occluder;
+				}
+			}
+		} else {
+			stack[stackSize++] = node.leftOrFirst + 1;
+			stack[stackSize++] = node.leftOrFirst;
+		}
+	}
+	return nullptr;
+}
+
+/**
+ * @fn	void BVH::findLayers(const Ray &ray, LayeredHit &result) const
+ * @brief	Finds the closest opaque hit and the transparent crossings in front of it
+ * 			in a single traversal. A node is skipped once it lies beyond the opaque
+ * 			hit or, when MAX_LAYERS crossings have been found, beyond the last of them.
+ * @param 		  	ray   	The ray.
+ * @param [in,out]	result	The hits along the ray.
+ */
+
+void BVH::findLayers(const Ray &ray, LayeredHit &result) const {
+	LayerSearch search;
+	search.opaqueT = ray.tMax;
+	for (int type = 0; type < NUM_COMPILED_SHAPE_TYPES; type++) {
+		CompiledSpan span = { (CompiledShapeType)type, 0, unbounded.size((CompiledShapeType)type), false };
+		if (span.count > 0) {
+			intersectLayers(unbounded, span, ray, search);
+		}
+		span = { (CompiledShapeType)type, 0, unboundedTransparent.size((CompiledShapeType)type), true };
+		if (span.count > 0) {
+			intersectLayers(unboundedTransparent, span, ray, search);
+		}
+	}
+
+	const dvec3 invDir(1.0 / ray.dir.x, 1.0 / ray.dir.y, 1.0 / ray.dir.z);
+	if (!nodes.empty() && intersectBox(nodes[0].box, ray.origin, invDir, search.limit()) != DBL_MAX) {
+		int stack[MAX_DEPTH + 1];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0) {
+			const BVHNode &node = nodes[stack[--stackSize]];
+			if (node.isLeaf()) {
+				for (int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++) {
+					intersectLayers(objects, spans[i], ray, search);
+				}
+				continue;
+			}
+
+			int near = node.leftOrFirst;
+			int far = node.leftOrFirst + 1;
+			double tNear = intersectBox(nodes[near].box, ray.origin, invDir, search.limit());
+			double tFar = intersectBox(nodes[far].box, ray.origin, invDir, search.limit());
+			if (tFar < tNear) {
+				std::swap(near, far);
+				std::swap(tNear, tFar);
+			}
+			if (tFar != DBL_MAX) {
+				stack[stackSize++] = far;
+			}
+			if (tNear != DBL_MAX) {
+				stack[stackSize++] = near;
+			}
+		}
+	}
+
+	result.numLayers = 0;
+	for (int i = 0; i < search.numLayers && search.layers[i].t < search.opaqueT; i++) {
+		search.layers[i].surface->computeAttributes(ray, search.layers[i].t, result.layers[result.numLayers++]);
+	}
+	result.tComplete = search.tComplete;
+	result.opaque = HitRecord();
+	if (search.opaque != nullptr && search.opaqueT <= search.tComplete) {
+		search.opaque->computeAttributes(ray, search.opaqueT, result.opaque);
+	}
+	if (result.numLayers > 0 || result.opaque.t != FLT_MAX) {
+		RenderStats::count(RAY_HITS);
+	}
+}
+
+/**
+ * @fn	void BVH::intersectLayers(const CompiledScene &scene, const CompiledSpan &span, const Ray &ray, LayerSearch &search)
+ * @brief	Adds the hits of a span to a findLayers traversal. Opaque spans are
+ * 			searched for a closer opaque hit; transparent spans add every crossing
+ * 			in front of it.
+ * @param 		  	scene 	The compiled shapes the span refers to.
+ * @param 		  	span  	The shapes to test.
+ * @param 		  	ray   	The ray.
+ * @param [in,out]	search	The traversal's state.
+ */
+
+void BVH::intersectLayers(const CompiledScene &scene, const CompiledSpan &span, const Ray &ray,
+								LayerSearch &search) {
+	if (!span.transparent) {
+		double closestT = search.limit();
+		const VisibleIShape *closest = nullptr;
+		scene.intersect(span, ray, closestT, closest);
+		if (closest != nullptr) {
+			search.opaqueT = closestT;
+			search.opaque = closest;
+		}
+		return;
+	}
+
+	RenderStats::count((RenderCounter)(SPHERE_TESTS + span.type), span.count);
+	Ray query = ray;
+	bool fromOrigin = scene.sharesOrigin(ray);
+	for (int i = span.first; i < span.first + span.count; i++) {
+		double roots[2];
+		query.tMax = search.limit();
+		int numRoots = scene.findRoots(span.type, i, query, fromOrigin, roots);
+		for (int r = 0; r < numRoots && roots[r] < search.limit(); r++) {
+			search.addLayer(roots[r], scene.getSurface(span.type, i));
+			if (span.type == OTHER_SHAPE) {
+				// only the first crossing is known, so the rest must be traced again
+				search.tComplete = std::min(search.tComplete, roots[r]);
+			}
+		}
+	}
+}
+
+/**
+ * @fn	void BVH::findLayers(const Ray rays[], int numRays, LayeredHit results[]) const
+ * @brief	findLayers for a group of up to RayPacket::SIZE rays. The group is traced
+ * 			as a packet for its closest hits; only the rays whose closest hit is
+ * 			transparent are then traced again on their own.
+ * @param 		  	rays   	The rays.
+ * @param 		  	numRays	Number of rays; at most RayPacket::SIZE.
+ * @param [in,out]	results	The hits along each ray.
+ */
+
+void BVH::findLayers(const Ray rays[], int numRays, LayeredHit results[]) const {
+	HitRecord hits[RayPacket::SIZE];
+	findIntersections(rays, numRays, hits);
+	for (int i = 0; i < numRays; i++) {
+		if (hits[i].surface != nullptr && isTransparent(hits[i].surface)) {
+			findLayers(rays[i], results[i]);
+		} else {
+			results[i].opaque = hits[i];
+			results[i].numLayers = 0;
+			results[i].tComplete = FLT_MAX;
+		}
+	}
+}
+
+/**
+ * @fn	bool BVH::isTransparent(const VisibleIShape *surface) const
+ * @brief	Determines if a surface was given to build as transparent.
+ * @param	surface	The surface.
+ * @return	True iff the surface is one of the hierarchy's transparent surfaces.
+ */
+
+bool BVH::isTransparent(const VisibleIShape *surface) const {
+	return std::binary_search(transparentObjects.begin(), transparentObjects.end(), surface);
+}
+
+/**
+ * @fn	void BVH::setOrigin(const dvec3 &rayOrigin)
+ * @brief	Precomputes the origin terms of every object for rays starting at
+ * 			rayOrigin; see CompiledScene::setOrigin. Must not be called while
+ * 			another thread is querying the hierarchy.
+ * @param	rayOrigin	The origin shared by the rays to come.
+ */
+
+void BVH::setOrigin(const dvec3 &rayOrigin) {
+	objects.setOrigin(rayOrigin);
+	unbounded.setOrigin(rayOrigin);
+	unboundedTransparent.setOrigin(rayOrigin);
+}
+
+/**
+ * @fn	ostream &operator << (ostream &os, const BVH &bvh)
+ * @brief	Output stream for BVH build statistics.
+ * @param	os 	Output stream.
+ * @param	bvh	The hierarchy.
+ * @return	The output stream.
+ */
+
+ostream &operator << (ostream &os, const BVH &bvh) {
+	os << "BVH: " << bvh.numBoundedObjects() << " bounded + "
+		<< bvh.numUnboundedObjects() << " unbounded objects, "
+		<< bvh.numNodes() << " nodes, depth " << bvh.maxDepth
+		<< ", built in " << bvh.buildTimeMs << " ms";
+	return os;
+}
@@ -0,0 +1,118 @@
+/****************************************************
+ * 2016-2020 Eric Bachmann and Mike Zmuda
+ * All Rights Reserved.
+ * NOTICE:
+ * Dissemination of this information or reproduction
+ * of this material is prohibited unless prior written
+ * permission is granted..
+ ****************************************************/
+
+#pragma once
+#include <vector>
+#include "Defs.h"
+#include "IShape.h"
+#include "CompiledScene.h"
+
+/**
+ * @struct	BVHNode
+ * @brief	A node in a flattened bounding volume hierarchy. Interior nodes store
+ * 			the index of their left child; the right child immediately follows it.
+ * 			Leaves store a range of entries in the BVH's span list, one span per
+ * 			type of shape in the leaf.
+ */
+
+struct BVHNode {
+	AABB box;			//!< Bounds of everything below this node.
+	int leftOrFirst;	//!< Left child index (interior) or first span (leaf).
+	int count;			//!< Number of spans in a leaf; 0 for interior nodes.
+	bool isLeaf() const { return count > 0; }
+};
+
+/**
+ * @struct	LayeredHit
+ * @brief	What a ray meets on its way to the first opaque surface: that surface, and
+ * 			the transparent surfaces it passes through before reaching it, nearest
+ * 			first. A transparent object is listed once for each time the ray crosses
+ * 			its surface, so a sphere is usually listed twice.
+ *
+ * 			Only the first MAX_LAYERS crossings are kept. Everything up to tComplete is
+ * 			known: a ray continuing past the last layer may use opaque only if
+ * 			opaque.t <= tComplete, and must otherwise be traced again.
+ */
+
+struct LayeredHit {
+	static const int MAX_LAYERS = 4;
+	HitRecord opaque;				//!< Closest opaque hit; t is FLT_MAX if there is none.
+	HitRecord layers[MAX_LAYERS];	//!< Transparent hits in front of opaque, nearest first.
+	int numLayers;					//!< Number of entries in layers.
+	double tComplete;				//!< No hit closer than this is missing; FLT_MAX if none is.
+	LayeredHit() : numLayers(0), tComplete(FLT_MAX) {}
+	LayeredHit(const HitRecord &opaqueHit, const HitRecord &transparentHit);
+	bool opaqueIsKnown() const { return opaque.t <= tComplete; }
+};
+
+/**
+ * @struct	BVH
+ * @brief	Bounding volume hierarchy over a set of visible implicit shapes, built
+ * 			top-down using the surface area heuristic (SAH). Shapes without bounds,
+ * 			such as planes, are kept in a separate list and tested against every ray.
+ * 			The shapes are copied into CompiledScenes, with each leaf's shapes sorted
+ * 			by type so that a leaf is a few runs of same-typed entries.
+ *
+ * 			A hierarchy may hold opaque and transparent surfaces together. The closest
+ * 			hit and occlusion queries treat them alike; findLayers tells them apart.
+ */
+
+struct BVH {
+	static const int MAX_LEAF_SIZE = 4;		//!< Never split a node holding this many objects or fewer.
+	static const int NUM_BINS = 16;			//!< Number of SAH bins per axis.
+	static const int MAX_DEPTH = 64;		//!< Limit on tree depth; also the traversal stack size.
+	static const int MIN_PACKET_LANES = 2;	//!< Below this many live lanes a packet is split into single rays.
+
+	BVH();
+	void build(const vector<VisibleIShapePtr> &surfaces);
+	void build(const vector<VisibleIShapePtr> &surfaces, const vector<VisibleIShapePtr> &transparentSurfaces);
+	HitRecord findIntersection(const Ray &ray) const;
+	void findIntersections(const Ray rays[], int numRays, HitRecord hits[]) const;
+	void findLayers(const Ray &ray, LayeredHit &result) const;
+	void findLayers(const Ray rays[], int numRays, LayeredHit results[]) const;
+	bool isTransparent(const VisibleIShape *surface) const;
+	void setOrigin(const dvec3 &rayOrigin);
+	bool occluded(const Ray &ray) const { return findOccluder(ray) != nullptr; }
+	const VisibleIShape *findOccluder(const Ray &ray) const;
+	int numNodes() const { return (int)nodes.size(); }
+	int numBoundedObjects() const { return objects.size(); }
+	int numUnboundedObjects() const { return unbounded.size() + unboundedTransparent.size(); }
+	double buildTimeMs;						//!< Time taken by the last call to build.
+	int maxDepth;							//!< Deepest node in the hierarchy.
+	static bool logBuilds;					//!< If true, IScene prints the statistics of every hierarchy it builds.
+	friend ostream &operator << (ostream &os, const BVH &bvh);
+protected:
+	struct BuildItem {
+		AABB box;
+		dvec3 centroid;
+		VisibleIShapePtr surface;
+		CompiledShapeType type;
+		bool transparent;
+	};
+	struct Layer {
+		double t;
+		const VisibleIShape *surface;
+	};
+	struct LayerSearch;
+	void buildNode(int nodeIndex, vector<BuildItem> &items, int first, int count, int depth);
+	void compileLeaves(vector<BuildItem> &items);
+	static double intersectBox(const AABB &box, const dvec3 &origin, const dvec3 &invDir, double tMax);
+	static unsigned intersectBox(const AABB &box, const RayPacket &packet, unsigned lanes);
+	void intersectSubtree(int root, const Ray &ray, const dvec3 &invDir, double &closestT,
+							const VisibleIShape *&closest) const;
+	void intersectPacket(RayPacket &packet, unsigned lanes) const;
+	static void intersectLayers(const CompiledScene &scene, const CompiledSpan &span, const Ray &ray,
+								LayerSearch &search);
+	vector<BVHNode> nodes;					//!< Flattened tree; nodes[0] is the root.
+	vector<CompiledSpan> spans;				//!< Runs of same-typed objects; each leaf owns a range.
+	CompiledScene objects;					//!< Bounded objects, ordered so each span is contiguous.
+	CompiledScene unbounded;				//!< Objects that have no bounding box.
+	CompiledScene unboundedTransparent;		//!< Transparent objects that have no bounding box.
+	vector<const VisibleIShape *> transparentObjects;	//!< Every transparent surface, sorted.
+};
@@ -0,0 +1,445 @@
+/****************************************************
+ * 2016-2020 Eric Bachmann and Mike Zmuda
+ * All Rights Reserved.
+ * NOTICE:
+ * Dissemination of this information or reproduction
+ * of this material is prohibited unless prior written
+ * permission is granted..
+ ****************************************************/
+
+/**
+ * Microbenchmarks for the hot kernels of the ray tracer and the raster pipeline.
+ * Each benchmark repeats its kernel until it has run for a minimum time, does that
+ * for several trials and reports the fastest trial as ns/op and as a rate (rays/s,
+ * fragments/s, ...). The results are also saved as JSON so that runs can be
+ * compared. Like HeadlessRender.cpp, this file is built with the core library and
+ * HEADLESS defined, outside the Visual Studio project.
+ *
+ * Usage: Benchmarks [-o results.json] [-m minTimeMs] [-r trials] [-b nameFilter]
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <random>
+#include "Defs.h"
+#include "Utilities.h"
+#include "IShape.h"
+#include "IScene.h"
+#include "Light.h"
+#include "Camera.h"
+#include "RayGenerator.h"
+#include "FrameBuffer.h"
+#include "FragmentOps.h"
+#include "Rasterization.h"
+#include "VertexOps.h"
+
+volatile double benchmarkSink = 0.0;		//!< Results are folded in here so they are not optimized away.
+
+struct BenchmarkResult {
+	string name;
+	string unit;			//!< What one op is, e.g. "rays" or "fragments".
+	long long ops;			//!< Ops performed in the fastest trial.
+	double nsPerOp;
+	double opsPerSec;
+};
+
+struct BenchmarkSettings {
+	double minTimeMs = 200.0;
+	int numTrials = 5;
+	string filter;
+	string jsonFileName = "benchmarks.json";
+};
+
+BenchmarkSettings settings;
+vector<BenchmarkResult> results;
+
+/**
+ * Runs a kernel until minTimeMs has passed, settings.numTrials times, and records the
+ * fastest trial. The kernel returns how many ops it performed.
+ */
+
+void runBenchmark(const string &name, const string &unit, const std::function<long long()> &kernel) {
+	if (!settings.filter.empty() && name.find(settings.filter) == string::npos) {
+		return;
+	}
+	kernel();		// warm up caches and any lazily built state
+
+	BenchmarkResult best = { name, unit, 0, DBL_MAX, 0.0 };
+	for (int trial = 0; trial < settings.numTrials; trial++) {
+		long long ops = 0;
+		double elapsedMs = 0.0;
+		auto startTime = std::chrono::steady_clock::now();
+		do {
+			ops += kernel();
+			elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+		} while (elapsedMs < settings.minTimeMs);
+		double nsPerOp = elapsedMs * 1.0e6 / ops;
+		if (nsPerOp < best.nsPerOp) {
+			best.ops = ops;
+			best.nsPerOp = nsPerOp;
+			best.opsPerSec = 1.0e9 / nsPerOp;
+		}
+	}
+	results.push_back(best);
+	printf("%-44s %12.1f ns/op %14.0f %s/s\n", name.c_str(), best.nsPerOp, best.opsPerSec, unit.c_str());
+	fflush(stdout);
+}
+
+vector<Ray> makeRays(int N, std::mt19937 &rng) {
+	std::uniform_real_distribution<double> U(-1.0, 1.0);
+	vector<Ray> rays;
+	for (int i = 0; i < N; i++) {
+		dvec3 origin(20.0 * U(rng), 20.0 * U(rng), 20.0 + 5.0 * U(rng));
+		dvec3 target(10.0 * U(rng), 10.0 * U(rng), 10.0 * U(rng));
+		rays.push_back(Ray(origin, target - origin));
+	}
+	return rays;
+}
+
+/**
+ * Fills a scene with N randomly placed shapes of every bounded kind, plus one plane.
+ */
+
+void buildRandomScene(IScene &scene, int N, std::mt19937 &rng) {
+	std::uniform_real_distribution<double> U(-10.0, 10.0), R(0.2, 1.0);
+	scene.addOpaqueObject(new VisibleIShape(new IPlane(dvec3(0, -10, 0), Y_AXIS), tin));
+	for (int i = 1; i < N; i++) {
+		dvec3 c(U(rng), U(rng), U(rng));
+		IShape *shape;
+		switch (i % 5) {
+		case 0:		shape = new ISphere(c, R(rng)); break;
+		case 1:		shape = new IEllipsoid(c, dvec3(R(rng), R(rng), R(rng))); break;
+		case 2:		shape = new ICylinderY(c, R(rng), 2.0 * R(rng)); break;
+		case 3:		shape = new IDisk(c, glm::normalize(dvec3(U(rng), U(rng), U(rng))), R(rng)); break;
+		default:	shape = new ITriangle(c, c + dvec3(R(rng), 0, 0), c + dvec3(0, R(rng), 0)); break;
+		}
+		scene.addOpaqueObject(new VisibleIShape(shape, i % 2 ? silver : gold));
+	}
+}
+
+void benchmarkShapes(const vector<Ray> &rays) {
+	const int N = (int)rays.size();
+	ISphere sphere(dvec3(0, 0, 0), 6.0);
+	runBenchmark("IQuadricSurface::computeAqBqCq+quadratic", "rays", [&]() {
+		double sum = 0.0;
+		for (const Ray &ray : rays) {
+			double Aq, Bq, Cq, roots[2];
+			sphere.computeAqBqCq(ray, Aq, Bq, Cq);
+			if (quadratic(Aq, Bq, Cq, roots) > 0) {
+				sum += roots[0];
+			}
+		}
+		benchmarkSink = benchmarkSink + sum;
+		return (long long)N;
+	});
+
+	ITriangle triangle(dvec3(-8, -8, 0), dvec3(8, -8, 0), dvec3(0, 8, 0));
+	IPlane plane(dvec3(0, 0, 0), glm::normalize(dvec3(0.1, 0.2, 1.0)));
+	IDisk disk(dvec3(0, 0, 0), Z_AXIS, 7.0);
+	const struct {
+		const char *name;
+		const IShape *shape;
+	} shapes[] = {
+		{ "ISphere::findClosestIntersection", &sphere },
+		{ "ITriangle::findClosestIntersection", &triangle },
+		{ "IPlane::findClosestIntersection", &plane },
+		{ "IDisk::findClosestIntersection", &disk },
+	};
+	for (const auto &entry : shapes) {
+		const IShape *shape = entry.shape;
+		runBenchmark(entry.name, "rays", [&]() {
+			double sum = 0.0;
+			for (const Ray &ray : rays) {
+				HitRecord hit;
+				shape->findClosestIntersection(ray, hit);
+				sum += hit.t;
+			}
+			benchmarkSink = benchmarkSink + sum;
+			return (long long)N;
+		});
+	}
+}
+
+void benchmarkScenes(const vector<Ray> &rays, std::mt19937 &rng) {
+	const int N = (int)rays.size();
+	PerspectiveCamera camera(dvec3(0, 0, 25), ORIGIN3D, Y_AXIS, PI_2);
+	for (int numShapes : { 10, 100, 1000 }) {
+		IScene scene(&camera);
+		buildRandomScene(scene, numShapes, rng);
+		string size = std::to_string(numShapes);
+		runBenchmark("VisibleIShape::findIntersection/" + size, "rays", [&]() {
+			double sum = 0.0;
+			for (const Ray &ray : rays) {
+				sum += VisibleIShape::findIntersection(ray, scene.opaqueObjs).t;
+			}
+			benchmarkSink = benchmarkSink + sum;
+			return (long long)N;
+		});
+		const BVH &bvh = scene.getOpaqueBVH();
+		runBenchmark("BVH::findIntersection/" + size, "rays", [&]() {
+			double sum = 0.0;
+			for (const Ray &ray : rays) {
+				sum += bvh.findIntersection(ray).t;
+			}
+			benchmarkSink = benchmarkSink + sum;
+			return (long long)N;
+		});
+	}
+}
+
+/**
+ * Traces the primary rays of a perspective camera through a scene of quadrics,
+ * first as the shapes were compiled and then with their camera-origin terms
+ * precomputed by IScene::setRayOrigin, one ray at a time and in packets.
+ */
+
+void benchmarkPrimaryRays(std::mt19937 &rng) {
+	const int W = 160, H = 120;
+	PerspectiveCamera camera(dvec3(0, 0, 25), ORIGIN3D, Y_AXIS, PI_2);
+	camera.calculateViewingParameters(W, H);
+	IScene scene(&camera);
+	std::uniform_real_distribution<double> U(-10.0, 10.0), R(0.5, 2.0);
+	scene.addOpaqueObject(new VisibleIShape(new IPlane(dvec3(0, -10, 0), Y_AXIS), tin));
+	for (int i = 0; i < 2000; i++) {
+		dvec3 c(U(rng), U(rng), U(rng));
+		IShape *shape;
+		switch (i % 3) {
+		case 0:		shape = new ISphere(c, R(rng)); break;
+		case 1:		shape = new IEllipsoid(c, dvec3(R(rng), R(rng), R(rng))); break;
+		default:	shape = new ICylinderY(c, R(rng), 2.0 * R(rng)); break;
+		}
+		scene.addOpaqueObject(new VisibleIShape(shape, silver));
+	}
+	const BVH &bvh = scene.getOpaqueBVH();
+	vector<Ray> rays;
+	for (int by = 0; by < H; by += RayPacket::BLOCK_HEIGHT) {
+		for (int bx = 0; bx < W; bx += RayPacket::BLOCK_WIDTH) {
+			for (int y = by; y < by + RayPacket::BLOCK_HEIGHT; y++) {
+				for (int x = bx; x < bx + RayPacket::BLOCK_WIDTH; x++) {
+					rays.push_back(camera.getRay(x, y));
+				}
+			}
+		}
+	}
+	const int N = (int)rays.size();
+
+	for (string variant : { "", "+origin terms" }) {
+		if (!variant.empty()) {
+			scene.setRayOrigin(camera.cameraFrame.origin);
+		}
+		runBenchmark("BVH::findIntersection/primary" + variant, "rays", [&]() {
+			double sum = 0.0;
+			for (const Ray &ray : rays) {
+				sum += bvh.findIntersection(ray).t;
+			}
+			benchmarkSink = benchmarkSink + sum;
+			return (long long)N;
+		});
+		runBenchmark("BVH::findIntersections/primary" + variant, "rays", [&]() {
+			double sum = 0.0;
+			HitRecord hits[RayPacket::SIZE];
+			for (int i = 0; i < N; i += RayPacket::SIZE) {
+				bvh.findIntersections(&rays[i], RayPacket::SIZE, hits);
+				sum += hits[0].t;
+			}
+			benchmarkSink = benchmarkSink + sum;
+			return (long long)N;
+		});
+	}
+}
+
+/**
+ * Makes the primary rays of a 640x480 window with the cameras' getRay and with a
+ * RayGenerator, which projects each row and column once per frame.
+ */
+
+void benchmarkCameraRays() {
+	const int W = 640, H = 480;
+	PerspectiveCamera perspective(dvec3(0, 0, 25), ORIGIN3D, Y_AXIS, PI_2);
+	OrthographicCamera orthographic(dvec3(0, 0, 25), ORIGIN3D, Y_AXIS, 10.0);
+	perspective.calculateViewingParameters(W, H);
+	orthographic.calculateViewingParameters(W, H);
+	for (const RaytracingCamera *camera : { (const RaytracingCamera *)&perspective, (const RaytracingCamera *)&orthographic }) {
+		string name = camera == &perspective ? "perspective" : "orthographic";
+		runBenchmark("Camera::getRay/" + name, "rays", [&]() {
+			double sum = 0.0;
+			for (int y = 0; y < H; y++) {
+				for (int x = 0; x < W; x++) {
+					sum += camera->getRay(x, y).dir.x;
+				}
+			}
+			benchmarkSink = benchmarkSink + sum;
+			return (long long)W * H;
+		});
+		runBenchmark("RayGenerator::getRays/" + name, "rays", [&]() {
+			RayGenerator generator;
+			generator.setView(*camera, W, H);
+			Ray rays[RayPacket::SIZE];
+			double sum = 0.0;
+			for (int by = 0; by < H; by += RayPacket::BLOCK_HEIGHT) {
+				for (int bx = 0; bx < W; bx += RayPacket::BLOCK_WIDTH) {
+					Tile block = { bx, by, bx + RayPacket::BLOCK_WIDTH, by + RayPacket::BLOCK_HEIGHT };
+					generator.getRays(block, rays);
+					sum += rays[0].dir.x;
+				}
+			}
+			benchmarkSink = benchmarkSink + sum;
+			return (long long)W * H;
+		});
+	}
+}
+
+void benchmarkLighting(std::mt19937 &rng) {
+	const int N = 4096;
+	std::uniform_real_distribution<double> U(-1.0, 1.0);
+	vector<dvec3> points, normals;
+	for (int i = 0; i < N; i++) {
+		points.push_back(dvec3(5.0 * U(rng), 5.0 * U(rng), 5.0 * U(rng)));
+		normals.push_back(glm::normalize(dvec3(U(rng), U(rng), U(rng)) + dvec3(0, 2, 0)));
+	}
+	PerspectiveCamera camera(dvec3(0, 5, 10), ORIGIN3D, Y_AXIS, PI_2);
+	PositionalLight light(dvec3(10, 10, 10), pureWhiteLight);
+	LightATParams atParams(1.0, 0.1, 0.01);
+
+	runBenchmark("totalColor", "calls", [&]() {
+		color sum;
+		for (int i = 0; i < N; i++) {
+			dvec3 v = glm::normalize(camera.cameraFrame.origin - points[i]);
+			sum += totalColor(silver, light.lightColor, v, normals[i], light.pos, points[i], true, atParams);
+		}
+		benchmarkSink = benchmarkSink + sum.r;
+		return (long long)N;
+	});
+	PositionalLightPtr lightPtr = &light;
+	runBenchmark("PositionalLight::illuminate", "calls", [&]() {
+		color sum;
+		for (int i = 0; i < N; i++) {
+			sum += lightPtr->illuminate(points[i], normals[i], silver, camera.cameraFrame, false);
+		}
+		benchmarkSink = benchmarkSink + sum.r;
+		return (long long)N;
+	});
+}
+
+void benchmarkRaster(std::mt19937 &rng) {
+	const int W = 512, H = 512;
+	FrameBuffer frameBuffer(W, H);
+	frameBuffer.setClearColor(black);
+	vector<LightSourcePtr> lights = { new PositionalLight(dvec3(10, 10, 10), pureWhiteLight) };
+	const dvec3 eyePos(0, 0, 10);
+	const dmat4 viewingMatrix = glm::lookAt(eyePos, ORIGIN3D, Y_AXIS);
+
+	// A triangle covering about half of a 256 x 256 square, in window coordinates.
+	VertexData v0(dvec4(100, 100, 0.5, 1), Z_AXIS, redPlastic, dvec3(-1, -1, 0));
+	VertexData v1(dvec4(356, 100, 0.5, 1), Z_AXIS, redPlastic, dvec3(1, -1, 0));
+	VertexData v2(dvec4(228, 356, 0.5, 1), Z_AXIS, redPlastic, dvec3(0, 1, 0));
+
+	// Count the triangle's fragments once by the depths it writes.
+	frameBuffer.clearColorAndDepthBuffers();
+	drawFilledTriangle(frameBuffer, eyePos, lights, v0, v1, v2, viewingMatrix);
+	long long fragmentsPerTriangle = 0;
+	for (int y = 0; y < H; y++) {
+		for (int x = 0; x < W; x++) {
+			if (frameBuffer.getDepth(x, y) != 1.0) {
+				fragmentsPerTriangle++;
+			}
+		}
+	}
+
+	// Without the depth test every redraw shades every fragment again.
+	bool depthTest = FragmentOps::performDepthTest;
+	FragmentOps::performDepthTest = false;
+	runBenchmark("drawFilledTriangle", "fragments", [&]() {
+		drawFilledTriangle(frameBuffer, eyePos, lights, v0, v1, v2, viewingMatrix);
+		return fragmentsPerTriangle;
+	});
+	FragmentOps::performDepthTest = depthTest;
+
+	// Triangles in clip coordinates, about a third of which cross the view volume's sides.
+	struct ClipBenchmark : public VertexOps {
+		using VertexOps::clipPolygon;
+		using VertexOps::clipTriangles;
+		using VertexOps::guardBand;
+	};
+	std::uniform_real_distribution<double> U(-1.5, 1.5);
+	vector<VertexData> clipCoords;
+	const int NUM_TRIANGLES = 1000;
+	for (int i = 0; i < 3 * NUM_TRIANGLES; i++) {
+		clipCoords.push_back(VertexData(dvec4(U(rng), U(rng), 0.5 * U(rng), 1.0), Z_AXIS, redPlastic, ORIGIN3D));
+	}
+	runBenchmark("VertexOps::clipPolygon", "triangles", [&]() {
+		vector<VertexData> clipped = ClipBenchmark::clipPolygon(clipCoords, VertexOps::allButNearNDCPlanes);
+		benchmarkSink = benchmarkSink + (double)clipped.size();
+		return (long long)NUM_TRIANGLES;
+	});
+	// The same triangles, only cut where they leave the guard band.
+	vector<VertexData> clipped;
+	vector<char> wasClipped;
+	VertexOps::setViewport(0, W - 1, 0, H - 1);
+	runBenchmark("VertexOps::clipTriangles", "triangles", [&]() {
+		clipped.clear();
+		ClipBenchmark::clipTriangles(clipCoords, ClipBenchmark::guardBand(), clipped, wasClipped);
+		benchmarkSink = benchmarkSink + (double)clipped.size();
+		return (long long)NUM_TRIANGLES;
+	});
+
+	runBenchmark("FrameBuffer::setColor", "fragments", [&]() {
+		for (int y = 0; y < H; y++) {
+			for (int x = 0; x < W; x++) {
+				frameBuffer.setColor(x, y, color(x / (double)W, y / (double)H, 0.5));
+			}
+		}
+		return (long long)W * H;
+	});
+}
+
+bool writeJSON(const string &fileName) {
+	std::ofstream output(fileName.c_str());
+	if (!output) {
+		std::cerr << "Cannot write " << fileName << endl;
+		return false;
+	}
+	output.precision(10);
+	output << "{\n  \"minTimeMs\": " << settings.minTimeMs << ",\n  \"trials\": " << settings.numTrials
+		<< ",\n  \"benchmarks\": [\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchmarkResult &r = results[i];
+		output << "    { \"name\": \"" << r.name << "\", \"unit\": \"" << r.unit
+			<< "\", \"ops\": " << r.ops << ", \"nsPerOp\": " << r.nsPerOp
+			<< ", \"opsPerSec\": " << r.opsPerSec << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	output << "  ]\n}\n";
+	return (bool)output;
+}
+
+int main(int argc, char *argv[]) {
+	for (int i = 1; i + 1 < argc; i += 2) {
+		if (std::strcmp(argv[i], "-o") == 0) {
+			settings.jsonFileName = argv[i + 1];
+		} else if (std::strcmp(argv[i], "-m") == 0) {
+			settings.minTimeMs = std::atof(argv[i + 1]);
+		} else if (std::strcmp(argv[i], "-r") == 0) {
+			settings.numTrials = std::max(1, std::atoi(argv[i + 1]));
+		} else if (std::strcmp(argv[i], "-b") == 0) {
+			settings.filter = argv[i + 1];
+		}
+	}
+
+	std::mt19937 rng(386);
+	vector<Ray> rays = makeRays(10000, rng);
+	benchmarkShapes(rays);
+	benchmarkScenes(rays, rng);
+	benchmarkPrimaryRays(rng);
+	benchmarkCameraRays();
+	benchmarkLighting(rng);
+	benchmarkRaster(rng);
+
+	if (!writeJSON(settings.jsonFileName)) {
+		return 1;
+	}
+	cout << results.size() << " results written to " << settings.jsonFileName << endl;
+	return 0;
+}
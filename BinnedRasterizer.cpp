@@ -0,0 +1,238 @@
+/****************************************************
+ * 2016-2020 Eric Bachmann and Mike Zmuda
+ * All Rights Reserved.
+ * NOTICE:
+ * Dissemination of this information or reproduction
+ * of this material is prohibited unless prior written
+ * permission is granted..
+ ****************************************************/
+
+#include <algorithm>
+#include "BinnedRasterizer.h"
+#include "Rasterization.h"
+#include "Utilities.h"
+
+/**
+ * @fn	BinnedRasterizer::BinnedRasterizer(int numThreads, int tileSize)
+ * @brief	Creates a rasterizer and starts its worker threads.
+ * @param	numThreads	Threads drawing tiles, including the one calling flush().
+ * 						Values less than 1 select TileScheduler::defaultNumThreads().
+ * @param	tileSize  	Width and height of a tile.
+ */
+
+BinnedRasterizer::BinnedRasterizer(int numThreads, int tileSize)
+	: frameBuffer(nullptr), tileSize(std::max(1, tileSize)),
+		width(0), height(0), tilesAcross(0), numBatches(0),
+		fragmentState(FragmentState::current()), scheduler(numThreads) {
+}
+
+/**
+ * @fn	BinnedRasterizer::FragmentState BinnedRasterizer::FragmentState::current()
+ * @brief	Gets the FragmentOps settings in effect.
+ * @return	The settings.
+ */
+
+BinnedRasterizer::FragmentState BinnedRasterizer::FragmentState::current() {
+	FragmentState state;
+	state.performDepthTest = FragmentOps::performDepthTest;
+	state.readonlyDepthBuffer = FragmentOps::readonlyDepthBuffer;
+	state.readonlyColorBuffer = FragmentOps::readonlyColorBuffer;
+	state.fogParams = FragmentOps::fogParams;
+	return state;
+}
+
+/**
+ * @fn	void BinnedRasterizer::FragmentState::makeCurrent() const
+ * @brief	Puts these settings into effect.
+ */
+
+void BinnedRasterizer::FragmentState::makeCurrent() const {
+	FragmentOps::performDepthTest = performDepthTest;
+	FragmentOps::readonlyDepthBuffer = readonlyDepthBuffer;
+	FragmentOps::readonlyColorBuffer = readonlyColorBuffer;
+	FragmentOps::fogParams = fogParams;
+}
+
+/**
+ * @fn	bool BinnedRasterizer::FragmentState::matches(const FragmentState &other) const
+ * @brief	Determines if two sets of settings process fragments alike.
+ * @param	other	The other settings.
+ * @return	True iff every setting is the same.
+ */
+
+bool BinnedRasterizer::FragmentState::matches(const FragmentState &other) const {
+	const FogParams &a = fogParams;
+	const FogParams &b = other.fogParams;
+	return performDepthTest == other.performDepthTest && readonlyDepthBuffer == other.readonlyDepthBuffer &&
+			readonlyColorBuffer == other.readonlyColorBuffer && a.start == b.start && a.end == b.end &&
+			a.density == b.density && a.type == b.type && a.color == b.color;
+}
+
+/**
+ * @fn	void BinnedRasterizer::startFrame(FrameBuffer &frameBuffer)
+ * @brief	Cuts the frame buffer into tiles, each with an empty bin. The tiles, bins
+ * 			and batches keep the memory of earlier frames, so once they have grown
+ * 			to fit, binning allocates nothing.
+ * @param [in,out]	frameBuffer	The frame buffer the next triangles are drawn in.
+ */
+
+void BinnedRasterizer::startFrame(FrameBuffer &frameBuffer) {
+	this->frameBuffer = &frameBuffer;
+	if (width != frameBuffer.getWindowWidth() || height != frameBuffer.getWindowHeight()) {
+		width = frameBuffer.getWindowWidth();
+		height = frameBuffer.getWindowHeight();
+		tilesAcross = (width + tileSize - 1) / tileSize;
+		tiles = Tile::makeTiles(width, height, tileSize);
+		bins.resize(tiles.size());
+	}
+	for (vector<int> &bin : bins) {
+		bin.clear();
+	}
+	vertices.clear();
+	triangleBatches.clear();
+	numBatches = 0;
+}
+
+/**
+ * @fn	void BinnedRasterizer::addTriangles(FrameBuffer &frameBuffer, const dvec3 &eyePos, const vector<LightSourcePtr> &lights, const vector<VertexData> &windowCoords, const dmat4 &viewingMatrix)
+ * @brief	Bins filled triangles for drawing by the next flush(), anywhere in the window.
+ * @param [in,out]	frameBuffer  	The frame buffer to draw in.
+ * @param 		  	eyePos		 	Eye position.
+ * @param 		  	lights		 	Vector of lights in scene.
+ * @param 		  	windowCoords 	The vertex triplets, in window coordinates.
+ * @param 		  	viewingMatrix	Viewing matrix.
+ */
+
+void BinnedRasterizer::addTriangles(FrameBuffer &frameBuffer, const dvec3 &eyePos,
+									const vector<LightSourcePtr> &lights,
+									const vector<VertexData> &windowCoords,
+									const dmat4 &viewingMatrix) {
+	BoundingBoxi window(0, frameBuffer.getWindowWidth() - 1, 0, frameBuffer.getWindowHeight() - 1);
+	addTriangles(frameBuffer, eyePos, lights, windowCoords, viewingMatrix, window);
+}
+
+/**
+ * @fn	void BinnedRasterizer::addTriangles(FrameBuffer &frameBuffer, const dvec3 &eyePos, const vector<LightSourcePtr> &lights, const vector<VertexData> &windowCoords, const dmat4 &viewingMatrix, const BoundingBoxi &scissor)
+ * @brief	Bins filled triangles for drawing by the next flush(), only their pixels
+ * 			in a scissor rectangle. Triangles already binned for a different frame
+ * 			buffer, for this one at another size, or with other FragmentOps
+ * 			settings, are drawn first.
+ * @param [in,out]	frameBuffer  	The frame buffer to draw in.
+ * @param 		  	eyePos		 	Eye position.
+ * @param 		  	lights		 	Vector of lights in scene.
+ * @param 		  	windowCoords 	The vertex triplets, in window coordinates.
+ * @param 		  	viewingMatrix	Viewing matrix.
+ * @param 		  	scissor		 	The pixels that may be drawn, edges included.
+ */
+
+void BinnedRasterizer::addTriangles(FrameBuffer &frameBuffer, const dvec3 &eyePos,
+									const vector<LightSourcePtr> &lights,
+									const vector<VertexData> &windowCoords,
+									const dmat4 &viewingMatrix, const BoundingBoxi &scissor) {
+	int W = frameBuffer.getWindowWidth();
+	int H = frameBuffer.getWindowHeight();
+	FragmentState state = FragmentState::current();
+	if (this->frameBuffer != &frameBuffer || width != W || height != H ||
+		(!triangleBatches.empty() && !state.matches(fragmentState))) {
+		flush();
+		startFrame(frameBuffer);
+	}
+	fragmentState = state;
+	// The scissor, within the window.
+	double xLo = std::max(scissor.lx, 0);
+	double xHi = std::min(scissor.rx, W - 1);
+	double yLo = std::max(scissor.ly, 0);
+	double yHi = std::min(scissor.ry, H - 1);
+	if (xLo > xHi || yLo > yHi || windowCoords.size() < 3) {
+		return;
+	}
+
+	// Consecutive calls usually share their eye, lights, view and scissor; they share a batch too.
+	if (numBatches == 0 || !batches[numBatches - 1].matches(eyePos, lights, viewingMatrix, scissor)) {
+		if (numBatches == (int)batches.size()) {
+			batches.push_back(Batch());
+		}
+		Batch &added = batches[numBatches++];
+		added.eyePos = eyePos;
+		added.lights.assign(lights.begin(), lights.end());
+		added.viewingMatrix = viewingMatrix;
+		added.scissor = scissor;
+	}
+	int batch = numBatches - 1;
+	for (size_t i = 0; i + 2 < windowCoords.size(); i += 3) {
+		const dvec4 &a = windowCoords[i].pos;
+		const dvec4 &b = windowCoords[i + 1].pos;
+		const dvec4 &c = windowCoords[i + 2].pos;
+		// The same pixel bounds drawFilledTriangle walks, within the scissor.
+		double left = std::floor(min(a.x, b.x, c.x));
+		double right = std::ceil(max(a.x, b.x, c.x));
+		double bottom = std::floor(min(a.y, b.y, c.y));
+		double top = std::ceil(max(a.y, b.y, c.y));
+		if (!(right >= xLo && left <= xHi && top >= yLo && bottom <= yHi)) {
+			continue;
+		}
+		int xMin = (int)std::max(left, xLo);
+		int xMax = (int)std::min(right, xHi);
+		int yMin = (int)std::max(bottom, yLo);
+		int yMax = (int)std::min(top, yHi);
+
+		int triangle = (int)triangleBatches.size();
+		vertices.push_back(windowCoords[i]);
+		vertices.push_back(windowCoords[i + 1]);
+		vertices.push_back(windowCoords[i + 2]);
+		triangleBatches.push_back(batch);
+		for (int ty = yMin / tileSize; ty <= yMax / tileSize; ty++) {
+			for (int tx = xMin / tileSize; tx <= xMax / tileSize; tx++) {
+				bins[ty * tilesAcross + tx].push_back(triangle);
+			}
+		}
+	}
+}
+
+/**
+ * @fn	void BinnedRasterizer::drawTile(const Tile &tile)
+ * @brief	Draws the part of every triangle in a tile's bin that lies in the tile
+ * 			and in its batch's scissor.
+ * @param	tile	The tile.
+ */
+
+void BinnedRasterizer::drawTile(const Tile &tile) {
+	const vector<int> &bin = bins[(tile.y0 / tileSize) * tilesAcross + tile.x0 / tileSize];
+	for (int triangle : bin) {
+		const Batch &batch = batches[triangleBatches[triangle]];
+		const VertexData *v = &vertices[3 * triangle];
+		BoundingBoxi scissor(std::max(tile.x0, batch.scissor.lx), std::min(tile.x1 - 1, batch.scissor.rx),
+								std::max(tile.y0, batch.scissor.ly), std::min(tile.y1 - 1, batch.scissor.ry));
+		drawFilledTriangle(*frameBuffer, batch.eyePos, batch.lights, v[0], v[1], v[2],
+							batch.viewingMatrix, scissor);
+	}
+}
+
+/**
+ * @fn	void BinnedRasterizer::flush()
+ * @brief	Draws every binned triangle, the tiles in parallel, and empties the bins.
+ * 			The triangles are drawn with the FragmentOps settings they were added
+ * 			with, and the caller's settings are put back afterwards. Returns once
+ * 			the frame buffer holds the result.
+ */
+
+void BinnedRasterizer::flush() {
+	if (frameBuffer == nullptr) {
+		return;
+	}
+	busyTiles.clear();
+	for (size_t i = 0; i < tiles.size(); i++) {
+		if (!bins[i].empty()) {
+			busyTiles.push_back(tiles[i]);
+		}
+	}
+	if (!busyTiles.empty()) {
+		FragmentState callersState = FragmentState::current();
+		fragmentState.makeCurrent();
+		scheduler.run(busyTiles, [this](const Tile &tile, int) {
+			drawTile(tile);
+		});
+		callersState.makeCurrent();
+	}
+	startFrame(*frameBuffer);
+}
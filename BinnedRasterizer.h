@@ -0,0 +1,95 @@
+/****************************************************
+ * 2016-2020 Eric Bachmann and Mike Zmuda
+ * All Rights Reserved.
+ * NOTICE:
+ * Dissemination of this information or reproduction
+ * of this material is prohibited unless prior written
+ * permission is granted..
+ ****************************************************/
+
+#pragma once
+
+#include "Defs.h"
+#include "FrameBuffer.h"
+#include "FragmentOps.h"
+#include "Light.h"
+#include "VertexData.h"
+#include "TileScheduler.h"
+
+/**
+ * @struct	BinnedRasterizer
+ * @brief	A sort-middle rasterizer. Filled triangles in window coordinates are
+ * 			sorted into the screen tiles their bounding boxes touch as they are
+ * 			added, and flush() draws the tiles in parallel. A tile is drawn by one
+ * 			worker, which alone writes that tile's pixels of the color and depth
+ * 			buffers, and which draws the tile's triangles in the order they were
+ * 			added. Every pixel therefore sees the same fragments in the same order
+ * 			as drawManyFilledTriangles would give it, and ends up the same.
+ *
+ * 			Each batch of triangles keeps its own eye position, lights, viewing
+ * 			matrix and scissor, so nothing the caller changes after adding it
+ * 			affects how it is drawn; the lights themselves must stay as they are
+ * 			until flush(). Triangles are drawn with the FragmentOps settings they
+ * 			were added with: when the settings change, the triangles already
+ * 			binned are drawn before the next ones are added.
+ */
+
+struct BinnedRasterizer {
+	static const int DEFAULT_TILE_SIZE = 64;
+	BinnedRasterizer(int numThreads = 0, int tileSize = DEFAULT_TILE_SIZE);
+	void addTriangles(FrameBuffer &frameBuffer, const dvec3 &eyePos,
+						const vector<LightSourcePtr> &lights,
+						const vector<VertexData> &windowCoords,
+						const dmat4 &viewingMatrix);
+	void addTriangles(FrameBuffer &frameBuffer, const dvec3 &eyePos,
+						const vector<LightSourcePtr> &lights,
+						const vector<VertexData> &windowCoords,
+						const dmat4 &viewingMatrix, const BoundingBoxi &scissor);
+	void flush();
+	int getNumThreads() const { return scheduler.getNumThreads(); }
+protected:
+	/**
+	 * @struct	Batch
+	 * @brief	What a set of triangles added together is drawn with.
+	 */
+	struct Batch {
+		dvec3 eyePos;
+		vector<LightSourcePtr> lights;
+		dmat4 viewingMatrix;
+		BoundingBoxi scissor;
+		Batch() : scissor(0, -1, 0, -1) {}
+		bool matches(const dvec3 &eye, const vector<LightSourcePtr> &lightList, const dmat4 &view,
+						const BoundingBoxi &box) const {
+			return eye == eyePos && lightList == lights && view == viewingMatrix &&
+					box.lx == scissor.lx && box.rx == scissor.rx && box.ly == scissor.ly && box.ry == scissor.ry;
+		}
+	};
+	/**
+	 * @struct	FragmentState
+	 * @brief	The FragmentOps settings that fragments are processed with.
+	 */
+	struct FragmentState {
+		bool performDepthTest;
+		bool readonlyDepthBuffer;
+		bool readonlyColorBuffer;
+		FogParams fogParams;
+		static FragmentState current();
+		void makeCurrent() const;
+		bool matches(const FragmentState &other) const;
+	};
+	void startFrame(FrameBuffer &frameBuffer);
+	void drawTile(const Tile &tile);
+	FrameBuffer *frameBuffer;		//!< Where the binned triangles go; null when nothing is binned.
+	int tileSize;
+	int width, height;				//!< Size of frameBuffer when it was cut into tiles.
+	int tilesAcross;
+	vector<Tile> tiles;				//!< The tiles of frameBuffer, row by row.
+	vector<vector<int>> bins;		//!< For each tile, the triangles touching it, in the order added.
+	vector<VertexData> vertices;	//!< Three per triangle, in the order added.
+	vector<int> triangleBatches;	//!< The batch of each triangle.
+	vector<Batch> batches;			//!< The first numBatches are in use; the rest are kept for reuse.
+	int numBatches;
+	FragmentState fragmentState;	//!< The settings the binned triangles were added with.
+	vector<Tile> busyTiles;			//!< The tiles with something to draw, while flushing.
+	TileScheduler scheduler;
+};
@@ -154,8 +154,8 @@ Ray OrthographicCamera::getRay(double x, double y) const {
 	/* CSE 386 - todo  */
 	dvec2 uv = getProjectionPlaneCoordinates(x, y);
 	
-	dvec3 rayOrigin = cameraFrame.origin + uv.x * cameraFrame.u +	uv.y * cameraFrame.v; // Page 76
-	return Ray(rayOrigin, -cameraFrame.w);
+	dvec3 rayOrigin = cameraFrame.origin + uv.y * cameraFrame.v + uv.x * cameraFrame.u; // Page 76
+	return Ray::withUnitDir(rayOrigin, -cameraFrame.w);
 }
 
 /**
@@ -169,9 +169,9 @@ Ray OrthographicCamera::getRay(double x, double y) const {
 Ray PerspectiveCamera::getRay(double x, double y) const {
 	dvec2 uv = getProjectionPlaneCoordinates(x, y);
 	dvec3 rayDirection = glm::normalize(-distToPlane * cameraFrame.w +
-											uv.x * cameraFrame.u + 
-											uv.y * cameraFrame.v); // Page 76
-	return Ray(cameraFrame.origin, rayDirection);
+											uv.y * cameraFrame.v +
+											uv.x * cameraFrame.u); // Page 76
+	return Ray::withUnitDir(cameraFrame.origin, rayDirection);
 }
 
 /**
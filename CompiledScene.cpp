@@ -0,0 +1,1186 @@
+/****************************************************
+ * 2016-2020 Eric Bachmann and Mike Zmuda
+ * All Rights Reserved.
+ * NOTICE:
+ * Dissemination of this information or reproduction
+ * of this material is prohibited unless prior written
+ * permission is granted..
+ ****************************************************/
+
+#include <typeinfo>
+#include "CompiledScene.h"
+#include "RenderStats.h"
+#include "Utilities.h"
+
+static_assert(SPHERE_TESTS + OTHER_SHAPE == OTHER_SHAPE_TESTS,
+				"the shape test counters must be in CompiledShapeType order");
+
+/**
+ * @fn	static int missOrQuadratic(double A, double B, double C, double roots[2])
+ * @brief	Same result as quadratic(), but rejects the common case of a miss before
+ * 			the square root and the call are paid for.
+ * @param 		  	A	 	The coefficient of x^2.
+ * @param 		  	B	 	The coefficient of x.
+ * @param 		  	C	 	The constant.
+ * @param [in,out]	roots	The real roots, in ascending order.
+ * @return	The number of real roots.
+ */
+
+static inline int missOrQuadratic(double A, double B, double C, double roots[2]) {
+	if (B * B - 4 * A * C < 0) {
+		return 0;
+	}
+	return quadratic(A, B, C, roots);
+}
+
+/**
+ * @fn	static int rootsInRange(double A, double B, double C, const Ray &ray, double roots[2])
+ * @brief	The real roots of a quadratic that lie within a ray's interval, found as
+ * 			missOrQuadratic finds them.
+ * @param 		  	A	 	The coefficient of x^2.
+ * @param 		  	B	 	The coefficient of x.
+ * @param 		  	C	 	The constant.
+ * @param 		  	ray  	The ray whose interval the roots must lie in.
+ * @param [in,out]	roots	The roots in the interval, in ascending order.
+ * @return	The number of roots in the interval.
+ */
+
+static inline int rootsInRange(double A, double B, double C, const Ray &ray, double roots[2]) {
+	double all[2];
+	int numRoots = missOrQuadratic(A, B, C, all);
+	int numInRange = 0;
+	for (int r = 0; r < numRoots; r++) {
+		if (ray.inRange(all[r])) {
+			roots[numInRange++] = all[r];
+		}
+	}
+	return numInRange;
+}
+
+/**
+ * @fn	CompiledShapeType CompiledScene::classify(const IShape *shape)
+ * @brief	Determines which block a shape is stored in. Only the exact classes are
+ * 			recognized, so that subclasses which override the intersection routines
+ * 			are still intersected through their own code.
+ * @param	shape	The shape.
+ * @return	The shape's block.
+ */
+
+CompiledShapeType CompiledScene::classify(const IShape *shape) {
+	const std::type_info &type = typeid(*shape);
+	if (type == typeid(ISphere)) {
+		return SPHERE_SHAPE;
+	} else if (type == typeid(IEllipsoid)) {
+		return ELLIPSOID_SHAPE;
+	} else if (type == typeid(ICylinderY) || type == typeid(IClosedCylinderY) ||
+				type == typeid(ICylinderZ)) {
+		return CYLINDER_SHAPE;
+	} else if (type == typeid(IPlane)) {
+		return PLANE_SHAPE;
+	} else if (type == typeid(IDisk)) {
+		return DISK_SHAPE;
+	} else if (type == typeid(ITriangle)) {
+		return TRIANGLE_SHAPE;
+	}
+	return OTHER_SHAPE;
+}
+
+/**
+ * @fn	void CompiledScene::clear()
+ * @brief	Removes all shapes.
+ */
+
+void CompiledScene::clear() {
+	*this = CompiledScene();
+}
+
+/**
+ * @fn	int CompiledScene::size() const
+ * @brief	Gets the total number of shapes in all blocks.
+ * @return	The number of shapes.
+ */
+
+int CompiledScene::size() const {
+	int total = 0;
+	for (int type = 0; type < NUM_COMPILED_SHAPE_TYPES; type++) {
+		total += (int)surfaces[type].size();
+	}
+	return total;
+}
+
+/**
+ * @fn	CompiledSpan CompiledScene::add(VisibleIShapePtr surface)
+ * @brief	Appends a copy of a surface's geometry to the end of its block.
+ * @param	surface	The surface.
+ * @return	A span covering just the new entry.
+ */
+
+CompiledSpan CompiledScene::add(VisibleIShapePtr surface) {
+	CompiledSpan span;
+	span.type = classify(surface->shape);
+	span.first = (int)surfaces[span.type].size();
+	span.count = 1;
+	surfaces[span.type].push_back(surface);
+	hasOrigin = false;
+
+	switch (span.type) {
+	case SPHERE_SHAPE: {
+		const ISphere *sphere = (const ISphere *)surface->shape;
+		spheres.cx.push_back(sphere->center.x);
+		spheres.cy.push_back(sphere->center.y);
+		spheres.cz.push_back(sphere->center.z);
+		spheres.J.push_back(sphere->getParams().J);
+		break;
+	}
+	case ELLIPSOID_SHAPE: {
+		const IEllipsoid *ellipsoid = (const IEllipsoid *)surface->shape;
+		const QuadricParameters &q = ellipsoid->getParams();
+		ellipsoids.cx.push_back(ellipsoid->center.x);
+		ellipsoids.cy.push_back(ellipsoid->center.y);
+		ellipsoids.cz.push_back(ellipsoid->center.z);
+		ellipsoids.A.push_back(q.A);
+		ellipsoids.B.push_back(q.B);
+		ellipsoids.C.push_back(q.C);
+		ellipsoids.J.push_back(q.J);
+		break;
+	}
+	case CYLINDER_SHAPE: {
+		const ICylinder *cylinder = (const ICylinder *)surface->shape;
+		const QuadricParameters &q = cylinder->getParams();
+		int axis = cylinder->axis();
+		cylinders.cx.push_back(cylinder->center.x);
+		cylinders.cy.push_back(cylinder->center.y);
+		cylinders.cz.push_back(cylinder->center.z);
+		cylinders.A.push_back(q.A);
+		cylinders.B.push_back(q.B);
+		cylinders.C.push_back(q.C);
+		cylinders.J.push_back(q.J);
+		cylinders.axis.push_back(axis);
+		cylinders.lo.push_back(cylinder->center[axis] - cylinder->length / 2);
+		cylinders.hi.push_back(cylinder->center[axis] + cylinder->length / 2);
+		break;
+	}
+	case PLANE_SHAPE: {
+		const IPlane *plane = (const IPlane *)surface->shape;
+		planes.ax.push_back(plane->a.x);
+		planes.ay.push_back(plane->a.y);
+		planes.az.push_back(plane->a.z);
+		planes.nx.push_back(plane->n.x);
+		planes.ny.push_back(plane->n.y);
+		planes.nz.push_back(plane->n.z);
+		break;
+	}
+	case DISK_SHAPE: {
+		const IDisk *disk = (const IDisk *)surface->shape;
+		dvec3 n = glm::normalize(disk->n);
+		disks.cx.push_back(disk->center.x);
+		disks.cy.push_back(disk->center.y);
+		disks.cz.push_back(disk->center.z);
+		disks.nx.push_back(n.x);
+		disks.ny.push_back(n.y);
+		disks.nz.push_back(n.z);
+		disks.radius.push_back(disk->radius);
+		break;
+	}
+	case TRIANGLE_SHAPE: {
+		const ITriangle *triangle = (const ITriangle *)surface->shape;
+		dvec3 N = glm::cross(triangle->b - triangle->a, triangle->c - triangle->a);
+		triangles.ax.push_back(triangle->a.x);
+		triangles.ay.push_back(triangle->a.y);
+		triangles.az.push_back(triangle->a.z);
+		triangles.bx.push_back(triangle->b.x);
+		triangles.by.push_back(triangle->b.y);
+		triangles.bz.push_back(triangle->b.z);
+		triangles.cx.push_back(triangle->c.x);
+		triangles.cy.push_back(triangle->c.y);
+		triangles.cz.push_back(triangle->c.z);
+		triangles.nx.push_back(triangle->plane.n.x);
+		triangles.ny.push_back(triangle->plane.n.y);
+		triangles.nz.push_back(triangle->plane.n.z);
+		triangles.Nx.push_back(N.x);
+		triangles.Ny.push_back(N.y);
+		triangles.Nz.push_back(N.z);
+		triangles.N2.push_back(std::pow(glm::length(N), 2.0));
+		break;
+	}
+	default:
+		break;
+	}
+	return span;
+}
+
+/**
+ * @fn	void CompiledScene::setOrigin(const dvec3 &rayOrigin)
+ * @brief	Computes, for every shape, the terms of its intersection equation that
+ * 			depend only on the ray's origin: Cq for the quadrics and the numerator
+ * 			of t for the plane-based shapes. Queries for rays starting at rayOrigin
+ * 			use them instead of recomputing them. Must not be called while another
+ * 			thread is querying the scene.
+ * @param	rayOrigin	The origin shared by the rays to come, e.g. the camera's.
+ */
+
+void CompiledScene::setOrigin(const dvec3 &rayOrigin) {
+	origin = rayOrigin;
+	hasOrigin = true;
+	spheres.originCq.resize(spheres.J.size());
+	for (int i = 0; i < size(SPHERE_SHAPE); i++) {
+		spheres.originCq[i] = sphereCq(i, origin);
+	}
+	ellipsoids.originCq.resize(ellipsoids.J.size());
+	for (int i = 0; i < size(ELLIPSOID_SHAPE); i++) {
+		ellipsoids.originCq[i] = ellipsoidCq(i, origin);
+	}
+	cylinders.originCq.resize(cylinders.J.size());
+	for (int i = 0; i < size(CYLINDER_SHAPE); i++) {
+		cylinders.originCq[i] = cylinderCq(i, origin);
+	}
+	planes.originNum.resize(planes.nx.size());
+	for (int i = 0; i < size(PLANE_SHAPE); i++) {
+		planes.originNum[i] = planeNumerator(i, origin);
+	}
+	disks.originNum.resize(disks.nx.size());
+	for (int i = 0; i < size(DISK_SHAPE); i++) {
+		disks.originNum[i] = diskNumerator(i, origin);
+	}
+	triangles.originNum.resize(triangles.nx.size());
+	for (int i = 0; i < size(TRIANGLE_SHAPE); i++) {
+		triangles.originNum[i] = triangleNumerator(i, origin);
+	}
+}
+
+/**
+ * @fn	bool CompiledScene::sharesOrigin(const RayPacket &packet) const
+ * @brief	Determines if every lane of a packet starts at the origin given to
+ * 			setOrigin, so the packet can use the origin terms.
+ * @param	packet	The packet.
+ * @return	True iff the origin terms apply to every lane.
+ */
+
+bool CompiledScene::sharesOrigin(const RayPacket &packet) const {
+	return hasOrigin && packet.sameOrigin && packet.ox[0] == origin.x &&
+			packet.oy[0] == origin.y && packet.oz[0] == origin.z;
+}
+
+/**
+ * @fn	HitRecord CompiledScene::findIntersection(const Ray &ray) const
+ * @brief	Finds the closest intersection with any shape in any block.
+ * @param	ray	The ray.
+ * @return	The closest intersection; t is FLT_MAX if nothing was hit.
+ */
+
+HitRecord CompiledScene::findIntersection(const Ray &ray) const {
+	double closestT = ray.tMax;
+	const VisibleIShape *closest = nullptr;
+	intersect(ray, closestT, closest);
+	HitRecord theHit;
+	if (closest != nullptr) {
+		closest->computeAttributes(ray, closestT, theHit);
+	}
+	return theHit;
+}
+
+/**
+ * @fn	const VisibleIShape *CompiledScene::findOccluder(const Ray &ray) const
+ * @brief	Any-hit query over every shape in every block.
+ * @param	ray	The ray.
+ * @return	A surface hit within the ray's interval, or null if there is none.
+ */
+
+const VisibleIShape *CompiledScene::findOccluder(const Ray &ray) const {
+	for (int type = 0; type < NUM_COMPILED_SHAPE_TYPES; type++) {
+		CompiledSpan span = { (CompiledShapeType)type, 0, size((CompiledShapeType)type) };
+		if (span.count > 0) {
+			const VisibleIShape *occluder = findOccluder(span, ray);
+			if (occluder != nullptr) {
+				return occluder;
+			}
+		}
+	}
+	return nullptr;
+}
+
+/**
+ * @fn	void CompiledScene::intersect(const Ray &ray, double &closestT, const VisibleIShape *&closest) const
+ * @brief	Intersects a ray with every shape in every block, keeping track of the
+ * 			closest hit.
+ * @param 		  	ray 	The ray.
+ * @param [in,out]	closestT	The closest t found so far; ray.tMax if none.
+ * @param [in,out]	closest 	The surface that produced closestT.
+ */
+
+void CompiledScene::intersect(const Ray &ray, double &closestT, const VisibleIShape *&closest) const {
+	for (int type = 0; type < NUM_COMPILED_SHAPE_TYPES; type++) {
+		CompiledSpan span = { (CompiledShapeType)type, 0, size((CompiledShapeType)type) };
+		if (span.count > 0) {
+			intersect(span, ray, closestT, closest);
+		}
+	}
+}
+
+/**
+ * @fn	void CompiledScene::intersect(const CompiledSpan &span, const Ray &ray, double &closestT, const VisibleIShape *&closest) const
+ * @brief	Intersects a ray with a span of shapes, keeping track of the closest hit.
+ * 			The shapes are tested against a copy of the ray whose tMax is the closest
+ * 			t so far, so a shape behind the closest hit is rejected as soon as its t
+ * 			is known.
+ * @param 		  	span	The shapes to test.
+ * @param 		  	ray 	The ray.
+ * @param [in,out]	closestT	The closest t found so far; ray.tMax if none.
+ * @param [in,out]	closest 	The surface that produced closestT.
+ */
+
+void CompiledScene::intersect(const CompiledSpan &span, const Ray &ray, double &closestT,
+								const VisibleIShape *&closest) const {
+	RenderStats::count((RenderCounter)(SPHERE_TESTS + span.type), span.count);
+	Ray query = ray;
+	query.tMax = closestT;
+	bool fromOrigin = sharesOrigin(ray);
+	switch (span.type) {
+	case SPHERE_SHAPE:
+		intersectBlock<&CompiledScene::sphereT>(span.type, span.first, span.count, query, fromOrigin, closest);
+		break;
+	case ELLIPSOID_SHAPE:
+		intersectBlock<&CompiledScene::ellipsoidT>(span.type, span.first, span.count, query, fromOrigin, closest);
+		break;
+	case CYLINDER_SHAPE:
+		intersectBlock<&CompiledScene::cylinderT>(span.type, span.first, span.count, query, fromOrigin, closest);
+		break;
+	case PLANE_SHAPE:
+		intersectBlock<&CompiledScene::planeT>(span.type, span.first, span.count, query, fromOrigin, closest);
+		break;
+	case DISK_SHAPE:
+		intersectBlock<&CompiledScene::diskT>(span.type, span.first, span.count, query, fromOrigin, closest);
+		break;
+	case TRIANGLE_SHAPE:
+		intersectBlock<&CompiledScene::triangleT>(span.type, span.first, span.count, query, fromOrigin, closest);
+		break;
+	default:
+		intersectBlock<&CompiledScene::otherT>(span.type, span.first, span.count, query, fromOrigin, closest);
+		break;
+	}
+	closestT = query.tMax;
+}
+
+/**
+ * @fn	const VisibleIShape *CompiledScene::findOccluder(const CompiledSpan &span, const Ray &ray) const
+ * @brief	Any-hit query over a span of shapes.
+ * @param	span	The shapes to test.
+ * @param	ray 	The ray.
+ * @return	A surface in the span hit within the ray's interval, or null if there
+ * 			is none.
+ */
+
+const VisibleIShape *CompiledScene::findOccluder(const CompiledSpan &span, const Ray &ray) const {
+	// Only hits closer than tMax matter, so a closest-hit search that starts at tMax
+	// finds a hit iff the span blocks the ray.
+	double closestT = ray.tMax;
+	const VisibleIShape *closest = nullptr;
+	intersect(span, ray, closestT, closest);
+	return closest;
+}
+
+/**
+ * @fn	int CompiledScene::findRoots(CompiledShapeType type, int i, const Ray &ray, double roots[2]) const
+ * @brief	Every place within the ray's interval where the ray crosses one shape,
+ * 			not just the closest. Shapes in the OTHER_SHAPE block only report their
+ * 			closest crossing, since IShape has no way to ask for more.
+ * @param 		  	type	  	The shape's block.
+ * @param 		  	i		  	Index of the shape in its block.
+ * @param 		  	ray		  	The ray.
+ * @param 		  	fromOrigin	The value of sharesOrigin(ray).
+ * @param [in,out]	roots	  	The t values of the crossings, in ascending order.
+ * @return	The number of crossings.
+ */
+
+int CompiledScene::findRoots(CompiledShapeType type, int i, const Ray &ray, bool fromOrigin, double roots[2]) const {
+	double t;
+	switch (type) {
+	case SPHERE_SHAPE:
+		return sphereRoots(i, ray, fromOrigin, roots);
+	case ELLIPSOID_SHAPE:
+		return ellipsoidRoots(i, ray, fromOrigin, roots);
+	case CYLINDER_SHAPE:
+		return cylinderRoots(i, ray, fromOrigin, roots);
+	case PLANE_SHAPE:
+		t = planeT(i, ray, fromOrigin);
+		break;
+	case DISK_SHAPE:
+		t = diskT(i, ray, fromOrigin);
+		break;
+	case TRIANGLE_SHAPE:
+		t = triangleT(i, ray, fromOrigin);
+		break;
+	default:
+		t = otherT(i, ray, fromOrigin);
+		break;
+	}
+	roots[0] = t;
+	return t < FLT_MAX ? 1 : 0;
+}
+
+/**
+ * @fn	double CompiledScene::sphereCq(int i, const dvec3 &rayOrigin) const
+ * @brief	The part of ISphere::computeAqBqCq that depends only on the ray's origin.
+ * @param	i		 	Index of the sphere.
+ * @param	rayOrigin	The ray's origin.
+ * @return	Cq.
+ */
+
+double CompiledScene::sphereCq(int i, const dvec3 &rayOrigin) const {
+	dvec3 Ro = rayOrigin - dvec3(spheres.cx[i], spheres.cy[i], spheres.cz[i]);
+	return (Ro.x * Ro.x) + (Ro.y * Ro.y) + (Ro.z * Ro.z) + spheres.J[i];
+}
+
+/**
+ * @fn	int CompiledScene::sphereRoots(int i, const Ray &ray, bool fromOrigin, double roots[2]) const
+ * @brief	Same computation as ISphere::computeAqBqCq followed by IQuadricSurface::intersectT,
+ * 			but keeping every root in the ray's interval.
+ * @param 		  	i		  	Index of the sphere.
+ * @param 		  	ray		  	The ray.
+ * @param 		  	fromOrigin	True if the ray starts at the origin given to setOrigin.
+ * @param [in,out]	roots	  	The roots in the ray's interval, in ascending order.
+ * @return	The number of such roots.
+ */
+
+int CompiledScene::sphereRoots(int i, const Ray &ray, bool fromOrigin, double roots[2]) const {
+	dvec3 Ro = ray.origin - dvec3(spheres.cx[i], spheres.cy[i], spheres.cz[i]);
+	const dvec3 &Rd = ray.dir;
+	double Aq = (Rd.x * Rd.x) + (Rd.y * Rd.y) + (Rd.z * Rd.z);
+	double Bq = 2 * Ro.x * Rd.x + 2 * Ro.y * Rd.y + 2 * Ro.z * Rd.z;
+	double Cq = fromOrigin ? spheres.originCq[i] : sphereCq(i, ray.origin);
+	return rootsInRange(Aq, Bq, Cq, ray, roots);
+}
+
+/**
+ * @fn	double CompiledScene::sphereT(int i, const Ray &ray, bool fromOrigin) const
+ * @brief	Same computation as ISphere::computeAqBqCq followed by IQuadricSurface::intersectT.
+ * @param	i		  	Index of the sphere.
+ * @param	ray		  	The ray.
+ * @param	fromOrigin	True if the ray starts at the origin given to setOrigin.
+ * @return	The smallest root in the ray's interval, or FLT_MAX if there is none.
+ */
+
+double CompiledScene::sphereT(int i, const Ray &ray, bool fromOrigin) const {
+	double roots[2];
+	return sphereRoots(i, ray, fromOrigin, roots) > 0 ? roots[0] : FLT_MAX;
+}
+
+/**
+ * @fn	double CompiledScene::ellipsoidCq(int i, const dvec3 &rayOrigin) const
+ * @brief	The part of IEllipsoid::computeAqBqCq that depends only on the ray's origin.
+ * @param	i		 	Index of the ellipsoid.
+ * @param	rayOrigin	The ray's origin.
+ * @return	Cq.
+ */
+
+double CompiledScene::ellipsoidCq(int i, const dvec3 &rayOrigin) const {
+	dvec3 Ro = rayOrigin - dvec3(ellipsoids.cx[i], ellipsoids.cy[i], ellipsoids.cz[i]);
+	return ellipsoids.A[i] * (Ro.x * Ro.x) + ellipsoids.B[i] * (Ro.y * Ro.y) +
+			ellipsoids.C[i] * (Ro.z * Ro.z) + ellipsoids.J[i];
+}
+
+/**
+ * @fn	int CompiledScene::ellipsoidRoots(int i, const Ray &ray, bool fromOrigin, double roots[2]) const
+ * @brief	Same computation as IEllipsoid::computeAqBqCq followed by IQuadricSurface::intersectT,
+ * 			but keeping every root in the ray's interval.
+ * @param 		  	i		  	Index of the ellipsoid.
+ * @param 		  	ray		  	The ray.
+ * @param 		  	fromOrigin	True if the ray starts at the origin given to setOrigin.
+ * @param [in,out]	roots	  	The roots in the ray's interval, in ascending order.
+ * @return	The number of such roots.
+ */
+
+int CompiledScene::ellipsoidRoots(int i, const Ray &ray, bool fromOrigin, double roots[2]) const {
+	const double A = ellipsoids.A[i];
+	const double B = ellipsoids.B[i];
+	const double C = ellipsoids.C[i];
+	dvec3 Ro = ray.origin - dvec3(ellipsoids.cx[i], ellipsoids.cy[i], ellipsoids.cz[i]);
+	const dvec3 &Rd = ray.dir;
+	double Aq = A * (Rd.x * Rd.x) + B * (Rd.y * Rd.y) + C * (Rd.z * Rd.z);
+	double Bq = 2 * A * Ro.x * Rd.x + 2 * B * Ro.y * Rd.y + 2 * C * Ro.z * Rd.z;
+	double Cq = fromOrigin ? ellipsoids.originCq[i] : ellipsoidCq(i, ray.origin);
+	return rootsInRange(Aq, Bq, Cq, ray, roots);
+}
+
+/**
+ * @fn	double CompiledScene::ellipsoidT(int i, const Ray &ray, bool fromOrigin) const
+ * @brief	Same computation as IEllipsoid::computeAqBqCq followed by IQuadricSurface::intersectT.
+ * @param	i		  	Index of the ellipsoid.
+ * @param	ray		  	The ray.
+ * @param	fromOrigin	True if the ray starts at the origin given to setOrigin.
+ * @return	The smallest root in the ray's interval, or FLT_MAX if there is none.
+ */
+
+double CompiledScene::ellipsoidT(int i, const Ray &ray, bool fromOrigin) const {
+	double roots[2];
+	return ellipsoidRoots(i, ray, fromOrigin, roots) > 0 ? roots[0] : FLT_MAX;
+}
+
+/**
+ * @fn	double CompiledScene::cylinderCq(int i, const dvec3 &rayOrigin) const
+ * @brief	The part of ICylinder::computeAqBqCq that depends only on the ray's origin.
+ * @param	i		 	Index of the cylinder.
+ * @param	rayOrigin	The ray's origin.
+ * @return	Cq.
+ */
+
+double CompiledScene::cylinderCq(int i, const dvec3 &rayOrigin) const {
+	dvec3 Ro = rayOrigin - dvec3(cylinders.cx[i], cylinders.cy[i], cylinders.cz[i]);
+	return cylinders.A[i] * (Ro.x * Ro.x) + cylinders.B[i] * (Ro.y * Ro.y) +
+			cylinders.C[i] * (Ro.z * Ro.z) + cylinders.J[i];
+}
+
+/**
+ * @fn	int CompiledScene::cylinderRoots(int i, const Ray &ray, bool fromOrigin, double roots[2]) const
+ * @brief	Same computation as ICylinder::intersectT, but keeping every root in the
+ * 			ray's interval that lies on the cylinder.
+ * @param 		  	i		  	Index of the cylinder.
+ * @param 		  	ray		  	The ray.
+ * @param 		  	fromOrigin	True if the ray starts at the origin given to setOrigin.
+ * @param [in,out]	roots	  	The roots on the cylinder, in ascending order.
+ * @return	The number of such roots.
+ */
+
+int CompiledScene::cylinderRoots(int i, const Ray &ray, bool fromOrigin, double roots[2]) const {
+	const double A = cylinders.A[i];
+	const double B = cylinders.B[i];
+	const double C = cylinders.C[i];
+	dvec3 Ro = ray.origin - dvec3(cylinders.cx[i], cylinders.cy[i], cylinders.cz[i]);
+	const dvec3 &Rd = ray.dir;
+	double Aq = A * (Rd.x * Rd.x) + B * (Rd.y * Rd.y) + C * (Rd.z * Rd.z);
+	double Bq = 2.0 * A * Ro.x * Rd.x + 2.0 * B * Ro.y * Rd.y + 2.0 * C * Ro.z * Rd.z;
+	double Cq = fromOrigin ? cylinders.originCq[i] : cylinderCq(i, ray.origin);
+	double all[2];
+	int numRoots = missOrQuadratic(Aq, Bq, Cq, all);
+	const int axis = cylinders.axis[i];
+	int numOnCylinder = 0;
+	for (int r = 0; r < numRoots; r++) {
+		if (ray.inRange(all[r])) {
+			double coord = (ray.origin + all[r] * ray.dir)[axis];
+			if (coord < cylinders.hi[i] && coord > cylinders.lo[i]) {
+				roots[numOnCylinder++] = all[r];
+			}
+		}
+	}
+	return numOnCylinder;
+}
+
+/**
+ * @fn	double CompiledScene::cylinderT(int i, const Ray &ray, bool fromOrigin) const
+ * @brief	Same computation as ICylinder::intersectT.
+ * @param	i		  	Index of the cylinder.
+ * @param	ray		  	The ray.
+ * @param	fromOrigin	True if the ray starts at the origin given to setOrigin.
+ * @return	The smallest root on the cylinder in the ray's interval, or FLT_MAX if
+ * 			there is none.
+ */
+
+double CompiledScene::cylinderT(int i, const Ray &ray, bool fromOrigin) const {
+	double roots[2];
+	return cylinderRoots(i, ray, fromOrigin, roots) > 0 ? roots[0] : FLT_MAX;
+}
+
+/**
+ * @fn	double CompiledScene::planeNumerator(int i, const dvec3 &rayOrigin) const
+ * @brief	The numerator of IPlane::intersectT's t, which depends only on the ray's origin.
+ * @param	i		 	Index of the plane.
+ * @param	rayOrigin	The ray's origin.
+ * @return	dot(a - rayOrigin, n).
+ */
+
+double CompiledScene::planeNumerator(int i, const dvec3 &rayOrigin) const {
+	dvec3 a(planes.ax[i], planes.ay[i], planes.az[i]);
+	return glm::dot(a - rayOrigin, dvec3(planes.nx[i], planes.ny[i], planes.nz[i]));
+}
+
+/**
+ * @fn	double CompiledScene::planeT(int i, const Ray &ray, bool fromOrigin) const
+ * @brief	Same computation as IPlane::intersectT.
+ * @param	i		  	Index of the plane.
+ * @param	ray		  	The ray.
+ * @param	fromOrigin	True if the ray starts at the origin given to setOrigin.
+ * @return	The t value of the intersection, or FLT_MAX if there is none.
+ */
+
+double CompiledScene::planeT(int i, const Ray &ray, bool fromOrigin) const {
+	dvec3 n(planes.nx[i], planes.ny[i], planes.nz[i]);
+	double denom = glm::dot(ray.dir, n);
+	if (approximatelyZero(denom)) {
+		return FLT_MAX;
+	}
+	double num = fromOrigin ? planes.originNum[i] : planeNumerator(i, ray.origin);
+	double t = num / denom;
+	return ray.inRange(t) ? t : FLT_MAX;
+}
+
+/**
+ * @fn	double CompiledScene::diskNumerator(int i, const dvec3 &rayOrigin) const
+ * @brief	The numerator of IDisk::intersectT's t, which depends only on the ray's origin.
+ * @param	i		 	Index of the disk.
+ * @param	rayOrigin	The ray's origin.
+ * @return	dot(center - rayOrigin, n).
+ */
+
+double CompiledScene::diskNumerator(int i, const dvec3 &rayOrigin) const {
+	dvec3 center(disks.cx[i], disks.cy[i], disks.cz[i]);
+	return glm::dot(center - rayOrigin, dvec3(disks.nx[i], disks.ny[i], disks.nz[i]));
+}
+
+/**
+ * @fn	double CompiledScene::diskT(int i, const Ray &ray, bool fromOrigin) const
+ * @brief	Same computation as IDisk::intersectT.
+ * @param	i		  	Index of the disk.
+ * @param	ray		  	The ray.
+ * @param	fromOrigin	True if the ray starts at the origin given to setOrigin.
+ * @return	The t value of the intersection, or FLT_MAX if there is none.
+ */
+
+double CompiledScene::diskT(int i, const Ray &ray, bool fromOrigin) const {
+	dvec3 n(disks.nx[i], disks.ny[i], disks.nz[i]);
+	double denom = glm::dot(ray.dir, n);
+	if (approximatelyZero(denom)) {
+		return FLT_MAX;
+	}
+	dvec3 center(disks.cx[i], disks.cy[i], disks.cz[i]);
+	double num = fromOrigin ? disks.originNum[i] : diskNumerator(i, ray.origin);
+	double t = num / denom;
+	if (!ray.inRange(t) || glm::distance(center, ray.getPoint(t)) > disks.radius[i]) {
+		return FLT_MAX;
+	}
+	return t;
+}
+
+/**
+ * @fn	double CompiledScene::triangleNumerator(int i, const dvec3 &rayOrigin) const
+ * @brief	The numerator of ITriangle::intersectT's t, which depends only on the ray's origin.
+ * @param	i		 	Index of the triangle.
+ * @param	rayOrigin	The ray's origin.
+ * @return	dot(b - rayOrigin, n).
+ */
+
+double CompiledScene::triangleNumerator(int i, const dvec3 &rayOrigin) const {
+	dvec3 b(triangles.bx[i], triangles.by[i], triangles.bz[i]);
+	return glm::dot(b - rayOrigin, dvec3(triangles.nx[i], triangles.ny[i], triangles.nz[i]));
+}
+
+/**
+ * @fn	double CompiledScene::triangleT(int i, const Ray &ray, bool fromOrigin) const
+ * @brief	Same computation as ITriangle::intersectT.
+ * @param	i		  	Index of the triangle.
+ * @param	ray		  	The ray.
+ * @param	fromOrigin	True if the ray starts at the origin given to setOrigin.
+ * @return	The t value of the intersection, or FLT_MAX if there is none.
+ */
+
+double CompiledScene::triangleT(int i, const Ray &ray, bool fromOrigin) const {
+	dvec3 n(triangles.nx[i], triangles.ny[i], triangles.nz[i]);
+	double denom = glm::dot(ray.dir, n);
+	if (approximatelyZero(denom)) {
+		return FLT_MAX;
+	}
+	double num = fromOrigin ? triangles.originNum[i] : triangleNumerator(i, ray.origin);
+	double t = num / denom;
+	if (!ray.inRange(t)) {
+		return FLT_MAX;
+	}
+
+	// Barycentric inside test, as in ITriangle::inside.
+	dvec3 a(triangles.ax[i], triangles.ay[i], triangles.az[i]);
+	dvec3 b(triangles.bx[i], triangles.by[i], triangles.bz[i]);
+	dvec3 c(triangles.cx[i], triangles.cy[i], triangles.cz[i]);
+	dvec3 pt = ray.getPoint(t);
+	dvec3 N(triangles.Nx[i], triangles.Ny[i], triangles.Nz[i]);
+	double n2 = triangles.N2[i];
+	double alpha = glm::dot(N, glm::cross(c - b, pt - b)) / n2;
+	double beta = glm::dot(N, glm::cross(a - c, pt - c)) / n2;
+	double gamma = glm::dot(N, glm::cross(b - a, pt - a)) / n2;
+	if (inRangeExclusive(beta, 0, 1) && inRangeExclusive(gamma, 0, 1) && inRangeExclusive(alpha, 0, 1)) {
+		return t;
+	}
+	return FLT_MAX;
+}
+
+/**
+ * @fn	double CompiledScene::otherT(int i, const Ray &ray, bool fromOrigin) const
+ * @brief	Intersects a ray with a shape in the OTHER_SHAPE block, through IShape.
+ * @param	i		  	Index of the shape.
+ * @param	ray		  	The ray.
+ * @param	fromOrigin	Unused; IShape has no terms cached for the origin.
+ * @return	The t value of the intersection, or FLT_MAX if there is none.
+ */
+
+double CompiledScene::otherT(int i, const Ray &ray, bool) const {
+	return surfaces[OTHER_SHAPE][i]->intersectT(ray);
+}
+
+/**
+ * @fn	template <double (CompiledScene::*shapeT)(int, const Ray &, bool) const> void CompiledScene::intersectBlock(CompiledShapeType type, int first, int count, Ray &ray, bool fromOrigin, const VisibleIShape *&closest) const
+ * @brief	Intersects a ray with a run of shapes in one block, keeping track of the
+ * 			closest hit. shapeT is the block's single ray intersection, so each block
+ * 			gets its own loop with the call inlined.
+ * @param 		  	type	  	The block.
+ * @param 		  	first	  	Index of the first shape to test.
+ * @param 		  	count	  	The number of shapes to test.
+ * @param [in,out]	ray		  	The ray. Its tMax is lowered to each closer hit.
+ * @param 		  	fromOrigin	The value of sharesOrigin(ray).
+ * @param [in,out]	closest   	The surface that produced ray.tMax.
+ */
+
+template <double (CompiledScene::*shapeT)(int, const Ray &, bool) const>
+void CompiledScene::intersectBlock(CompiledShapeType type, int first, int count, Ray &ray, bool fromOrigin,
+									const VisibleIShape *&closest) const {
+	for (int i = first; i < first + count; i++) {
+		double t = (this->*shapeT)(i, ray, fromOrigin);
+		if (t < ray.tMax) {
+			ray.tMax = t;
+			closest = surfaces[type][i];
+		}
+	}
+}
+
+/*
+ * Packet versions. Each routine walks the packet SIMD_WIDTH lanes at a time and
+ * repeats, lane by lane, the arithmetic of the single ray routine above, so the
+ * lanes find the same closest t as tracing each ray on its own would.
+ */
+
+/**
+ * @struct	PacketLanes
+ * @brief	SIMD_WIDTH lanes of a packet, loaded into registers.
+ */
+
+struct PacketLanes {
+	vdouble ox, oy, oz;
+	vdouble dx, dy, dz;
+	vdouble tMin, closestT;
+
+	PacketLanes(const RayPacket &packet, int base) {
+		ox = vload(packet.ox + base);
+		oy = vload(packet.oy + base);
+		oz = vload(packet.oz + base);
+		dx = vload(packet.dx + base);
+		dy = vload(packet.dy + base);
+		dz = vload(packet.dz + base);
+		tMin = vload(packet.tMin + base);
+		closestT = vload(packet.closestT + base);
+	}
+	void record(vdouble t, unsigned chunk, const VisibleIShape *surface, const VisibleIShape **closest) {
+		unsigned hits = vbits(vlt(t, closestT)) & chunk;
+		if (hits != 0) {
+			closestT = vselect(vmaskFromBits(hits), t, closestT);
+			for (int j = 0; j < SIMD_WIDTH; j++) {
+				if ((hits >> j) & 1) {
+					closest[j] = surface;
+				}
+			}
+		}
+	}
+};
+
+/**
+ * @fn	static inline void packetQuadratic(vdouble Aq, vdouble Bq, vdouble Cq, vdouble &lo, vdouble &hi)
+ * @brief	Lane by lane version of quadratic().
+ * @param 		  	Aq	The coefficient of x^2.
+ * @param 		  	Bq	The coefficient of x.
+ * @param 		  	Cq	The constant.
+ * @param [in,out]	lo	The smaller root; FLT_MAX in lanes without real roots.
+ * @param [in,out]	hi	The larger root; FLT_MAX in lanes without real roots.
+ */
+
+static inline void packetQuadratic(vdouble Aq, vdouble Bq, vdouble Cq, vdouble &lo, vdouble &hi) {
+	const vdouble zero = vset1(0.0);
+	const vdouble none = vset1(FLT_MAX);
+	vdouble disc = vsub(vmul(Bq, Bq), vmul(vmul(vset1(4.0), Aq), Cq));
+	vmask real = vge(disc, zero);
+	vdouble discRoot = vsqrt(vmax(disc, zero));
+	vdouble denom = vmul(vset1(2.0), Aq);
+	vdouble negB = vsub(zero, Bq);
+	vdouble root1 = vdiv(vadd(negB, discRoot), denom);
+	vdouble root2 = vdiv(vsub(negB, discRoot), denom);
+	lo = vselect(real, vmin(root2, root1), none);
+	hi = vselect(real, vmax(root2, root1), none);
+}
+
+/**
+ * @fn	static inline vdouble packetFirstAfter(vdouble lo, vdouble hi, vdouble tMin)
+ * @brief	Picks the smallest root beyond tMin in each lane. Roots beyond the lane's
+ * 			tMax are left for PacketLanes::record to reject.
+ * @param	lo  	The smaller roots.
+ * @param	hi  	The larger roots.
+ * @param	tMin	The start of each lane's interval.
+ * @return	The smallest root greater than tMin, or FLT_MAX if neither is.
+ */
+
+static inline vdouble packetFirstAfter(vdouble lo, vdouble hi, vdouble tMin) {
+	return vselect(vgt(lo, tMin), lo, vselect(vgt(hi, tMin), hi, vset1(FLT_MAX)));
+}
+
+/**
+ * @fn	static inline vmask packetFacing(vdouble denom)
+ * @brief	Lane by lane negation of approximatelyZero().
+ * @param	denom	The values to test.
+ * @return	Lanes where denom is not within EPSILON of zero.
+ */
+
+static inline vmask packetFacing(vdouble denom) {
+	return vor(vle(denom, vset1(-EPSILON)), vge(denom, vset1(EPSILON)));
+}
+
+/**
+ * @fn	void CompiledScene::intersect(RayPacket &packet, unsigned lanes) const
+ * @brief	Intersects the lanes of a packet with every shape in every block.
+ * @param [in,out]	packet	The packet; each lane's closest hit is updated.
+ * @param 		  	lanes 	The lanes to trace.
+ */
+
+void CompiledScene::intersect(RayPacket &packet, unsigned lanes) const {
+	for (int type = 0; type < NUM_COMPILED_SHAPE_TYPES; type++) {
+		CompiledSpan span = { (CompiledShapeType)type, 0, size((CompiledShapeType)type) };
+		if (span.count > 0) {
+			intersect(span, packet, lanes);
+		}
+	}
+}
+
+/**
+ * @fn	void CompiledScene::intersect(const CompiledSpan &span, RayPacket &packet, unsigned lanes) const
+ * @brief	Intersects the lanes of a packet with a span of shapes.
+ * @param 		  	span  	The shapes to test.
+ * @param [in,out]	packet	The packet; each lane's closest hit is updated.
+ * @param 		  	lanes 	The lanes to trace.
+ */
+
+void CompiledScene::intersect(const CompiledSpan &span, RayPacket &packet, unsigned lanes) const {
+	RenderStats::count((RenderCounter)(SPHERE_TESTS + span.type), span.count * RayPacket::countLanes(lanes));
+	bool fromOrigin = sharesOrigin(packet);
+	switch (span.type) {
+	case SPHERE_SHAPE:
+		intersectSpheres(span.first, span.count, packet, lanes, fromOrigin);
+		break;
+	case ELLIPSOID_SHAPE:
+		intersectEllipsoids(span.first, span.count, packet, lanes, fromOrigin);
+		break;
+	case CYLINDER_SHAPE:
+		intersectCylinders(span.first, span.count, packet, lanes, fromOrigin);
+		break;
+	case PLANE_SHAPE:
+		intersectPlanes(span.first, span.count, packet, lanes, fromOrigin);
+		break;
+	case DISK_SHAPE:
+		intersectDisks(span.first, span.count, packet, lanes, fromOrigin);
+		break;
+	case TRIANGLE_SHAPE:
+		intersectTriangles(span.first, span.count, packet, lanes, fromOrigin);
+		break;
+	default:
+		intersectOthers(span.first, span.count, packet, lanes);
+		break;
+	}
+}
+
+/**
+ * @fn	void CompiledScene::intersectSpheres(int first, int count, RayPacket &packet, unsigned lanes, bool fromOrigin) const
+ * @brief	Lane by lane version of sphereT(). The direction's Aq is the same
+ * 			for every sphere, so it is computed once per SIMD_WIDTH lanes.
+ * @param 		  	first	  	Index of the first sphere to test.
+ * @param 		  	count	  	The number of spheres to test.
+ * @param [in,out]	packet	  	The packet; each lane's closest hit is updated.
+ * @param 		  	lanes	  	The lanes to trace.
+ * @param 		  	fromOrigin	The value of sharesOrigin(packet).
+ */
+
+void CompiledScene::intersectSpheres(int first, int count, RayPacket &packet, unsigned lanes,
+										bool fromOrigin) const {
+	const vdouble two = vset1(2.0);
+	for (int base = 0; base < RayPacket::SIZE; base += SIMD_WIDTH) {
+		unsigned chunk = (lanes >> base) & SIMD_LANES;
+		if (chunk == 0) {
+			continue;
+		}
+		PacketLanes r(packet, base);
+		vdouble Aq = vadd(vadd(vmul(r.dx, r.dx), vmul(r.dy, r.dy)), vmul(r.dz, r.dz));
+		for (int i = first; i < first + count; i++) {
+			vdouble Rox = vsub(r.ox, vset1(spheres.cx[i]));
+			vdouble Roy = vsub(r.oy, vset1(spheres.cy[i]));
+			vdouble Roz = vsub(r.oz, vset1(spheres.cz[i]));
+			vdouble Bq = vadd(vadd(vmul(vmul(two, Rox), r.dx), vmul(vmul(two, Roy), r.dy)), vmul(vmul(two, Roz), r.dz));
+			vdouble Cq = fromOrigin ? vset1(spheres.originCq[i]) :
+							vadd(vadd(vadd(vmul(Rox, Rox), vmul(Roy, Roy)), vmul(Roz, Roz)), vset1(spheres.J[i]));
+			vdouble lo, hi;
+			packetQuadratic(Aq, Bq, Cq, lo, hi);
+			r.record(packetFirstAfter(lo, hi, r.tMin), chunk, surfaces[SPHERE_SHAPE][i], packet.closest + base);
+		}
+		vstore(packet.closestT + base, r.closestT);
+	}
+}
+
+/**
+ * @fn	void CompiledScene::intersectEllipsoids(int first, int count, RayPacket &packet, unsigned lanes, bool fromOrigin) const
+ * @brief	Lane by lane version of ellipsoidT(). The squared direction
+ * 			components are computed once per SIMD_WIDTH lanes and scaled by each
+ * 			ellipsoid's A, B and C.
+ * @param 		  	first	  	Index of the first ellipsoid to test.
+ * @param 		  	count	  	The number of ellipsoids to test.
+ * @param [in,out]	packet	  	The packet; each lane's closest hit is updated.
+ * @param 		  	lanes	  	The lanes to trace.
+ * @param 		  	fromOrigin	The value of sharesOrigin(packet).
+ */
+
+void CompiledScene::intersectEllipsoids(int first, int count, RayPacket &packet, unsigned lanes,
+										bool fromOrigin) const {
+	const vdouble two = vset1(2.0);
+	for (int base = 0; base < RayPacket::SIZE; base += SIMD_WIDTH) {
+		unsigned chunk = (lanes >> base) & SIMD_LANES;
+		if (chunk == 0) {
+			continue;
+		}
+		PacketLanes r(packet, base);
+		vdouble dx2 = vmul(r.dx, r.dx);
+		vdouble dy2 = vmul(r.dy, r.dy);
+		vdouble dz2 = vmul(r.dz, r.dz);
+		for (int i = first; i < first + count; i++) {
+			vdouble A = vset1(ellipsoids.A[i]);
+			vdouble B = vset1(ellipsoids.B[i]);
+			vdouble C = vset1(ellipsoids.C[i]);
+			vdouble Rox = vsub(r.ox, vset1(ellipsoids.cx[i]));
+			vdouble Roy = vsub(r.oy, vset1(ellipsoids.cy[i]));
+			vdouble Roz = vsub(r.oz, vset1(ellipsoids.cz[i]));
+			vdouble Aq = vadd(vadd(vmul(A, dx2), vmul(B, dy2)), vmul(C, dz2));
+			vdouble Bq = vadd(vadd(vmul(vmul(vmul(two, A), Rox), r.dx), vmul(vmul(vmul(two, B), Roy), r.dy)),
+							vmul(vmul(vmul(two, C), Roz), r.dz));
+			vdouble Cq = fromOrigin ? vset1(ellipsoids.originCq[i]) :
+							vadd(vadd(vadd(vmul(A, vmul(Rox, Rox)), vmul(B, vmul(Roy, Roy))), vmul(C, vmul(Roz, Roz))),
+									vset1(ellipsoids.J[i]));
+			vdouble lo, hi;
+			packetQuadratic(Aq, Bq, Cq, lo, hi);
+			r.record(packetFirstAfter(lo, hi, r.tMin), chunk, surfaces[ELLIPSOID_SHAPE][i], packet.closest + base);
+		}
+		vstore(packet.closestT + base, r.closestT);
+	}
+}
+
+/**
+ * @fn	void CompiledScene::intersectCylinders(int first, int count, RayPacket &packet, unsigned lanes, bool fromOrigin) const
+ * @brief	Lane by lane version of cylinderT(). Both roots of the
+ * 			side's quadratic are tested against the cylinder's ends, and the first
+ * 			one between them counts.
+ * @param 		  	first	  	Index of the first cylinder to test.
+ * @param 		  	count	  	The number of cylinders to test.
+ * @param [in,out]	packet	  	The packet; each lane's closest hit is updated.
+ * @param 		  	lanes	  	The lanes to trace.
+ * @param 		  	fromOrigin	The value of sharesOrigin(packet).
+ */
+
+void CompiledScene::intersectCylinders(int first, int count, RayPacket &packet, unsigned lanes,
+										bool fromOrigin) const {
+	const vdouble two = vset1(2.0);
+	for (int base = 0; base < RayPacket::SIZE; base += SIMD_WIDTH) {
+		unsigned chunk = (lanes >> base) & SIMD_LANES;
+		if (chunk == 0) {
+			continue;
+		}
+		PacketLanes r(packet, base);
+		vdouble dx2 = vmul(r.dx, r.dx);
+		vdouble dy2 = vmul(r.dy, r.dy);
+		vdouble dz2 = vmul(r.dz, r.dz);
+		for (int i = first; i < first + count; i++) {
+			vdouble A = vset1(cylinders.A[i]);
+			vdouble B = vset1(cylinders.B[i]);
+			vdouble C = vset1(cylinders.C[i]);
+			vdouble Rox = vsub(r.ox, vset1(cylinders.cx[i]));
+			vdouble Roy = vsub(r.oy, vset1(cylinders.cy[i]));
+			vdouble Roz = vsub(r.oz, vset1(cylinders.cz[i]));
+			vdouble Aq = vadd(vadd(vmul(A, dx2), vmul(B, dy2)), vmul(C, dz2));
+			vdouble Bq = vadd(vadd(vmul(vmul(vmul(two, A), Rox), r.dx), vmul(vmul(vmul(two, B), Roy), r.dy)),
+							vmul(vmul(vmul(two, C), Roz), r.dz));
+			vdouble Cq = fromOrigin ? vset1(cylinders.originCq[i]) :
+							vadd(vadd(vadd(vmul(A, vmul(Rox, Rox)), vmul(B, vmul(Roy, Roy))), vmul(C, vmul(Roz, Roz))),
+									vset1(cylinders.J[i]));
+			vdouble lo, hi;
+			packetQuadratic(Aq, Bq, Cq, lo, hi);
+
+			// A root only counts if it lies between the cylinder's ends.
+			const int axis = cylinders.axis[i];
+			vdouble o = axis == 0 ? r.ox : (axis == 1 ? r.oy : r.oz);
+			vdouble d = axis == 0 ? r.dx : (axis == 1 ? r.dy : r.dz);
+			vdouble bottom = vset1(cylinders.lo[i]);
+			vdouble top = vset1(cylinders.hi[i]);
+			vdouble coordLo = vadd(o, vmul(lo, d));
+			vdouble coordHi = vadd(o, vmul(hi, d));
+			vmask loOnCylinder = vand(vgt(lo, r.tMin), vand(vlt(coordLo, top), vgt(coordLo, bottom)));
+			vmask hiOnCylinder = vand(vgt(hi, r.tMin), vand(vlt(coordHi, top), vgt(coordHi, bottom)));
+			vdouble t = vselect(loOnCylinder, lo, vselect(hiOnCylinder, hi, vset1(FLT_MAX)));
+			r.record(t, chunk, surfaces[CYLINDER_SHAPE][i], packet.closest + base);
+		}
+		vstore(packet.closestT + base, r.closestT);
+	}
+}
+
+/**
+ * @fn	void CompiledScene::intersectPlanes(int first, int count, RayPacket &packet, unsigned lanes, bool fromOrigin) const
+ * @brief	Lane by lane version of planeT(). Lanes whose rays run along
+ * 			the plane miss it.
+ * @param 		  	first	  	Index of the first plane to test.
+ * @param 		  	count	  	The number of planes to test.
+ * @param [in,out]	packet	  	The packet; each lane's closest hit is updated.
+ * @param 		  	lanes	  	The lanes to trace.
+ * @param 		  	fromOrigin	The value of sharesOrigin(packet).
+ */
+
+void CompiledScene::intersectPlanes(int first, int count, RayPacket &packet, unsigned lanes,
+										bool fromOrigin) const {
+	for (int base = 0; base < RayPacket::SIZE; base += SIMD_WIDTH) {
+		unsigned chunk = (lanes >> base) & SIMD_LANES;
+		if (chunk == 0) {
+			continue;
+		}
+		PacketLanes r(packet, base);
+		for (int i = first; i < first + count; i++) {
+			vdouble nx = vset1(planes.nx[i]);
+			vdouble ny = vset1(planes.ny[i]);
+			vdouble nz = vset1(planes.nz[i]);
+			vdouble denom = vadd(vadd(vmul(r.dx, nx), vmul(r.dy, ny)), vmul(r.dz, nz));
+			vdouble num = fromOrigin ? vset1(planes.originNum[i]) :
+							vadd(vadd(vmul(vsub(vset1(planes.ax[i]), r.ox), nx),
+										vmul(vsub(vset1(planes.ay[i]), r.oy), ny)),
+									vmul(vsub(vset1(planes.az[i]), r.oz), nz));
+			vdouble t = vdiv(num, denom);
+			t = vselect(vand(packetFacing(denom), vgt(t, r.tMin)), t, vset1(FLT_MAX));
+			r.record(t, chunk, surfaces[PLANE_SHAPE][i], packet.closest + base);
+		}
+		vstore(packet.closestT + base, r.closestT);
+	}
+}
+
+/**
+ * @fn	void CompiledScene::intersectDisks(int first, int count, RayPacket &packet, unsigned lanes, bool fromOrigin) const
+ * @brief	Lane by lane version of diskT(): the t where the ray meets the
+ * 			disk's plane counts if that point is within the radius of the center.
+ * @param 		  	first	  	Index of the first disk to test.
+ * @param 		  	count	  	The number of disks to test.
+ * @param [in,out]	packet	  	The packet; each lane's closest hit is updated.
+ * @param 		  	lanes	  	The lanes to trace.
+ * @param 		  	fromOrigin	The value of sharesOrigin(packet).
+ */
+
+void CompiledScene::intersectDisks(int first, int count, RayPacket &packet, unsigned lanes,
+										bool fromOrigin) const {
+	for (int base = 0; base < RayPacket::SIZE; base += SIMD_WIDTH) {
+		unsigned chunk = (lanes >> base) & SIMD_LANES;
+		if (chunk == 0) {
+			continue;
+		}
+		PacketLanes r(packet, base);
+		for (int i = first; i < first + count; i++) {
+			vdouble nx = vset1(disks.nx[i]);
+			vdouble ny = vset1(disks.ny[i]);
+			vdouble nz = vset1(disks.nz[i]);
+			vdouble cx = vset1(disks.cx[i]);
+			vdouble cy = vset1(disks.cy[i]);
+			vdouble cz = vset1(disks.cz[i]);
+			vdouble denom = vadd(vadd(vmul(r.dx, nx), vmul(r.dy, ny)), vmul(r.dz, nz));
+			vdouble num = fromOrigin ? vset1(disks.originNum[i]) :
+							vadd(vadd(vmul(vsub(cx, r.ox), nx), vmul(vsub(cy, r.oy), ny)), vmul(vsub(cz, r.oz), nz));
+			vdouble t = vdiv(num, denom);
+			vdouble ex = vsub(vadd(r.ox, vmul(t, r.dx)), cx);
+			vdouble ey = vsub(vadd(r.oy, vmul(t, r.dy)), cy);
+			vdouble ez = vsub(vadd(r.oz, vmul(t, r.dz)), cz);
+			vdouble dist = vsqrt(vadd(vadd(vmul(ex, ex), vmul(ey, ey)), vmul(ez, ez)));
+			vmask hit = vand(packetFacing(denom), vand(vgt(t, r.tMin), vle(dist, vset1(disks.radius[i]))));
+			r.record(vselect(hit, t, vset1(FLT_MAX)), chunk, surfaces[DISK_SHAPE][i], packet.closest + base);
+		}
+		vstore(packet.closestT + base, r.closestT);
+	}
+}
+
+/**
+ * @fn	void CompiledScene::intersectTriangles(int first, int count, RayPacket &packet, unsigned lanes, bool fromOrigin) const
+ * @brief	Lane by lane version of triangleT(). The barycentric inside
+ * 			test is skipped for a triangle unless some lane meets its plane closer
+ * 			than that lane's closest hit.
+ * @param 		  	first	  	Index of the first triangle to test.
+ * @param 		  	count	  	The number of triangles to test.
+ * @param [in,out]	packet	  	The packet; each lane's closest hit is updated.
+ * @param 		  	lanes	  	The lanes to trace.
+ * @param 		  	fromOrigin	The value of sharesOrigin(packet).
+ */
+
+void CompiledScene::intersectTriangles(int first, int count, RayPacket &packet, unsigned lanes,
+										bool fromOrigin) const {
+	const vdouble zero = vset1(0.0);
+	const vdouble one = vset1(1.0);
+	for (int base = 0; base < RayPacket::SIZE; base += SIMD_WIDTH) {
+		unsigned chunk = (lanes >> base) & SIMD_LANES;
+		if (chunk == 0) {
+			continue;
+		}
+		PacketLanes r(packet, base);
+		for (int i = first; i < first + count; i++) {
+			vdouble nx = vset1(triangles.nx[i]);
+			vdouble ny = vset1(triangles.ny[i]);
+			vdouble nz = vset1(triangles.nz[i]);
+			vdouble denom = vadd(vadd(vmul(r.dx, nx), vmul(r.dy, ny)), vmul(r.dz, nz));
+			vmask hit = packetFacing(denom);
+			if (vbits(hit) == 0) {
+				continue;
+			}
+			vdouble ax = vset1(triangles.ax[i]), ay = vset1(triangles.ay[i]), az = vset1(triangles.az[i]);
+			vdouble bx = vset1(triangles.bx[i]), by = vset1(triangles.by[i]), bz = vset1(triangles.bz[i]);
+			vdouble cx = vset1(triangles.cx[i]), cy = vset1(triangles.cy[i]), cz = vset1(triangles.cz[i]);
+			vdouble num = fromOrigin ? vset1(triangles.originNum[i]) :
+							vadd(vadd(vmul(vsub(bx, r.ox), nx), vmul(vsub(by, r.oy), ny)), vmul(vsub(bz, r.oz), nz));
+			vdouble t = vdiv(num, denom);
+			// Skip the inside test unless some lane's t is closer than its closest hit.
+			hit = vand(hit, vand(vgt(t, r.tMin), vlt(t, r.closestT)));
+			if ((vbits(hit) & chunk) == 0) {
+				continue;
+			}
+
+			// Barycentric inside test, as in ITriangle::inside.
+			vdouble px = vadd(r.ox, vmul(t, r.dx));
+			vdouble py = vadd(r.oy, vmul(t, r.dy));
+			vdouble pz = vadd(r.oz, vmul(t, r.dz));
+			vdouble Nx = vset1(triangles.Nx[i]), Ny = vset1(triangles.Ny[i]), Nz = vset1(triangles.Nz[i]);
+			vdouble n2 = vset1(triangles.N2[i]);
+			vdouble ux[3] = { vsub(cx, bx), vsub(ax, cx), vsub(bx, ax) };
+			vdouble uy[3] = { vsub(cy, by), vsub(ay, cy), vsub(by, ay) };
+			vdouble uz[3] = { vsub(cz, bz), vsub(az, cz), vsub(bz, az) };
+			vdouble sx[3] = { bx, cx, ax };
+			vdouble sy[3] = { by, cy, ay };
+			vdouble sz[3] = { bz, cz, az };
+			for (int k = 0; k < 3; k++) {
+				vdouble vx = vsub(px, sx[k]);
+				vdouble vy = vsub(py, sy[k]);
+				vdouble vz = vsub(pz, sz[k]);
+				vdouble crossX = vsub(vmul(uy[k], vz), vmul(vy, uz[k]));
+				vdouble crossY = vsub(vmul(uz[k], vx), vmul(vz, ux[k]));
+				vdouble crossZ = vsub(vmul(ux[k], vy), vmul(vx, uy[k]));
+				vdouble bary = vdiv(vadd(vadd(vmul(Nx, crossX), vmul(Ny, crossY)), vmul(Nz, crossZ)), n2);
+				hit = vand(hit, vand(vgt(bary, zero), vlt(bary, one)));
+			}
+			r.record(vselect(hit, t, vset1(FLT_MAX)), chunk, surfaces[TRIANGLE_SHAPE][i], packet.closest + base);
+		}
+		vstore(packet.closestT + base, r.closestT);
+	}
+}
+
+/**
+ * @fn	void CompiledScene::intersectOthers(int first, int count, RayPacket &packet, unsigned lanes) const
+ * @brief	Intersects the lanes of a packet with shapes in the OTHER_SHAPE block.
+ * 			IShape only takes one ray at a time, so each lane is traced on its own.
+ * @param 		  	first 	Index of the first shape to test.
+ * @param 		  	count 	The number of shapes to test.
+ * @param [in,out]	packet	The packet; each lane's closest hit is updated.
+ * @param 		  	lanes 	The lanes to trace.
+ */
+
+void CompiledScene::intersectOthers(int first, int count, RayPacket &packet, unsigned lanes) const {
+	for (int lane = 0; lane < RayPacket::SIZE; lane++) {
+		if ((lanes >> lane) & 1) {
+			Ray query = packet.rays[lane];
+			query.tMax = packet.closestT[lane];
+			intersectBlock<&CompiledScene::otherT>(OTHER_SHAPE, first, count, query, false, packet.closest[lane]);
+			packet.closestT[lane] = query.tMax;
+		}
+	}
+}
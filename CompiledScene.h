@@ -0,0 +1,147 @@
+/****************************************************
+ * 2016-2020 Eric Bachmann and Mike Zmuda
+ * All Rights Reserved.
+ * NOTICE:
+ * Dissemination of this information or reproduction
+ * of this material is prohibited unless prior written
+ * permission is granted..
+ ****************************************************/
+
+#pragma once
+#include <vector>
+#include "Defs.h"
+#include "IShape.h"
+#include "RayPacket.h"
+
+/**
+ * @enum	CompiledShapeType
+ * @brief	The kinds of shape that a CompiledScene stores in their own blocks.
+ * 			OTHER_SHAPE covers everything else, which is intersected through the
+ * 			virtual IShape interface.
+ */
+
+enum CompiledShapeType {
+	SPHERE_SHAPE, ELLIPSOID_SHAPE, CYLINDER_SHAPE, PLANE_SHAPE, DISK_SHAPE,
+	TRIANGLE_SHAPE, OTHER_SHAPE, NUM_COMPILED_SHAPE_TYPES
+};
+
+/**
+ * @struct	CompiledSpan
+ * @brief	A run of consecutive shapes, all of one type, within a CompiledScene.
+ */
+
+struct CompiledSpan {
+	CompiledShapeType type;		//!< The block the shapes are in.
+	int first;					//!< Index of the first shape in the block.
+	int count;					//!< Number of shapes.
+	bool transparent = false;	//!< True if the shapes are transparent; see BVH::findLayers.
+};
+
+/**
+ * @struct	CompiledScene
+ * @brief	Flat, structure-of-arrays copy of a set of visible shapes, built for fast
+ * 			intersection testing. Each shape type has its own block of arrays, and each
+ * 			block is intersected by a loop written for that type, so no virtual calls
+ * 			are made until the closest hit's attributes are computed. The IShape classes
+ * 			remain the way scenes are described; a CompiledScene is rebuilt from them.
+ *
+ * 			setOrigin caches, for every shape, the terms of its intersection equation
+ * 			that depend only on the ray's origin. Rays from that origin, such as the
+ * 			primary rays of a perspective camera, then skip computing them.
+ */
+
+struct CompiledScene {
+	void clear();
+	CompiledSpan add(VisibleIShapePtr surface);
+	HitRecord findIntersection(const Ray &ray) const;
+	bool occluded(const Ray &ray) const { return findOccluder(ray) != nullptr; }
+	const VisibleIShape *findOccluder(const Ray &ray) const;
+	void intersect(const Ray &ray, double &closestT, const VisibleIShape *&closest) const;
+	void intersect(const CompiledSpan &span, const Ray &ray, double &closestT,
+					const VisibleIShape *&closest) const;
+	const VisibleIShape *findOccluder(const CompiledSpan &span, const Ray &ray) const;
+	int findRoots(CompiledShapeType type, int i, const Ray &ray, bool fromOrigin, double roots[2]) const;
+	VisibleIShapePtr getSurface(CompiledShapeType type, int i) const { return surfaces[type][i]; }
+	void intersect(RayPacket &packet, unsigned lanes) const;
+	void intersect(const CompiledSpan &span, RayPacket &packet, unsigned lanes) const;
+	void setOrigin(const dvec3 &rayOrigin);
+	bool sharesOrigin(const Ray &ray) const { return hasOrigin && ray.origin == origin; }
+	bool sharesOrigin(const RayPacket &packet) const;
+	int size() const;
+	int size(CompiledShapeType type) const { return (int)surfaces[type].size(); }
+	static CompiledShapeType classify(const IShape *shape);
+protected:
+	template <double (CompiledScene::*shapeT)(int, const Ray &, bool) const>
+	void intersectBlock(CompiledShapeType type, int first, int count, Ray &ray, bool fromOrigin,
+						const VisibleIShape *&closest) const;
+	void intersectSpheres(int first, int count, RayPacket &packet, unsigned lanes, bool fromOrigin) const;
+	void intersectEllipsoids(int first, int count, RayPacket &packet, unsigned lanes, bool fromOrigin) const;
+	void intersectCylinders(int first, int count, RayPacket &packet, unsigned lanes, bool fromOrigin) const;
+	void intersectPlanes(int first, int count, RayPacket &packet, unsigned lanes, bool fromOrigin) const;
+	void intersectDisks(int first, int count, RayPacket &packet, unsigned lanes, bool fromOrigin) const;
+	void intersectTriangles(int first, int count, RayPacket &packet, unsigned lanes, bool fromOrigin) const;
+	void intersectOthers(int first, int count, RayPacket &packet, unsigned lanes) const;
+	int sphereRoots(int i, const Ray &ray, bool fromOrigin, double roots[2]) const;
+	int ellipsoidRoots(int i, const Ray &ray, bool fromOrigin, double roots[2]) const;
+	int cylinderRoots(int i, const Ray &ray, bool fromOrigin, double roots[2]) const;
+	double sphereT(int i, const Ray &ray, bool fromOrigin) const;
+	double ellipsoidT(int i, const Ray &ray, bool fromOrigin) const;
+	double cylinderT(int i, const Ray &ray, bool fromOrigin) const;
+	double planeT(int i, const Ray &ray, bool fromOrigin) const;
+	double diskT(int i, const Ray &ray, bool fromOrigin) const;
+	double triangleT(int i, const Ray &ray, bool fromOrigin) const;
+	double otherT(int i, const Ray &ray, bool fromOrigin) const;
+	double sphereCq(int i, const dvec3 &rayOrigin) const;
+	double ellipsoidCq(int i, const dvec3 &rayOrigin) const;
+	double cylinderCq(int i, const dvec3 &rayOrigin) const;
+	double planeNumerator(int i, const dvec3 &rayOrigin) const;
+	double diskNumerator(int i, const dvec3 &rayOrigin) const;
+	double triangleNumerator(int i, const dvec3 &rayOrigin) const;
+
+	vector<VisibleIShapePtr> surfaces[NUM_COMPILED_SHAPE_TYPES];	//!< The original surface of every entry, per block.
+	dvec3 origin;						//!< The ray origin the origin terms were computed for.
+	bool hasOrigin = false;				//!< True if the origin terms are current.
+
+	struct {
+		vector<double> cx, cy, cz;		//!< centers
+		vector<double> J;				//!< -radius^2
+		vector<double> originCq;		//!< Cq of a ray from origin
+	} spheres;
+
+	struct {
+		vector<double> cx, cy, cz;		//!< centers
+		vector<double> A, B, C, J;		//!< quadric coefficients
+		vector<double> originCq;		//!< Cq of a ray from origin
+	} ellipsoids;
+
+	struct {
+		vector<double> cx, cy, cz;		//!< centers
+		vector<double> A, B, C, J;		//!< quadric coefficients
+		vector<int> axis;				//!< 0, 1 or 2 for x, y or z
+		vector<double> lo, hi;			//!< extent along the axis
+		vector<double> originCq;		//!< Cq of a ray from origin
+	} cylinders;
+
+	struct {
+		vector<double> ax, ay, az;		//!< point on the plane
+		vector<double> nx, ny, nz;		//!< unit normal
+		vector<double> originNum;		//!< dot(a - origin, n)
+	} planes;
+
+	struct {
+		vector<double> cx, cy, cz;		//!< centers
+		vector<double> nx, ny, nz;		//!< unit normals
+		vector<double> radius;
+		vector<double> originNum;		//!< dot(center - origin, n)
+	} disks;
+
+	struct {
+		vector<double> ax, ay, az;		//!< first vertex
+		vector<double> bx, by, bz;		//!< second vertex, which is also on the plane
+		vector<double> cx, cy, cz;		//!< third vertex
+		vector<double> nx, ny, nz;		//!< unit normal of the plane
+		vector<double> Nx, Ny, Nz;		//!< unnormalized normal, cross(b - a, c - a)
+		vector<double> N2;				//!< squared length of (Nx, Ny, Nz)
+		vector<double> originNum;		//!< dot(b - origin, n)
+	} triangles;
+};
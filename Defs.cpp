@@ -94,6 +94,106 @@ double BoundingBox3D::depth() const {
 	return lz - rz;
 }
 
+/**
+ * @fn	AABB::AABB()
+ * @brief	Constructs an empty bounding box.
+ */
+
+AABB::AABB()
+	: lo(DBL_MAX, DBL_MAX, DBL_MAX), hi(-DBL_MAX, -DBL_MAX, -DBL_MAX) {
+}
+
+/**
+ * @fn	AABB::AABB(const dvec3 &lower, const dvec3 &upper)
+ * @brief	Constructs a bounding box from its two extreme corners.
+ * @param	lower	Corner with the smallest coordinates.
+ * @param	upper	Corner with the largest coordinates.
+ */
+
+AABB::AABB(const dvec3 &lower, const dvec3 &upper)
+	: lo(lower), hi(upper) {
+}
+
+/**
+ * @fn	void AABB::expand(const dvec3 &pt)
+ * @brief	Grows the box so that it contains a point.
+ * @param	pt	The point to enclose.
+ */
+
+void AABB::expand(const dvec3 &pt) {
+	lo = glm::min(lo, pt);
+	hi = glm::max(hi, pt);
+}
+
+/**
+ * @fn	void AABB::expand(const AABB &box)
+ * @brief	Grows the box so that it contains another box.
+ * @param	box	The box to enclose.
+ */
+
+void AABB::expand(const AABB &box) {
+	lo = glm::min(lo, box.lo);
+	hi = glm::max(hi, box.hi);
+}
+
+/**
+ * @fn	bool AABB::isEmpty() const
+ * @brief	Determines if the box encloses nothing.
+ * @return	True iff the box is empty.
+ */
+
+bool AABB::isEmpty() const {
+	return lo.x > hi.x || lo.y > hi.y || lo.z > hi.z;
+}
+
+/**
+ * @fn	dvec3 AABB::centroid() const
+ * @brief	Gets the center of the box.
+ * @return	The center of the box.
+ */
+
+dvec3 AABB::centroid() const {
+	return (lo + hi) * 0.5;
+}
+
+/**
+ * @fn	dvec3 AABB::extent() const
+ * @brief	Gets the size of the box along each axis.
+ * @return	The width, height, and depth of the box.
+ */
+
+dvec3 AABB::extent() const {
+	return hi - lo;
+}
+
+/**
+ * @fn	double AABB::surfaceArea() const
+ * @brief	Computes the surface area of the box. Used by the surface area heuristic.
+ * @return	Surface area of the box; 0 if the box is empty.
+ */
+
+double AABB::surfaceArea() const {
+	if (isEmpty()) {
+		return 0.0;
+	}
+	dvec3 d = extent();
+	return 2.0 * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+/**
+ * @fn	int AABB::longestAxis() const
+ * @brief	Determines which axis the box is longest along.
+ * @return	0, 1, or 2 for x, y, or z.
+ */
+
+int AABB::longestAxis() const {
+	dvec3 d = extent();
+	if (d.x >= d.y && d.x >= d.z) {
+		return 0;
+	}
+	return d.y >= d.z ? 1 : 2;
+}
+
 /**
  * @fn	void Frame::setInverse()
  * @brief	Sets the inverse based on the current parameters.
@@ -14,10 +14,16 @@
 #include <cmath>
 #include <memory>
 #include <limits>
+#include <cfloat>
 
 // Glut takes care of all the system-specific chores required for creating windows, 
-// initializing OpenGL contexts, and handling input events
+// initializing OpenGL contexts, and handling input events. Define HEADLESS to build
+// the library without a window system; frames can then only be written to files.
+#ifndef HEADLESS
 #include <GL/freeglut.h>
+#else
+typedef unsigned char GLubyte;
+#endif
 
 #define GLM_FORCE_CTOR_INIT
 #define GLM_FORCE_SWIZZLE  // Enable GLM "swizzle" operators
@@ -130,6 +136,26 @@ struct BoundingBox3D {
 	double depth() const;
 };
 
+/**
+ * @struct	AABB
+ * @brief	An axis-aligned bounding box in 3D, described by its two extreme corners.
+ * 			A default constructed box is empty; expanding it by any point makes it valid.
+ */
+
+struct AABB {
+	dvec3 lo;	//!< corner with the smallest x, y, and z
+	dvec3 hi;	//!< corner with the largest x, y, and z
+	AABB();
+	AABB(const dvec3 &lower, const dvec3 &upper);
+	void expand(const dvec3 &pt);
+	void expand(const AABB &box);
+	bool isEmpty() const;
+	dvec3 centroid() const;
+	dvec3 extent() const;
+	double surfaceArea() const;
+	int longestAxis() const;
+};
+
 /**
  * @struct	Frame
  * @brief	Represents a coordinate frame
@@ -12,6 +12,7 @@
 #include <vector>
 #include "EShape.h"
 #include "Light.h"
+#include "RenderStats.h"
 #include "VertexOps.h"
 
 PositionalLightPtr theLight = new PositionalLight(dvec3(2, 1, 3), pureWhiteLight);
@@ -27,6 +28,16 @@ const double SPEED = 0.1;
 
 FrameBuffer frameBuffer(WINDOW_WIDTH, WINDOW_HEIGHT);
 
+/**
+ * The rasterizer is made on first use, after RenderStats' statics, so that its
+ * worker threads are joined before those are destroyed.
+ */
+
+BinnedRasterizer &rasterizer() {
+	static BinnedRasterizer theRasterizer;
+	return theRasterizer;
+}
+
 EShapeData plane = EShape::createECheckerBoard(copper, polishedCopper, 5, 5, 10);
 EShapeData cone1 = EShape::createECone(gold, 2.0, 1.0, 8);
 EShapeData cone2 = EShape::createECone(brass, 0.5, 0.5, 8);
@@ -47,6 +58,7 @@ void renderObjects() {
 }
 
 static void render() {
+	RenderStats::beginFrame();
 	frameBuffer.clearColorAndDepthBuffers();
 	int width = frameBuffer.getWindowWidth();
 	int height = frameBuffer.getWindowHeight();
@@ -55,7 +67,9 @@ static void render() {
 	VertexOps::projectionTrans = glm::perspective(PI_3, AR, 0.5, 80.0);
 	VertexOps::setViewport(0, width - 1, 0, height - 1);
 	renderObjects();
+	rasterizer().flush();
 	frameBuffer.showColorBuffer();
+	RenderStats::endFrame();
 }
 
 void resize(int width, int height) {
@@ -86,7 +100,9 @@ void keyboard(unsigned char key, int x, int y) {
 	case 'p':	isMoving = !isMoving;
 		break;
 	case 'C':
-	case 'c':	break;
+	case 'c':	VertexOps::renderBackFaces = !VertexOps::renderBackFaces;
+		cout << (VertexOps::renderBackFaces ? "Rendering" : "Culling") << " back faces" << endl;
+		break;
 	case ESCAPE:
 		glutLeaveMainLoop();
 		break;
@@ -107,6 +123,8 @@ static void timer(int id) {
 
 int main(int argc, char* argv[]) {
 	VertexOps::renderBackFaces = true;
+	VertexOps::binnedRasterizer = &rasterizer();
+	RenderStats::logFrames = true;
 	graphicsInit(argc, argv, __FILE__);
 
 	glutDisplayFunc(render);
@@ -18,6 +18,7 @@
 #include "Image.h"
 #include "Camera.h"
 #include "Rasterization.h"
+#include "RenderStats.h"
 
 double z = 0.0;
 double inc = 0.2;
@@ -30,14 +31,9 @@ PerspectiveCamera pCamera(dvec3(0, 10, 10), dvec3(0, 0, 0), Y_AXIS, PI_2);
 IScene scene(&pCamera);
 
 void render() {
-	int frameStartTime = glutGet(GLUT_ELAPSED_TIME);
-
 	double N = 10.0;
 	rayTrace.raytraceScene(frameBuffer, 0, scene);
-
-	int frameEndTime = glutGet(GLUT_ELAPSED_TIME); // Get end time
-	double totalTimeSec = (frameEndTime - frameStartTime) / 1000.0;
-	cout << "Render time: " << totalTimeSec << " sec." << endl;
+	cout << RenderStats::lastFrame() << endl;
 }
 
 void resize(int width, int height) {
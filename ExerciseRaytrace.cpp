@@ -18,6 +18,7 @@
 #include "Image.h"
 #include "Camera.h"
 #include "Rasterization.h"
+#include "RenderStats.h"
 
 int currLight = 0;
 double z = 0.0;
@@ -37,15 +38,13 @@ PerspectiveCamera pCamera(dvec3(0, 5, 10), dvec3(0, 5, 0), Y_AXIS, PI_2);
 IScene scene(&pCamera);
 
 void render() {
-	int frameStartTime = glutGet(GLUT_ELAPSED_TIME);
-
 	double N = 10.0;
 	pCamera.changeConfiguration(dvec3(0, 5, 10), dvec3(0, 5, 0), Y_AXIS);
 	rayTrace.raytraceScene(frameBuffer, 0, scene);
-
-	int frameEndTime = glutGet(GLUT_ELAPSED_TIME); // Get end time
-	double totalTimeSec = (frameEndTime - frameStartTime) / 1000.0;
-	cout << "Render time: " << totalTimeSec << " sec." << endl;
+	cout << RenderStats::lastFrame() << endl;
+	if (rayTrace.isRefining()) {
+		glutPostRedisplay();		// keep filling in the full resolution while idle
+	}
 }
 
 void resize(int width, int height) {
@@ -94,6 +93,7 @@ int main(int argc, char *argv[]) {
 	buildScene();
 
 	rayTrace.defaultColor = gray;
+	rayTrace.frameBudgetMs = 1000.0 / 30.0;
 	glutMainLoop();
 
 	return 0;
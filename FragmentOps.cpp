@@ -8,6 +8,7 @@
  ****************************************************/
 
 #include "FragmentOps.h"
+#include "RenderStats.h"
 
 FogParams FragmentOps::fogParams;
 bool FragmentOps::performDepthTest = true;
@@ -75,7 +76,7 @@ color FragmentOps::applyBlending(double alpha, const color &srcColor, const colo
 }
 
 /**
- * @fn	void FragmentOps::processFragment(FrameBuffer &frameBuffer, const dvec3 &eyePositionInWorldCoords, const vector<LightSourcePtr> lights, const Fragment &fragment, const dmat4 &viewingMatrix)
+ * @fn	void FragmentOps::processFragment(FrameBuffer &frameBuffer, const dvec3 &eyePositionInWorldCoords, const vector<LightSourcePtr> &lights, const Fragment &fragment, const dmat4 &viewingMatrix)
  * @brief	Process the fragment, leaving the results in the framebuffer.
  * @param [in,out]	frameBuffer	                The frame buffer
  * @param 		  	eyePositionInWorldCoords	The eye position in world coordinates.
@@ -85,7 +86,7 @@ color FragmentOps::applyBlending(double alpha, const color &srcColor, const colo
  */
 
 void FragmentOps::processFragment(FrameBuffer &frameBuffer, const dvec3 &eyePositionInWorldCoords,
-										const vector<LightSourcePtr> lights,
+										const vector<LightSourcePtr> &lights,
 										const Fragment &fragment,
 										const dmat4 &viewingMatrix) {
 	const dvec3 &eyePos = eyePositionInWorldCoords;
@@ -95,6 +96,8 @@ void FragmentOps::processFragment(FrameBuffer &frameBuffer, const dvec3 &eyePosi
 	int Y = (int)fragment.windowPos.y;
 	DEBUG_PIXEL = (X == xDebug && Y == yDebug);
 	bool passDepthTest = !performDepthTest || Z < frameBuffer.getDepth(X, Y);
+	RenderStats::count(FRAGMENTS_GENERATED);
+	RenderStats::count(passDepthTest ? FRAGMENTS_SHADED : FRAGMENTS_DEPTH_REJECTED);
 	if (passDepthTest) {
 		if (DEBUG_PIXEL) {
 			cout << endl;
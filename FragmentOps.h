@@ -55,7 +55,7 @@ class FragmentOps {
 		static bool readonlyColorBuffer;	//!< True ==> rendering will not affect color buffer. Typically false
 		static FogParams fogParams;			//!< Parameters controlling fog effects.
 		static void processFragment(FrameBuffer &frameBuffer, const dvec3 &eyePositionInWorldCoords,
-									const vector<LightSourcePtr> lights, 
+									const vector<LightSourcePtr> &lights, 
 									const Fragment &fragment,
 									const dmat4 &viewingMatrix);
 	protected:
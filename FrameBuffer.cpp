@@ -7,6 +7,7 @@
  * permission is granted..
  ****************************************************/
 
+#include <fstream>
 #include "Defs.h"
 #include "Utilities.h"
 #include "FrameBuffer.h"
@@ -18,7 +19,8 @@
  * @param	height	The height.
  */
 
-FrameBuffer::FrameBuffer(const int width, const int height) : window(width, height) {
+FrameBuffer::FrameBuffer(const int width, const int height)
+	: window(width, height), colorBuffer(nullptr), depthBuffer(nullptr) {
 	setFrameBufferSize(width, height);
 }
 
@@ -81,13 +83,185 @@ void FrameBuffer::clearColorAndDepthBuffers() {
 
 /**
  * @fn	void FrameBuffer::showColorBuffer() const
- * @brief	Shows the contents of the color buffer to screen.
+ * @brief	Shows the contents of the color buffer to screen. Does nothing in a
+ * 			HEADLESS build.
  */
 
 void FrameBuffer::showColorBuffer() const {
+#ifndef HEADLESS
 	glRasterPos2d(-1, -1);
 	glDrawPixels(window.width, window.height, GL_RGB, GL_UNSIGNED_BYTE, colorBuffer);
 	glFlush();
+#endif
+}
+
+/**
+ * @fn	bool FrameBuffer::writeImage(const string &fileName) const
+ * @brief	Writes the color buffer to an image file. The format is chosen by the
+ * 			file's extension: ".png" gives PNG, and anything else gives binary PPM.
+ * @param	fileName	Name of the file.
+ * @return	True iff the file was written.
+ */
+
+bool FrameBuffer::writeImage(const string &fileName) const {
+	size_t dot = fileName.rfind('.');
+	string extension = dot == string::npos ? "" : fileName.substr(dot);
+	if (extension == ".png" || extension == ".PNG") {
+		return writePNG(fileName);
+	}
+	return writePPM(fileName);
+}
+
+/**
+ * @fn	bool FrameBuffer::writePPM(const string &fileName) const
+ * @brief	Writes the color buffer as a binary (P6) PPM file, top row first.
+ * @param	fileName	Name of the file.
+ * @return	True iff the file was written.
+ */
+
+bool FrameBuffer::writePPM(const string &fileName) const {
+	std::ofstream output(fileName.c_str(), std::ios::binary);
+	if (!output) {
+		std::cerr << "Cannot write PPM file: " << fileName << endl;
+		return false;
+	}
+	output << "P6\n" << window.width << " " << window.height << "\n255\n";
+	const int rowBytes = window.width * BYTES_PER_PIXEL;
+	for (int y = window.height - 1; y >= 0; --y) {
+		output.write((const char *)(colorBuffer + y * rowBytes), rowBytes);
+	}
+	return (bool)output;
+}
+
+/**
+ * @fn	static vector<unsigned int> makeCRCTable()
+ * @brief	Builds the lookup table for the CRC-32 used by PNG chunks.
+ * @return	The CRC of each byte value.
+ */
+
+static vector<unsigned int> makeCRCTable() {
+	vector<unsigned int> table(256);
+	for (unsigned int n = 0; n < 256; n++) {
+		unsigned int c = n;
+		for (int k = 0; k < 8; k++) {
+			c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+		}
+		table[n] = c;
+	}
+	return table;
+}
+
+/**
+ * @fn	static unsigned int pngCRC(const unsigned char *data, size_t length)
+ * @brief	Computes the CRC-32 of some bytes, as stored at the end of a PNG chunk.
+ * @param	data  	The bytes.
+ * @param	length	Number of bytes.
+ * @return	The CRC.
+ */
+
+static unsigned int pngCRC(const unsigned char *data, size_t length) {
+	static const vector<unsigned int> table = makeCRCTable();
+	unsigned int crc = 0xFFFFFFFFu;
+	for (size_t i = 0; i < length; i++) {
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+/**
+ * @fn	static void appendBigEndian(vector<unsigned char> &bytes, unsigned int value)
+ * @brief	Appends a 32 bit value, most significant byte first.
+ * @param [in,out]	bytes	The bytes to append to.
+ * @param 		  	value	The value.
+ */
+
+static void appendBigEndian(vector<unsigned char> &bytes, unsigned int value) {
+	bytes.push_back((unsigned char)(value >> 24));
+	bytes.push_back((unsigned char)(value >> 16));
+	bytes.push_back((unsigned char)(value >> 8));
+	bytes.push_back((unsigned char)value);
+}
+
+/**
+ * @fn	static void writePNGChunk(std::ofstream &output, const char *type, const vector<unsigned char> &data)
+ * @brief	Writes one PNG chunk: length, type, data and CRC.
+ * @param [in,out]	output	The file.
+ * @param 		  	type  	The four letter chunk type.
+ * @param 		  	data  	The chunk's data.
+ */
+
+static void writePNGChunk(std::ofstream &output, const char *type, const vector<unsigned char> &data) {
+	vector<unsigned char> chunk;
+	appendBigEndian(chunk, (unsigned int)data.size());
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+	appendBigEndian(chunk, pngCRC(chunk.data() + 4, chunk.size() - 4));
+	output.write((const char *)chunk.data(), chunk.size());
+}
+
+/**
+ * @fn	bool FrameBuffer::writePNG(const string &fileName) const
+ * @brief	Writes the color buffer as an 8 bit RGB PNG file, top row first. The image
+ * 			data is stored without compression, so no zlib is needed; any PNG
+ * 			reader accepts the result.
+ * @param	fileName	Name of the file.
+ * @return	True iff the file was written.
+ */
+
+bool FrameBuffer::writePNG(const string &fileName) const {
+	std::ofstream output(fileName.c_str(), std::ios::binary);
+	if (!output) {
+		std::cerr << "Cannot write PNG file: " << fileName << endl;
+		return false;
+	}
+	static const unsigned char SIGNATURE[] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+	output.write((const char *)SIGNATURE, sizeof(SIGNATURE));
+
+	vector<unsigned char> header;
+	appendBigEndian(header, window.width);
+	appendBigEndian(header, window.height);
+	header.push_back(8);		// bits per channel
+	header.push_back(2);		// RGB
+	header.push_back(0);		// deflate
+	header.push_back(0);		// adaptive filtering
+	header.push_back(0);		// no interlace
+	writePNGChunk(output, "IHDR", header);
+
+	// Each row is preceded by its filter type, 0 (none).
+	const int rowBytes = window.width * BYTES_PER_PIXEL;
+	vector<unsigned char> raw;
+	raw.reserve((size_t)(rowBytes + 1) * window.height);
+	for (int y = window.height - 1; y >= 0; --y) {
+		raw.push_back(0);
+		raw.insert(raw.end(), colorBuffer + y * rowBytes, colorBuffer + (y + 1) * rowBytes);
+	}
+
+	// A zlib stream of stored deflate blocks, followed by the Adler-32 of the raw data.
+	const size_t MAX_BLOCK = 65535;
+	vector<unsigned char> zlib;
+	zlib.reserve(raw.size() + raw.size() / MAX_BLOCK * 5 + 16);
+	zlib.push_back(0x78);
+	zlib.push_back(0x01);
+	size_t pos = 0;
+	do {
+		size_t length = std::min(MAX_BLOCK, raw.size() - pos);
+		zlib.push_back(pos + length == raw.size() ? 1 : 0);
+		zlib.push_back((unsigned char)(length & 0xFF));
+		zlib.push_back((unsigned char)(length >> 8));
+		zlib.push_back((unsigned char)(~length & 0xFF));
+		zlib.push_back((unsigned char)((~length >> 8) & 0xFF));
+		zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + length);
+		pos += length;
+	} while (pos < raw.size());
+	unsigned int a = 1, b = 0;
+	for (unsigned char byte : raw) {
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	appendBigEndian(zlib, (b << 16) | a);
+	writePNGChunk(output, "IDAT", zlib);
+	writePNGChunk(output, "IEND", vector<unsigned char>());
+	return (bool)output;
 }
 
 /**
@@ -36,6 +36,9 @@ struct FrameBuffer {
 
 	void clearColorAndDepthBuffers();
 	void showColorBuffer() const;
+	bool writeImage(const string &fileName) const;
+	bool writePPM(const string &fileName) const;
+	bool writePNG(const string &fileName) const;
 	int getWindowWidth() const { return window.width; }
 	int getWindowHeight() const { return window.height; }
 
@@ -18,6 +18,7 @@
 #include "Image.h"
 #include "Camera.h"
 #include "Rasterization.h"
+#include "RenderStats.h"
 
 Image im1("usflag.ppm");
 
@@ -44,16 +45,14 @@ PerspectiveCamera pCamera(dvec3(0, 5, 10), dvec3(0, 5, 0), Y_AXIS, PI_2);
 IScene scene(&pCamera);
 
 void render() {
-	int frameStartTime = glutGet(GLUT_ELAPSED_TIME);
-
 	if (twoViewOn || !twoViewOn) {
 		pCamera.calculateViewingParameters(frameBuffer.getWindowWidth(), frameBuffer.getWindowHeight());
 		rayTrace.raytraceScene(frameBuffer, numReflections, scene);
 	}
-
-	int frameEndTime = glutGet(GLUT_ELAPSED_TIME); // Get end time
-	double totalTimeSec = ((double)frameEndTime - frameStartTime) / 1000.0;
-	cout << "Render time: " << totalTimeSec << " sec." << endl;
+	cout << RenderStats::lastFrame() << endl;
+	if (rayTrace.isRefining()) {
+		glutPostRedisplay();		// keep filling in the full resolution while idle
+	}
 }
 
 void resize(int width, int height) {
@@ -112,6 +111,7 @@ void timer(int id) {
 		}
 	}
 	sphere1->center = dvec3(0, 0, z);
+	scene.invalidateBVH();
 	if (isAnimated) {
 		glutTimerFunc(TIME_INTERVAL, timer, 0);
 	}
@@ -212,9 +212,13 @@ void keyboard(unsigned char key, int x, int y) {
 	case 'M':
 	case 'm':	break;
 	case '+':	antiAliasing = 3; 
+				rayTrace.maxSamples = antiAliasing * antiAliasing;
+				rayTrace.restartRefinement();
 				cout << "Anti aliasing: " << antiAliasing << endl;
 				break;
 	case '-':	antiAliasing = 1;
+				rayTrace.maxSamples = antiAliasing * antiAliasing;
+				rayTrace.restartRefinement();
 				cout << "Anti aliasing: " << antiAliasing << endl;
 				break;
 
@@ -223,6 +227,7 @@ void keyboard(unsigned char key, int x, int y) {
 	case '0':	
 	case '1':	
 	case '2':	numReflections = key - '0';
+				rayTrace.restartRefinement();
 				cout << "Num reflections: " << numReflections << endl;
 				break;
 	case 'd':	isAnimated = !isAnimated;
@@ -246,6 +251,8 @@ void keyboard(unsigned char key, int x, int y) {
 	glutMouseFunc(mouseUtility);
 	glutTimerFunc(TIME_INTERVAL, timer, 0);
 	buildScene();
+	rayTrace.useGBuffer = true;		// light edits reshade without primary rays
+	rayTrace.frameBudgetMs = 1000.0 / 30.0;	// trace at reduced resolution while the view changes
 
 	glutMainLoop();
 	return 0;
@@ -0,0 +1,199 @@
+/****************************************************
+ * 2016-2020 Eric Bachmann and Mike Zmuda
+ * All Rights Reserved.
+ * NOTICE:
+ * Dissemination of this information or reproduction
+ * of this material is prohibited unless prior written
+ * permission is granted..
+ ****************************************************/
+
+#include "GBuffer.h"
+
+/**
+ * @fn	void GBufferSample::store(const HitRecord &hit)
+ * @brief	Keeps the geometric part of a hit.
+ * @param	hit	The hit.
+ */
+
+void GBufferSample::store(const HitRecord &hit) {
+	surface = hit.t < FLT_MAX ? hit.surface : nullptr;
+	t = hit.t;
+	interceptPt = hit.interceptPt;
+	normal = hit.normal;
+	u = hit.u;
+	v = hit.v;
+}
+
+/**
+ * @fn	HitRecord GBufferSample::toHitRecord() const
+ * @brief	Rebuilds the hit, taking the material and texture from the surface.
+ * @return	The hit; t is FLT_MAX if nothing was hit.
+ */
+
+HitRecord GBufferSample::toHitRecord() const {
+	HitRecord hit;
+	if (surface != nullptr) {
+		hit.t = t;
+		hit.interceptPt = interceptPt;
+		hit.normal = normal;
+		hit.material = surface->material;
+		hit.texture = surface->texture;
+		hit.u = u;
+		hit.v = v;
+		hit.surface = surface;
+	}
+	return hit;
+}
+
+/**
+ * @fn	FrameView::FrameView()
+ * @brief	Constructs a view that matches nothing.
+ */
+
+FrameView::FrameView() : width(0), height(0), geometryVersion(0), isValid(false) {
+}
+
+/**
+ * @fn	void FrameView::getCornerRays(const RaytracingCamera &camera, int width, int height, Ray corners[NUM_CORNERS])
+ * @brief	Gets the camera's rays through the corners of the window. Every camera's
+ * 			rays vary linearly across the window, so these determine all the others.
+ * @param 		  	camera 	The camera.
+ * @param 		  	width  	Width of the window.
+ * @param 		  	height 	Height of the window.
+ * @param [in,out]	corners	The rays.
+ */
+
+void FrameView::getCornerRays(const RaytracingCamera &camera, int width, int height, Ray corners[NUM_CORNERS]) {
+	corners[0] = camera.getRay(0, 0);
+	corners[1] = camera.getRay(width - 1, 0);
+	corners[2] = camera.getRay(0, height - 1);
+	corners[3] = camera.getRay(width - 1, height - 1);
+}
+
+/**
+ * @fn	bool FrameView::matches(const RaytracingCamera &camera, const IScene &scene, int width, int height) const
+ * @brief	Determines if this is still the view last given to set.
+ * @param	camera	The camera.
+ * @param	scene 	The scene.
+ * @param	width 	Width of the window.
+ * @param	height	Height of the window.
+ * @return	True iff the window, the camera's rays and the scene's geometry are the
+ * 			same as when the view was set.
+ */
+
+bool FrameView::matches(const RaytracingCamera &camera, const IScene &scene, int width, int height) const {
+	if (!isValid || width != this->width || height != this->height ||
+		scene.getGeometryVersion() != geometryVersion) {
+		return false;
+	}
+	Ray corners[NUM_CORNERS];
+	getCornerRays(camera, width, height, corners);
+	for (int i = 0; i < NUM_CORNERS; i++) {
+		if (corners[i].origin != cornerRays[i].origin || corners[i].dir != cornerRays[i].dir) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @fn	void FrameView::set(const RaytracingCamera &camera, const IScene &scene, int width, int height)
+ * @brief	Remembers a view.
+ * @param	camera	The camera.
+ * @param	scene 	The scene.
+ * @param	width 	Width of the window.
+ * @param	height	Height of the window.
+ */
+
+void FrameView::set(const RaytracingCamera &camera, const IScene &scene, int width, int height) {
+	this->width = width;
+	this->height = height;
+	geometryVersion = scene.getGeometryVersion();
+	getCornerRays(camera, width, height, cornerRays);
+	isValid = true;
+}
+
+/**
+ * @fn	void FrameView::invalidate()
+ * @brief	Makes the view match nothing until it is set again.
+ */
+
+void FrameView::invalidate() {
+	isValid = false;
+}
+
+/**
+ * @fn	GBuffer::GBuffer()
+ * @brief	Constructs an empty buffer, which is never current.
+ */
+
+GBuffer::GBuffer() {
+}
+
+/**
+ * @fn	bool GBuffer::isCurrent(const RaytracingCamera &camera, const IScene &scene, int width, int height) const
+ * @brief	Determines if the buffer holds the primary hits of this view.
+ * @param	camera	The camera.
+ * @param	scene 	The scene.
+ * @param	width 	Width of the window.
+ * @param	height	Height of the window.
+ * @return	True iff the window, the camera's rays and the scene's geometry are the
+ * 			same as when the buffer was filled.
+ */
+
+bool GBuffer::isCurrent(const RaytracingCamera &camera, const IScene &scene, int width, int height) const {
+	return view.matches(camera, scene, width, height);
+}
+
+/**
+ * @fn	void GBuffer::setView(const RaytracingCamera &camera, const IScene &scene, int width, int height)
+ * @brief	Prepares the buffer to be filled with the primary hits of a view. The
+ * 			caller must store a hit for every pixel before asking isCurrent.
+ * @param	camera	The camera.
+ * @param	scene 	The scene.
+ * @param	width 	Width of the window.
+ * @param	height	Height of the window.
+ */
+
+void GBuffer::setView(const RaytracingCamera &camera, const IScene &scene, int width, int height) {
+	view.set(camera, scene, width, height);
+	opaqueHits.resize((size_t)width * height);
+	transparentHits.resize((size_t)width * height);
+}
+
+/**
+ * @fn	void GBuffer::invalidate()
+ * @brief	Forces the next frame to cast its primary rays.
+ */
+
+void GBuffer::invalidate() {
+	view.invalidate();
+}
+
+/**
+ * @fn	void GBuffer::store(int x, int y, const HitRecord &hit, const HitRecord &hit2)
+ * @brief	Keeps the primary hits of a pixel. Different pixels may be stored concurrently.
+ * @param	x   	The x coordinate of the pixel.
+ * @param	y   	The y coordinate of the pixel.
+ * @param	hit 	Closest opaque hit.
+ * @param	hit2	Closest transparent hit.
+ */
+
+void GBuffer::store(int x, int y, const HitRecord &hit, const HitRecord &hit2) {
+	opaqueHits[x + y * view.getWidth()].store(hit);
+	transparentHits[x + y * view.getWidth()].store(hit2);
+}
+
+/**
+ * @fn	void GBuffer::load(int x, int y, HitRecord &hit, HitRecord &hit2) const
+ * @brief	Gets the primary hits of a pixel.
+ * @param 		  	x   	The x coordinate of the pixel.
+ * @param 		  	y   	The y coordinate of the pixel.
+ * @param [in,out]	hit 	Closest opaque hit.
+ * @param [in,out]	hit2	Closest transparent hit.
+ */
+
+void GBuffer::load(int x, int y, HitRecord &hit, HitRecord &hit2) const {
+	hit = opaqueHits[x + y * view.getWidth()].toHitRecord();
+	hit2 = transparentHits[x + y * view.getWidth()].toHitRecord();
+}
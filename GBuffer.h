@@ -0,0 +1,72 @@
+/****************************************************
+ * 2016-2020 Eric Bachmann and Mike Zmuda
+ * All Rights Reserved.
+ * NOTICE:
+ * Dissemination of this information or reproduction
+ * of this material is prohibited unless prior written
+ * permission is granted..
+ ****************************************************/
+
+#pragma once
+#include "IShape.h"
+#include "Camera.h"
+#include "IScene.h"
+
+/**
+ * @struct	FrameView
+ * @brief	Everything a frame's primary rays and their hits depend on: the window,
+ * 			the camera's rays and the scene's geometry.
+ */
+
+struct FrameView {
+	FrameView();
+	bool matches(const RaytracingCamera &camera, const IScene &scene, int width, int height) const;
+	void set(const RaytracingCamera &camera, const IScene &scene, int width, int height);
+	void invalidate();
+	int getWidth() const { return width; }
+protected:
+	static const int NUM_CORNERS = 4;
+	static void getCornerRays(const RaytracingCamera &camera, int width, int height, Ray corners[NUM_CORNERS]);
+	int width, height;
+	unsigned geometryVersion;		//!< the scene's; no two scenes share one
+	Ray cornerRays[NUM_CORNERS];	//!< the camera's rays through the corners of the window
+	bool isValid;
+};
+
+/**
+ * @struct	GBufferSample
+ * @brief	The geometric part of a primary hit. The surface stands in for the
+ * 			material, so edits to a material or texture show up when reshading.
+ */
+
+struct GBufferSample {
+	const VisibleIShape *surface;	//!< the object hit; null if nothing was hit
+	double t;						//!< the t value along the primary ray
+	dvec3 interceptPt;				//!< the point hit
+	dvec3 normal;					//!< the normal at interceptPt
+	double u, v;					//!< texture coordinates, if the surface has a texture
+	GBufferSample() : surface(nullptr), t(FLT_MAX), u(0), v(0) {}
+	void store(const HitRecord &hit);
+	HitRecord toHitRecord() const;
+};
+
+/**
+ * @struct	GBuffer
+ * @brief	The primary hits of every pixel of the last frame, opaque and transparent.
+ * 			They stay valid while the window, the camera and the scene's geometry
+ * 			are unchanged, so a frame that only changes lights can be shaded from
+ * 			them without casting primary rays.
+ */
+
+struct GBuffer {
+	GBuffer();
+	bool isCurrent(const RaytracingCamera &camera, const IScene &scene, int width, int height) const;
+	void setView(const RaytracingCamera &camera, const IScene &scene, int width, int height);
+	void invalidate();
+	void store(int x, int y, const HitRecord &hit, const HitRecord &hit2);
+	void load(int x, int y, HitRecord &hit, HitRecord &hit2) const;
+protected:
+	FrameView view;
+	vector<GBufferSample> opaqueHits;
+	vector<GBufferSample> transparentHits;
+};
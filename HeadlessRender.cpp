@@ -0,0 +1,151 @@
+/****************************************************
+ * 2016-2020 Eric Bachmann and Mike Zmuda
+ * All Rights Reserved.
+ * NOTICE:
+ * Dissemination of this information or reproduction
+ * of this material is prohibited unless prior written
+ * permission is granted..
+ ****************************************************/
+
+/**
+ * Offline renderer for machines without a display. It renders an animated scene
+ * for a number of frames, writes each frame to an image file and prints how long
+ * each frame took. With -s 1 it also prints each frame's RenderStats and the
+ * statistics of each hierarchy built. Build it together with the core library
+ * and HEADLESS defined, leaving out the GLUT drivers and the tests, for example:
+ *
+ *   g++ -std=c++17 -O2 -fpermissive -pthread -DHEADLESS HeadlessRender.cpp
+ *       BinnedRasterizer.cpp BVH.cpp Camera.cpp ColorAndMaterials.cpp CompiledScene.cpp
+ *       Defs.cpp EShape.cpp FragmentOps.cpp FrameBuffer.cpp GBuffer.cpp Image.cpp
+ *       IScene.cpp IShape.cpp Light.cpp Rasterization.cpp RayGenerator.cpp RayTracer.cpp
+ *       RenderStats.cpp TileScheduler.cpp Utilities.cpp VertexOps.cpp VertextData.cpp
+ *       -o HeadlessRender
+ *
+ * Usage: HeadlessRender [-w width] [-h height] [-n frames] [-t threads]
+ *                       [-o prefix] [-f ppm|png] [-d depth] [-s 0|1] [-a samples]
+ *                       [-b budgetMs]
+ *
+ * -a sets the most samples per pixel of adaptive antialiasing (9 gives a 3x3 grid on
+ * edges); the default of 1 turns it off. -b sets a frame-time budget, so that the
+ * moving scene is traced at reduced resolution; the default of 0 traces every frame
+ * in full.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "Defs.h"
+#include "IShape.h"
+#include "FrameBuffer.h"
+#include "RayTracer.h"
+#include "IScene.h"
+#include "Light.h"
+#include "Camera.h"
+#include "RenderStats.h"
+
+struct Options {
+	int width = 640;
+	int height = 480;
+	int numFrames = 10;
+	int numThreads = 0;				// every hardware thread
+	int depth = 0;
+	int maxSamples = 1;				// no antialiasing
+	double frameBudgetMs = 0.0;		// full resolution
+	bool printStats = false;
+	string prefix = "frame";
+	string format = "png";
+};
+
+void usage(const char *program) {
+	std::cerr << "Usage: " << program << " [-w width] [-h height] [-n frames] [-t threads]"
+		<< " [-o prefix] [-f ppm|png] [-d depth] [-s 0|1] [-a samples] [-b budgetMs]" << endl;
+	std::exit(1);
+}
+
+Options parseOptions(int argc, char *argv[]) {
+	Options options;
+	for (int i = 1; i < argc; i++) {
+		if (i + 1 >= argc || argv[i][0] != '-' || std::strlen(argv[i]) != 2) {
+			usage(argv[0]);
+		}
+		const char *value = argv[++i];
+		switch (argv[i - 1][1]) {
+		case 'w':	options.width = std::atoi(value); break;
+		case 'h':	options.height = std::atoi(value); break;
+		case 'n':	options.numFrames = std::atoi(value); break;
+		case 't':	options.numThreads = std::atoi(value); break;
+		case 'd':	options.depth = std::atoi(value); break;
+		case 'a':	options.maxSamples = std::atoi(value); break;
+		case 'b':	options.frameBudgetMs = std::atof(value); break;
+		case 's':	options.printStats = std::atoi(value) != 0; break;
+		case 'o':	options.prefix = value; break;
+		case 'f':	options.format = value; break;
+		default:	usage(argv[0]);
+		}
+	}
+	if (options.width < 1 || options.height < 1 || options.numFrames < 0 || options.maxSamples < 1 ||
+		(options.format != "ppm" && options.format != "png")) {
+		usage(argv[0]);
+	}
+	return options;
+}
+
+ISphere *movingSphere = new ISphere(dvec3(0.0, 0.0, 0.0), 2.0);
+
+void buildScene(IScene &scene) {
+	scene.addOpaqueObject(new VisibleIShape(new IPlane(dvec3(0.0, -2.0, 0.0), Y_AXIS), tin));
+	scene.addOpaqueObject(new VisibleIShape(movingSphere, silver));
+	scene.addOpaqueObject(new VisibleIShape(new ISphere(dvec3(-2.0, 0.0, -8.0), 2.0), bronze));
+	scene.addOpaqueObject(new VisibleIShape(new IEllipsoid(dvec3(4.0, 0.0, 3.0), dvec3(2.0, 1.0, 2.0)), redPlastic));
+	scene.addOpaqueObject(new VisibleIShape(new ICylinderZ(dvec3(20.0, 5.0, -13.0), 5.0, 8.0), chrome));
+	scene.addOpaqueObject(new VisibleIShape(new IDisk(dvec3(15.0, 0.0, 0.0), Z_AXIS, 5.0), polishedGold));
+	scene.addTransparentObject(new VisibleIShape(new ISphere(dvec3(-5.0, 1.0, 2.0), 1.5), cyanPlastic), 0.5);
+	scene.addLight(new PositionalLight(dvec3(10, 10, 10), pureWhiteLight));
+}
+
+int main(int argc, char *argv[]) {
+	Options options = parseOptions(argc, argv);
+
+	PerspectiveCamera camera(dvec3(0, 5, 10), dvec3(0, 5, 0), Y_AXIS, PI_2);
+	IScene scene(&camera);
+	buildScene(scene);
+	FrameBuffer frameBuffer(options.width, options.height);
+	RayTracer rayTracer(lightGray);
+	rayTracer.setNumThreads(options.numThreads);
+	rayTracer.maxSamples = options.maxSamples;
+	rayTracer.frameBudgetMs = options.frameBudgetMs;
+	camera.calculateViewingParameters(options.width, options.height);
+	RenderStats::logFrames = options.printStats;
+	BVH::logBuilds = options.printStats;
+
+	cout << options.width << "x" << options.height << ", " << options.numFrames << " frames, "
+		<< rayTracer.getNumThreads() << " threads" << endl;
+
+	double totalMs = 0.0;
+	double fastestMs = DBL_MAX;
+	double slowestMs = 0.0;
+	for (int frame = 0; frame < options.numFrames; frame++) {
+		// The same bouncing motion as the interactive driver's timer.
+		double z = 5.0 - std::abs(std::fmod(0.5 * frame, 20.0) - 10.0);
+		movingSphere->center = dvec3(0, 0, z);
+		scene.invalidateBVH();
+
+		rayTracer.raytraceScene(frameBuffer, options.depth, scene);
+		double ms = RenderStats::lastFrame().frameTimeMs;
+		totalMs += ms;
+		fastestMs = std::min(fastestMs, ms);
+		slowestMs = std::max(slowestMs, ms);
+
+		char fileName[1024];
+		std::snprintf(fileName, sizeof(fileName), "%s%04d.%s", options.prefix.c_str(), frame, options.format.c_str());
+		if (!frameBuffer.writeImage(fileName)) {
+			return 1;
+		}
+		cout << "Frame " << frame << ": " << ms << " ms -> " << fileName << endl;
+	}
+	if (options.numFrames > 0) {
+		cout << "Average: " << totalMs / options.numFrames << " ms, fastest: " << fastestMs
+			<< " ms, slowest: " << slowestMs << " ms" << endl;
+	}
+	return 0;
+}
@@ -15,6 +15,8 @@
 #include "Image.h"
 #include "Utilities.h"
 
+struct VisibleIShape;
+
 /**
  * @struct	HitRecord
  * @brief	Stores information regarding a ray-object intersection. Used in raytracing.
@@ -27,6 +29,7 @@ struct HitRecord {
 	Material material;			//!< the Material value of the object.
 	Image *texture;				//!< the texture associated with this object, if any.
 	double u, v;				//!< (u,v) correpsonding to intersection point.
+	const VisibleIShape *surface;	//!< the object that was hit, if any.
 
 	/**
 	 * @fn	HitRecord()
@@ -37,6 +40,7 @@ struct HitRecord {
 		u = v = 0;
 		t = FLT_MAX;
 		texture = nullptr; 
+		surface = nullptr;
 	}
 
 	/**
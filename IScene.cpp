@@ -7,8 +7,23 @@
  * permission is granted..
  ****************************************************/
 
+#include <atomic>
 #include "IScene.h"
 
+/**
+ * @fn	static unsigned nextGeometryVersion()
+ * @brief	Gets a geometry version that no scene has had before. The versions come
+ * 			from one counter for the whole process, so a cache keyed on a version
+ * 			cannot mistake one scene for another, even for a scene created where a
+ * 			deleted one used to be.
+ * @return	The new version, never 0.
+ */
+
+static unsigned nextGeometryVersion() {
+	static std::atomic<unsigned> lastVersion(0);
+	return ++lastVersion;
+}
+
 /**
  * @fn	IScene::IScene(RaytracingCamera *theCamera)
  * @brief	Construct scene using a particular camera.
@@ -17,6 +32,9 @@
 
 IScene::IScene(RaytracingCamera *theCamera) {
 	camera = theCamera;
+	bvhIsDirty = true;
+	transparentBVHIsDirty = true;
+	geometryVersion = nextGeometryVersion();
 }
 
 /**
@@ -27,6 +45,8 @@ IScene::IScene(RaytracingCamera *theCamera) {
 
 void IScene::addOpaqueObject(const VisibleIShapePtr obj) {
 	opaqueObjs.push_back(obj);
+	bvhIsDirty = true;
+	geometryVersion = nextGeometryVersion();
 }
 
 /**
@@ -39,6 +59,8 @@ void IScene::addOpaqueObject(const VisibleIShapePtr obj) {
 void IScene::addTransparentObject(const VisibleIShapePtr obj, double alpha) {
 	obj->material.alpha = alpha;
 	transparentObjs.push_back(obj);
+	bvhIsDirty = true;
+	geometryVersion = nextGeometryVersion();
 }
 
 /**
@@ -50,3 +72,99 @@ void IScene::addTransparentObject(const VisibleIShapePtr obj, double alpha) {
 void IScene::addLight(const PositionalLightPtr light) {
 	lights.push_back(light);
 }
+
+/**
+ * @fn	void IScene::buildBVH() const
+ * @brief	Builds the bounding volume hierarchies over the opaque objects and over
+ * 			all the objects together, which are what the renderer queries. The one
+ * 			over the transparent objects alone is left for getTransparentBVH to
+ * 			build. Their statistics are printed if BVH::logBuilds is set.
+ */
+
+void IScene::buildBVH() const {
+	opaqueBVH.build(opaqueObjs);
+	sceneBVH.build(opaqueObjs, transparentObjs);
+	bvhIsDirty = false;
+	transparentBVHIsDirty = true;
+	if (BVH::logBuilds) {
+		cout << "Opaque " << opaqueBVH << endl;
+		cout << "Scene " << sceneBVH << endl;
+	}
+}
+
+/**
+ * @fn	void IScene::invalidateBVH()
+ * @brief	Forces the hierarchies to be rebuilt before the next use. Must be called
+ * 			after moving or resizing any object that is already in the scene.
+ */
+
+void IScene::invalidateBVH() {
+	bvhIsDirty = true;
+	geometryVersion = nextGeometryVersion();
+}
+
+/**
+ * @fn	const BVH &IScene::getOpaqueBVH() const
+ * @brief	Gets the hierarchy over the opaque objects, building it if needed.
+ * @return	The opaque objects' hierarchy.
+ */
+
+const BVH &IScene::getOpaqueBVH() const {
+	if (bvhIsDirty) {
+		buildBVH();
+	}
+	return opaqueBVH;
+}
+
+/**
+ * @fn	const BVH &IScene::getTransparentBVH() const
+ * @brief	Gets the hierarchy over the transparent objects, building it if needed.
+ * 			The renderer finds transparent hits through getSceneBVH, so this one
+ * 			is only built on request, without origin terms.
+ * @return	The transparent objects' hierarchy.
+ */
+
+const BVH &IScene::getTransparentBVH() const {
+	if (bvhIsDirty) {
+		buildBVH();
+	}
+	if (transparentBVHIsDirty) {
+		transparentBVH.build(transparentObjs);
+		transparentBVHIsDirty = false;
+		if (BVH::logBuilds) {
+			cout << "Transparent " << transparentBVH << endl;
+		}
+	}
+	return transparentBVH;
+}
+
+/**
+ * @fn	const BVH &IScene::getSceneBVH() const
+ * @brief	Gets the hierarchy over all the objects, opaque and transparent, building
+ * 			it if needed. Its findLayers finds both kinds of hit in one traversal.
+ * @return	The hierarchy over all the objects.
+ */
+
+const BVH &IScene::getSceneBVH() const {
+	if (bvhIsDirty) {
+		buildBVH();
+	}
+	return sceneBVH;
+}
+
+/**
+ * @fn	void IScene::setRayOrigin(const dvec3 &rayOrigin) const
+ * @brief	Precomputes, in the hierarchies the renderer queries, the per-object
+ * 			terms that depend only on a ray's origin, for the rays about to be
+ * 			traced from rayOrigin. Rays from anywhere else are traced as before.
+ * 			Builds the hierarchies if needed.
+ * @param	rayOrigin	The origin shared by the rays to come, e.g. the camera's.
+ */
+
+void IScene::setRayOrigin(const dvec3 &rayOrigin) const {
+	if (bvhIsDirty) {
+		buildBVH();
+	}
+	opaqueBVH.setOrigin(rayOrigin);
+	sceneBVH.setOrigin(rayOrigin);
+}
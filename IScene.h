@@ -15,6 +15,7 @@
 #include "Camera.h"
 #include "Light.h"
 #include "IShape.h"
+#include "BVH.h"
 
 /**
  * @struct	IScene
@@ -30,4 +31,19 @@ struct IScene {
 	void addOpaqueObject(const VisibleIShapePtr obj);
 	void addTransparentObject(const VisibleIShapePtr obj, double alpha);
 	void addLight(const PositionalLightPtr light);
+	void buildBVH() const;
+	void invalidateBVH();
+	const BVH &getOpaqueBVH() const;
+	const BVH &getTransparentBVH() const;
+	const BVH &getSceneBVH() const;
+	void setRayOrigin(const dvec3 &rayOrigin) const;
+	unsigned getGeometryVersion() const { return geometryVersion; }
+protected:
+	mutable BVH opaqueBVH;							//!< Hierarchy over opaqueObjs
+	mutable BVH transparentBVH;						//!< Hierarchy over transparentObjs; built only when asked for
+	mutable BVH sceneBVH;							//!< Hierarchy over opaqueObjs and transparentObjs together
+	mutable bool bvhIsDirty;						//!< True when the hierarchies must be rebuilt
+	mutable bool transparentBVHIsDirty;				//!< True when transparentBVH must be rebuilt
+	unsigned geometryVersion;						//!< Changes whenever an object is added, moved or resized;
+													//!< no two scenes ever have the same version
 };
@@ -31,6 +31,59 @@ void IShape::getTexCoords(const dvec3 &pt, double &u, double &v) const {
 	u = v = 0;
 }
 
+/**
+ * @fn	bool IShape::getBounds(AABB &box) const
+ * @brief	Computes a world space bounding box for the shape. The default is to
+ * 			report the shape as unbounded.
+ * @param [in,out]	box	The bounding box, if the shape is bounded.
+ * @return	True iff the shape is bounded.
+ */
+
+bool IShape::getBounds(AABB &) const {
+	return false;
+}
+
+/**
+ * @fn	double IShape::intersectT(const Ray &ray) const
+ * @brief	First phase of an intersection query: finds only the distance to the
+ * 			closest intersection within the ray's interval. The default falls back
+ * 			on findClosestIntersection.
+ * @param	ray	The ray.
+ * @return	The t value of the closest intersection, or FLT_MAX if there is none.
+ */
+
+double IShape::intersectT(const Ray &ray) const {
+	HitRecord hit;
+	findClosestIntersection(ray, hit);
+	return hit.t;
+}
+
+/**
+ * @fn	void IShape::computeAttributes(const Ray &ray, double t, HitRecord &hit) const
+ * @brief	Second phase of an intersection query: fills in t, the intercept point
+ * 			and the normal for an intersection already found by intersectT. The
+ * 			default falls back on findClosestIntersection.
+ * @param 		  	ray	The ray.
+ * @param 		  	t  	The value returned by intersectT for this ray.
+ * @param [in,out]	hit	The hit record to fill in.
+ */
+
+void IShape::computeAttributes(const Ray &ray, double, HitRecord &hit) const {
+	findClosestIntersection(ray, hit);
+}
+
+/**
+ * @fn	bool IShape::occluded(const Ray &ray) const
+ * @brief	Any-hit query used by shadow feelers. Reports whether the ray strikes the
+ * 			shape within its interval, without filling in a hit record.
+ * @param	ray	The ray.
+ * @return	True iff there is an intersection with ray.tMin < t < ray.tMax.
+ */
+
+bool IShape::occluded(const Ray &ray) const {
+	return intersectT(ray) != FLT_MAX;
+}
+
 /**
  * @fn	dvec3 IShape::movePointOffSurface(const dvec3 &pt, const dvec3 &n)
  * @brief	Compute point that is slightly off surface.
@@ -64,13 +117,30 @@ VisibleIShape::VisibleIShape(IShapePtr shapePtr, const Material &mat)
  */
 
 void VisibleIShape::findClosestIntersection(const Ray &ray, HitRecord &hit) const {
-	shape->findClosestIntersection(ray, hit);
-	if (hit.t < FLT_MAX) {
-		hit.material = material;
-		hit.texture = texture;
-		if (hit.texture != nullptr) {
-			shape->getTexCoords(hit.interceptPt, hit.u, hit.v);
-		}
+	double t = shape->intersectT(ray);
+	if (t < FLT_MAX) {
+		computeAttributes(ray, t, hit);
+	} else {
+		hit.t = FLT_MAX;
+	}
+}
+
+/**
+ * @fn	void VisibleIShape::computeAttributes(const Ray &ray, double t, HitRecord &hit) const
+ * @brief	Fills in the complete hit record, including material, texture and (u,v),
+ * 			for an intersection found by intersectT.
+ * @param 		  	ray	The ray.
+ * @param 		  	t  	The value returned by intersectT for this ray.
+ * @param [in,out]	hit	The hit record to fill in.
+ */
+
+void VisibleIShape::computeAttributes(const Ray &ray, double t, HitRecord &hit) const {
+	shape->computeAttributes(ray, t, hit);
+	hit.material = material;
+	hit.texture = texture;
+	hit.surface = this;
+	if (hit.texture != nullptr) {
+		shape->getTexCoords(hit.interceptPt, hit.u, hit.v);
 	}
 }
 
@@ -86,26 +156,49 @@ void VisibleIShape::setTexture(Image *tex) {
 
 /**
  * @fn	HitRecord VisibleIShape::findIntersection(const Ray &ray, const vector<VisibleIShapePtr> &surfaces)
- * @brief	Searches for the first intersection
+ * @brief	Searches for the first intersection. Only t is computed for each surface;
+ * 			the rest of the hit record is filled in once, for the closest surface.
+ * 			Each hit found narrows the interval the remaining surfaces are tested in.
  * @param	ray			The ray.
  * @param	surfaces	The surfaces in the scene.
  * @return	The closest intersection that is in front of the camera.
  */
 
 HitRecord VisibleIShape::findIntersection(const Ray &ray, const vector<VisibleIShapePtr> &surfaces) {
-	/* CSE 386 - todo  */
-	HitRecord theHit;
-	for (int i = 0; i < surfaces.size(); i++) {
-		HitRecord thisHit;
-		VisibleIShape& thisSurface = *surfaces[i];
-		thisSurface.findClosestIntersection(ray, thisHit);
-		if (thisHit.t < theHit.t) {
-			theHit = thisHit;
+	Ray query = ray;
+	const VisibleIShape *closest = nullptr;
+	for (const VisibleIShapePtr &surface : surfaces) {
+		double t = surface->intersectT(query);
+		if (t < query.tMax) {
+			query.tMax = t;
+			closest = surface;
 		}
 	}
+	HitRecord theHit;
+	if (closest != nullptr) {
+		closest->computeAttributes(ray, query.tMax, theHit);
+	}
 	return theHit;
 }
 
+/**
+ * @fn	bool VisibleIShape::occluded(const Ray &ray, const vector<VisibleIShapePtr> &surfaces)
+ * @brief	Determines whether any of the surfaces blocks the ray within its
+ * 			interval. Stops at the first blocker found.
+ * @param	ray			The ray.
+ * @param	surfaces	The surfaces in the scene.
+ * @return	True iff some surface is hit with ray.tMin < t < ray.tMax.
+ */
+
+bool VisibleIShape::occluded(const Ray &ray, const vector<VisibleIShapePtr> &surfaces) {
+	for (const VisibleIShapePtr &surface : surfaces) {
+		if (surface->occluded(ray)) {
+			return true;
+		}
+	}
+	return false;
+}
+
 /**
  * @fn	IDisk::IDisk()
  * @brief	Implicit representation of an implicit disk. Create a unit circle, centered
@@ -137,6 +230,23 @@ void IDisk::getTexCoords(const dvec3& pt, double& u, double& v) const {
 
 }
 
+/**
+ * @fn	bool IDisk::getBounds(AABB &box) const
+ * @brief	Computes the bounding box of the disk. Along each axis the disk extends
+ * 			radius * sqrt(1 - n_i^2) from its center.
+ * @param [in,out]	box	The bounding box.
+ * @return	True, since a disk is always bounded.
+ */
+
+bool IDisk::getBounds(AABB &box) const {
+	dvec3 N = glm::normalize(n);
+	dvec3 halfSize(radius * std::sqrt(std::max(0.0, 1.0 - N.x * N.x)),
+					radius * std::sqrt(std::max(0.0, 1.0 - N.y * N.y)),
+					radius * std::sqrt(std::max(0.0, 1.0 - N.z * N.z)));
+	box = AABB(center - halfSize, center + halfSize);
+	return true;
+}
+
 /**
  * @fn	void IDisk::findClosestIntersection(const Ray &ray, HitRecord &hit) const
  * @brief	Identifies the nearest intersection
@@ -145,14 +255,44 @@ void IDisk::getTexCoords(const dvec3& pt, double& u, double& v) const {
  */
 
 void IDisk::findClosestIntersection(const Ray &ray, HitRecord &hit) const {
-	/* CSE 386 - todo  */
-	IPlane plane(center, n);
-	plane.findClosestIntersection(ray, hit);
-	if (hit.t != FLT_MAX && glm::distance(center, hit.interceptPt) > radius) {
+	double t = intersectT(ray);
+	if (t != FLT_MAX) {
+		computeAttributes(ray, t, hit);
+	} else {
 		hit.t = FLT_MAX;
 	}
 }
 
+/**
+ * @fn	double IDisk::intersectT(const Ray &ray) const
+ * @brief	Finds the distance to the disk; see IShape::intersectT.
+ * @param	ray	The ray.
+ * @return	The t value of the intersection, or FLT_MAX if there is none.
+ */
+
+double IDisk::intersectT(const Ray &ray) const {
+	IPlane plane(center, n);
+	double t = plane.intersectT(ray);
+	if (t != FLT_MAX && glm::distance(center, ray.getPoint(t)) > radius) {
+		t = FLT_MAX;
+	}
+	return t;
+}
+
+/**
+ * @fn	void IDisk::computeAttributes(const Ray &ray, double t, HitRecord &hit) const
+ * @brief	Fills in the intercept point and normal; see IShape::computeAttributes.
+ * @param 		  	ray	The ray.
+ * @param 		  	t  	The value returned by intersectT for this ray.
+ * @param [in,out]	hit	The hit record to fill in.
+ */
+
+void IDisk::computeAttributes(const Ray &ray, double t, HitRecord &hit) const {
+	hit.t = t;
+	hit.interceptPt = ray.getPoint(t);
+	hit.normal = glm::normalize(n);
+}
+
 /**
  * @fn	ISphere::ISphere(const dvec3 & position, double radius)
  * @brief	Implicit representation of a 3D sphere.
@@ -366,6 +506,17 @@ IPlane::IPlane(const dvec3 &p0, const dvec3 &p1, const dvec3 &p2)
 				: IShape(), a(p1), n(glm::normalize(glm::cross(p2 - p1, p0 - p1))) {
 }
 
+/**
+ * @fn	bool IPlane::getBounds(AABB &box) const
+ * @brief	Planes are infinite, so they have no bounding box.
+ * @param [in,out]	box	Unused.
+ * @return	False.
+ */
+
+bool IPlane::getBounds(AABB &) const {
+	return false;
+}
+
 /**
  * @fn	bool IPlane::onFrontSide(const dvec3 &point) const
  * @brief	Determines if point is on the "front side of plane"
@@ -387,23 +538,43 @@ bool IPlane::onFrontSide(const dvec3 &point) const {
  */
 
 void IPlane::findClosestIntersection(const Ray &ray, HitRecord &hit) const {
-	/* CSE 386 - todo  */
-	double denom = glm::dot(ray.dir, n); // d dot n
-	if (approximatelyZero(denom)) {
+	double t = intersectT(ray);
+	if (t != FLT_MAX) {
+		computeAttributes(ray, t, hit);
+	} else {
 		hit.t = FLT_MAX;
 	}
-	else {
-		double num = glm::dot(a - ray.origin, n); // (a-e) dot n
-		double t = num / denom;
-		if (t > 0) { // can see it
-			hit.t = t;
-			hit.normal = n;
-			hit.interceptPt = ray.getPoint(t);
-		}
-		else {   // can't see it
-			hit.t = FLT_MAX;
-		}
+}
+
+/**
+ * @fn	double IPlane::intersectT(const Ray &ray) const
+ * @brief	Finds the distance to the plane; see IShape::intersectT.
+ * @param	ray	The ray.
+ * @return	The t value of the intersection, or FLT_MAX if the plane is parallel to
+ * 			the ray or crosses it outside its interval.
+ */
+
+double IPlane::intersectT(const Ray &ray) const {
+	double denom = glm::dot(ray.dir, n);
+	if (approximatelyZero(denom)) {
+		return FLT_MAX;
 	}
+	double t = glm::dot(a - ray.origin, n) / denom;
+	return ray.inRange(t) ? t : FLT_MAX;
+}
+
+/**
+ * @fn	void IPlane::computeAttributes(const Ray &ray, double t, HitRecord &hit) const
+ * @brief	Fills in the intercept point and normal; see IShape::computeAttributes.
+ * @param 		  	ray	The ray.
+ * @param 		  	t  	The value returned by intersectT for this ray.
+ * @param [in,out]	hit	The hit record to fill in.
+ */
+
+void IPlane::computeAttributes(const Ray &ray, double t, HitRecord &hit) const {
+	hit.t = t;
+	hit.normal = n;
+	hit.interceptPt = ray.getPoint(t);
 }
 
 /**
@@ -523,7 +694,7 @@ int IQuadricSurface::findIntersections(const Ray &ray, HitRecord hits[2]) const
 	int numIntersections = 0;
 
 	for (int i = 0; i < numRoots; i++) {
-		if (roots[i] > 0) {
+		if (ray.inRange(roots[i])) {
 			const double &t = roots[i];
 			hits[numIntersections].t = t;
 			hits[numIntersections].interceptPt = ray.origin + t * ray.dir;
@@ -536,6 +707,27 @@ int IQuadricSurface::findIntersections(const Ray &ray, HitRecord hits[2]) const
 	return numIntersections;
 }
 
+/**
+ * @fn	bool IQuadricSurface::getBounds(AABB &box) const
+ * @brief	Computes the bounding box of an axis-aligned, closed quadric (i.e., a
+ * 			sphere or ellipsoid). Along each axis such a quadric extends sqrt(-J/A)
+ * 			from its center. Any other quadric is reported as unbounded.
+ * @param [in,out]	box	The bounding box, if the quadric is bounded.
+ * @return	True iff the quadric is bounded.
+ */
+
+bool IQuadricSurface::getBounds(AABB &box) const {
+	const QuadricParameters &q = qParams;
+	bool hasCrossOrLinearTerms = q.D != 0 || q.E != 0 || q.F != 0 ||
+									q.G != 0 || q.H != 0 || q.I != 0;
+	if (hasCrossOrLinearTerms || q.A <= 0 || q.B <= 0 || q.C <= 0 || q.J >= 0) {
+		return false;
+	}
+	dvec3 halfSize(std::sqrt(-q.J / q.A), std::sqrt(-q.J / q.B), std::sqrt(-q.J / q.C));
+	box = AABB(center - halfSize, center + halfSize);
+	return true;
+}
+
 /**
  * @fn	void IQuadricSurface::findClosestIntersection(const Ray &ray, HitRecord &hit) const
  * @brief	Searches for the nearest intersection
@@ -544,25 +736,47 @@ int IQuadricSurface::findIntersections(const Ray &ray, HitRecord hits[2]) const
  */
 
 void IQuadricSurface::findClosestIntersection(const Ray &ray, HitRecord &hit) const {
-	static HitRecord hits[2];
-	hit.t = FLT_MAX;
-
-	int numIntercepts = findIntersections(ray, hits);
-	if (numIntercepts == 1 && hits[0].t > 0) {
-		hit.t = hits[0].t;
-		hit.interceptPt = hits[0].interceptPt;
-		hit.normal = normal(hit.interceptPt);
-	} else if (numIntercepts == 2) {
-		if (hits[0].t > 0) {
-			hit.t = hits[0].t;
-			hit.interceptPt = hits[0].interceptPt;
-			hit.normal = normal(hit.interceptPt);
-		} else if (hits[1].t > 0) {
-			hit.t = hits[1].t;
-			hit.interceptPt = hits[1].interceptPt;
-			hit.normal = normal(hit.interceptPt);
+	double t = intersectT(ray);
+	if (t != FLT_MAX) {
+		computeAttributes(ray, t, hit);
+	} else {
+		hit.t = FLT_MAX;
+	}
+}
+
+/**
+ * @fn	double IQuadricSurface::intersectT(const Ray &ray) const
+ * @brief	Finds the distance to the surface; see IShape::intersectT. Only the roots
+ * 			are needed, so no intercept points or normals are computed.
+ * @param	ray	The ray.
+ * @return	The smallest root within the ray's interval, or FLT_MAX if there is none.
+ */
+
+double IQuadricSurface::intersectT(const Ray &ray) const {
+	double Aq, Bq, Cq;
+	computeAqBqCq(ray, Aq, Bq, Cq);
+	double roots[2];
+	int numRoots = quadratic(Aq, Bq, Cq, roots);
+	for (int i = 0; i < numRoots; i++) {
+		if (ray.inRange(roots[i])) {
+			return roots[i];
 		}
 	}
+	return FLT_MAX;
+}
+
+/**
+ * @fn	void IQuadricSurface::computeAttributes(const Ray &ray, double t, HitRecord &hit) const
+ * @brief	Fills in the intercept point and normal; see IShape::computeAttributes.
+ * @param 		  	ray	The ray.
+ * @param 		  	t  	The value returned by intersectT for this ray.
+ * @param [in,out]	hit	The hit record to fill in.
+ */
+
+void IQuadricSurface::computeAttributes(const Ray &ray, double t, HitRecord &hit) const {
+	hit.t = t;
+	hit.interceptPt = ray.origin + t * ray.dir;
+	hit.normal = normal(hit.interceptPt);
 }
 
 /**
@@ -655,37 +869,89 @@ void ICylinder::computeAqBqCq(const Ray &ray, double &Aq, double &Bq, double &Cq
 }
 
 /**
- * @fn	ICylinderY::ICylinderY(const dvec3 &pos, double rad, double len) : ICylinder(pos, rad, len, QuadricParameters::cylinderYQParams(rad))
- * @brief	Constructor
- * @param	pos	The position.
- * @param	rad	The radians.
- * @param	len	The length.
+ * @fn	bool ICylinder::getBounds(AABB &box) const
+ * @brief	Computes the bounding box of the cylinder. The cylinder's axis is the
+ * 			one whose squared term is missing from the quadric.
+ * @param [in,out]	box	The bounding box.
+ * @return	True, since cylinders are clipped to a finite length.
  */
 
-ICylinderY::ICylinderY(const dvec3 &pos, double rad, double len)
-	: ICylinder(pos, rad, len, QuadricParameters::cylinderYQParams(rad)) {
+bool ICylinder::getBounds(AABB &box) const {
+	dvec3 halfSize(radius, radius, radius);
+	halfSize[axis()] = length / 2;
+	box = AABB(center - halfSize, center + halfSize);
+	return true;
 }
 
 /**
- * @fn	void ICylinderY::findClosestIntersection(const Ray &ray, HitRecord &hit) const
+ * @fn	int ICylinder::axis() const
+ * @brief	Gets the axis the cylinder is aligned with.
+ * @return	0, 1 or 2 for the x, y or z axis.
+ */
+
+int ICylinder::axis() const {
+	if (qParams.A == 0) {
+		return 0;
+	} else if (qParams.B == 0) {
+		return 1;
+	} else {
+		return 2;
+	}
+}
+
+/**
+ * @fn	double ICylinder::intersectT(const Ray &ray) const
+ * @brief	Finds the distance to the cylinder; see IShape::intersectT. A root only
+ * 			counts if it lies within the cylinder's length, which is not checked for
+ * 			roots outside the ray's interval.
+ * @param	ray	The ray.
+ * @return	The smallest root on the cylinder within the ray's interval, or FLT_MAX
+ * 			if there is none.
+ */
+
+double ICylinder::intersectT(const Ray &ray) const {
+	double Aq, Bq, Cq;
+	computeAqBqCq(ray, Aq, Bq, Cq);
+	double roots[2];
+	int numRoots = quadratic(Aq, Bq, Cq, roots);
+	const int a = axis();
+	for (int i = 0; i < numRoots; i++) {
+		if (ray.inRange(roots[i])) {
+			double coord = (ray.origin + roots[i] * ray.dir)[a];
+			if (coord < center[a] + length / 2 && coord > center[a] - length / 2) {
+				return roots[i];
+			}
+		}
+	}
+	return FLT_MAX;
+}
+
+/**
+ * @fn	void ICylinder::findClosestIntersection(const Ray &ray, HitRecord &hit) const
  * @brief	Searches for the nearest intersection
  * @param 		  	ray	The ray.
  * @param [in,out]	hit	The hit.
  */
 
-void ICylinderY::findClosestIntersection(const Ray &ray, HitRecord &hit) const {
-	const dvec3 &rayOrigin = ray.origin;
-	const dvec3 &rayDirection = ray.dir;
-	static HitRecord hits[2];
-	int numHits = ICylinder::findIntersections(ray, hits);
-	for (int i = 0; i < numHits; i++) {
-		if (hits[i].interceptPt.y < center.y + length / 2 &&
-			hits[i].interceptPt.y > center.y - length / 2) {
-				hit = hits[i];
-				return;
-		}
+void ICylinder::findClosestIntersection(const Ray &ray, HitRecord &hit) const {
+	double t = intersectT(ray);
+	if (t != FLT_MAX) {
+		computeAttributes(ray, t, hit);
+	} else {
+		hit.t = FLT_MAX;
 	}
-	hit.t = FLT_MAX;
+}
+
+/**
+ * @fn	ICylinderY::ICylinderY(const dvec3 &pos, double rad, double len) : ICylinder(pos, rad, len, QuadricParameters::cylinderYQParams(rad))
+ * @brief	Constructor
+ * @param	pos	The position.
+ * @param	rad	The radians.
+ * @param	len	The length.
+ */
+
+ICylinderY::ICylinderY(const dvec3 &pos, double rad, double len)
+	: ICylinder(pos, rad, len, QuadricParameters::cylinderYQParams(rad)) {
 }
 
 /**
@@ -713,28 +979,6 @@ IClosedCylinderY::IClosedCylinderY(const dvec3& pos, double rad, double len)
 	: ICylinder(pos, rad, len, QuadricParameters::cylinderYQParams(rad)) {
 }
 
-/**
- * @fn	void ICylinderY::findClosestIntersection(const Ray &ray, HitRecord &hit) const
- * @brief	Searches for the nearest intersection
- * @param 		  	ray	The ray.
- * @param [in,out]	hit	The hit.
- */
-
-void IClosedCylinderY::findClosestIntersection(const Ray& ray, HitRecord& hit) const {
-	const dvec3& rayOrigin = ray.origin;
-	const dvec3& rayDirection = ray.dir;
-	static HitRecord hits[2];
-	int numHits = ICylinder::findIntersections(ray, hits);
-	for (int i = 0; i < numHits; i++) {
-		if (hits[i].interceptPt.y < center.y + length / 2 &&
-			hits[i].interceptPt.y > center.y - length / 2) {
-			hit = hits[i];
-			return;
-		}
-	}
-	hit.t = FLT_MAX;
-}
-
 /**
 * @fn	void ICylinderY::getTexCoords(const dvec3 &pt, double &u, double &v) const
 * @brief	Gets tex coordinates
@@ -753,28 +997,6 @@ ICylinderZ::ICylinderZ(const dvec3& pos, double rad, double len)
 	: ICylinder(pos, rad, len, QuadricParameters::cylinderZQParams(rad)) {
 }
 
-/**
- * @fn	void ICylinderY::findClosestIntersection(const Ray &ray, HitRecord &hit) const
- * @brief	Searches for the nearest intersection
- * @param 		  	ray	The ray.
- * @param [in,out]	hit	The hit.
- */
-
-void ICylinderZ::findClosestIntersection(const Ray& ray, HitRecord& hit) const {
-	const dvec3& rayOrigin = ray.origin;
-	const dvec3& rayDirection = ray.dir;
-	static HitRecord hits[2];
-	int numHits = ICylinder::findIntersections(ray, hits);
-	for (int i = 0; i < numHits; i++) {
-		if (hits[i].interceptPt.z < center.z + length / 2 &&
-			hits[i].interceptPt.z > center.z - length / 2) {
-			hit = hits[i];
-			return;
-		}
-	}
-	hit.t = FLT_MAX;
-}
-
 /**
 * @fn	void ICylinderY::getTexCoords(const dvec3 &pt, double &u, double &v) const
 * @brief	Gets tex coordinates
@@ -819,13 +1041,55 @@ bool ITriangle::inside(const dvec3 &pt) const { // equation 2.35
  */
 
 void ITriangle::findClosestIntersection(const Ray &ray, HitRecord &hit) const {
-	plane.findClosestIntersection(ray, hit);
-	hit.normal = plane.n;
-	if (!inside(hit.interceptPt)) {
+	double t = intersectT(ray);
+	if (t != FLT_MAX) {
+		computeAttributes(ray, t, hit);
+	} else {
 		hit.t = FLT_MAX;
 	}
 }
 
+/**
+ * @fn	double ITriangle::intersectT(const Ray &ray) const
+ * @brief	Finds the distance to the triangle; see IShape::intersectT.
+ * @param	ray	The ray.
+ * @return	The t value of the intersection, or FLT_MAX if there is none.
+ */
+
+double ITriangle::intersectT(const Ray &ray) const {
+	double t = plane.intersectT(ray);
+	if (t != FLT_MAX && !inside(ray.getPoint(t))) {
+		t = FLT_MAX;
+	}
+	return t;
+}
+
+/**
+ * @fn	void ITriangle::computeAttributes(const Ray &ray, double t, HitRecord &hit) const
+ * @brief	Fills in the intercept point and normal; see IShape::computeAttributes.
+ * @param 		  	ray	The ray.
+ * @param 		  	t  	The value returned by intersectT for this ray.
+ * @param [in,out]	hit	The hit record to fill in.
+ */
+
+void ITriangle::computeAttributes(const Ray &ray, double t, HitRecord &hit) const {
+	plane.computeAttributes(ray, t, hit);
+}
+
+/**
+ * @fn	bool ITriangle::getBounds(AABB &box) const
+ * @brief	Computes the bounding box of the triangle.
+ * @param [in,out]	box	The bounding box.
+ * @return	True, since triangles are always bounded.
+ */
+
+bool ITriangle::getBounds(AABB &box) const {
+	box = AABB(a, a);
+	box.expand(b);
+	box.expand(c);
+	return true;
+}
+
 /**
  * @fn	IEllipsoid::IEllipsoid(const dvec3 &position, const dvec3 &sz) : IQuadricSurface(QuadricParameters::ellipoidParameters(sz), position)
  * @brief	Constructs an implicit representation of an ellipsoid.
@@ -18,29 +18,53 @@ typedef VisibleIShape *VisibleIShapePtr;
 
 /**
  * @struct	Ray
- * @brief	Represents a ray.
+ * @brief	Represents a ray. Only intersections with tMin < t < tMax count; shapes
+ * 			reject a root outside the interval before computing anything from it, so
+ * 			a query that narrows tMax to the closest hit found so far, or to the
+ * 			distance to a light, skips the work for everything farther away.
  */
 
 struct Ray {
 	dvec3 origin;		//!< starting point for this ray
 	dvec3 dir;			//!< direction for this ray, given it's origin
-	Ray(const dvec3 &rayOrigin, const dvec3 &rayDirection) :
-		origin(rayOrigin), dir(glm::normalize(rayDirection)) {
+	double tMin;		//!< intersections at or before this distance are ignored
+	double tMax;		//!< intersections at or beyond this distance are ignored
+	Ray() : origin(ORIGIN3D), dir(-Z_AXIS), tMin(0.0), tMax(FLT_MAX) {
+	}
+	Ray(const dvec3 &rayOrigin, const dvec3 &rayDirection, double tMin = 0.0, double tMax = FLT_MAX) :
+		origin(rayOrigin), dir(glm::normalize(rayDirection)), tMin(tMin), tMax(tMax) {
+	}
+	static Ray withUnitDir(const dvec3 &rayOrigin, const dvec3 &unitDir, double tMin = 0.0, double tMax = FLT_MAX) {
+		Ray ray;
+		ray.origin = rayOrigin;
+		ray.dir = unitDir;		// already unit length, so not normalized again
+		ray.tMin = tMin;
+		ray.tMax = tMax;
+		return ray;
 	}
 	dvec3 getPoint(double t) const {
 		return origin + t * dir;
 	}
+	bool inRange(double t) const {
+		return t > tMin && t < tMax;
+	}
 };
 
 /**
  * @struct	IShape
- * @brief	Base class for all implicit shapes.
+ * @brief	Base class for all implicit shapes. Shapes are immutable once built: queries
+ * 			keep their scratch state on the caller's stack, so any number of threads
+ * 			may intersect rays with the same shape at once.
  */
 
 struct IShape {
 	IShape();
 	virtual void findClosestIntersection(const Ray &ray, HitRecord &hit) const = 0;
 	virtual void getTexCoords(const dvec3 &pt, double &u, double &v) const;
+	virtual bool getBounds(AABB &box) const;
+	virtual double intersectT(const Ray &ray) const;
+	virtual void computeAttributes(const Ray &ray, double t, HitRecord &hit) const;
+	virtual bool occluded(const Ray &ray) const;
 	static dvec3 movePointOffSurface(const dvec3 &pt, const dvec3 &n);
 };
 
@@ -55,8 +79,12 @@ struct VisibleIShape {
 	Image *texture;		//!< Texture associated with this shape, if any.
 	VisibleIShape(IShapePtr shapePtr, const Material &mat);
 	void findClosestIntersection(const Ray &ray, HitRecord &hit) const;
+	double intersectT(const Ray &ray) const { return shape->intersectT(ray); }
+	void computeAttributes(const Ray &ray, double t, HitRecord &hit) const;
+	bool occluded(const Ray &ray) const { return shape->occluded(ray); }
 	void setTexture(Image *tex);
 	static HitRecord findIntersection(const Ray &ray, const vector<VisibleIShapePtr> &surfaces);
+	static bool occluded(const Ray &ray, const vector<VisibleIShapePtr> &surfaces);
 };
 
 /**
@@ -71,6 +99,9 @@ struct IPlane : public IShape {
 	IPlane(const vector<dvec3> &vertices);
 	IPlane(const dvec3 &p1, const dvec3 &p2, const dvec3 &p3);
 	virtual void findClosestIntersection(const Ray &ray, HitRecord &hit) const;
+	virtual bool getBounds(AABB &box) const;
+	virtual double intersectT(const Ray &ray) const;
+	virtual void computeAttributes(const Ray &ray, double t, HitRecord &hit) const;
 	bool onFrontSide(const dvec3 &point) const;
 	void findIntersection(const dvec3 &p1, const dvec3 &p2, double &t) const;
 };
@@ -86,6 +117,9 @@ struct IDisk : public IShape {
 	IDisk(const dvec3 &position, const dvec3 &n, double rad);
 	virtual void findClosestIntersection(const Ray &ray, HitRecord &hit) const;
 	virtual void getTexCoords(const dvec3& pt, double& u, double& v) const;
+	virtual bool getBounds(AABB &box) const;
+	virtual double intersectT(const Ray &ray) const;
+	virtual void computeAttributes(const Ray &ray, double t, HitRecord &hit) const;
 	dvec3 center;	//!< center point of disk
 	dvec3 n;		//!< normal vector of disk
 	double radius;
@@ -122,6 +156,9 @@ struct ITriangle : public IShape {
 	IPlane plane;	//!< the plane this triangle lies on.
 	ITriangle(const dvec3 &A, const dvec3 &B, const dvec3 &C);
 	virtual void findClosestIntersection(const Ray &ray, HitRecord &hit) const;
+	virtual bool getBounds(AABB &box) const;
+	virtual double intersectT(const Ray &ray) const;
+	virtual void computeAttributes(const Ray &ray, double t, HitRecord &hit) const;
 	bool inside(const dvec3 &pt) const;
 };
 
@@ -140,7 +177,11 @@ struct IQuadricSurface : public IShape {
 	IQuadricSurface(const dvec3 & position);
 	virtual void findClosestIntersection(const Ray &ray, HitRecord &hit) const;
 	int findIntersections(const Ray &ray, HitRecord hits[2]) const;
+	virtual bool getBounds(AABB &box) const;
+	virtual double intersectT(const Ray &ray) const;
+	virtual void computeAttributes(const Ray &ray, double t, HitRecord &hit) const;
 	dvec3 normal(const dvec3 &pt) const;
+	const QuadricParameters &getParams() const { return qParams; }
 	virtual void computeAqBqCq(const Ray &ray, double &Aq, double &Bq, double &Cq) const;
 protected:
 	QuadricParameters qParams;		//!< The parameters that make up the quadric
@@ -168,8 +209,11 @@ struct ISphere : IQuadricSurface {
 struct ICylinder : public IQuadricSurface {
 	double radius, length;
 	ICylinder(const dvec3 &position, double R, double len, const QuadricParameters &qParams);
-	virtual void findClosestIntersection(const Ray &ray, HitRecord &hit) const = 0;
+	virtual void findClosestIntersection(const Ray &ray, HitRecord &hit) const;
 	virtual void computeAqBqCq(const Ray &ray, double &Aq, double &Bq, double &Cq) const;
+	virtual bool getBounds(AABB &box) const;
+	virtual double intersectT(const Ray &ray) const;
+	int axis() const;
 };
 
 /**
@@ -179,7 +223,6 @@ struct ICylinder : public IQuadricSurface {
 
 struct ICylinderY : public ICylinder {
 	ICylinderY(const dvec3 &position, double R, double len);
-	virtual void findClosestIntersection(const Ray &ray, HitRecord &hit) const;
 	void getTexCoords(const dvec3 &pt, double &u, double &v) const;
 };
 
@@ -190,7 +233,6 @@ struct ICylinderY : public ICylinder {
 
 struct IClosedCylinderY : public ICylinder {
 	IClosedCylinderY(const dvec3& position, double R, double len);
-	virtual void findClosestIntersection(const Ray& ray, HitRecord& hit) const;
 	void getTexCoords(const dvec3& pt, double& u, double& v) const;
 };
 
@@ -201,7 +243,6 @@ struct IClosedCylinderY : public ICylinder {
 
 struct ICylinderZ : public ICylinder {
 	ICylinderZ(const dvec3& position, double R, double len);
-	virtual void findClosestIntersection(const Ray& ray, HitRecord& hit) const;
 	void getTexCoords(const dvec3& pt, double& u, double& v) const;
 };
 
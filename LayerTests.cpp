@@ -0,0 +1,170 @@
+#include <iostream>
+#include <random>
+#include "Defs.h"
+#include "IShape.h"
+#include "IScene.h"
+#include "Camera.h"
+#include "RayPacket.h"
+#include "RayTracer.h"
+#include "RenderStats.h"
+
+/**
+ * Checks BVH::findLayers on the hierarchy over a whole scene against the separate
+ * opaque and transparent hierarchies. For every ray, the opaque hit must be the
+ * opaque hierarchy's closest hit whenever it is known, the first layer must be the
+ * transparent hierarchy's closest hit, and the layers must be transparent, sorted
+ * and in front of the opaque hit. Packets must give each ray the same layers as
+ * tracing it on its own.
+ *
+ * Then traces the scene with small ray budgets. A budget of 0 or 1 allows only the
+ * primary rays, and a budget of 2 allows one more ray per pixel.
+ */
+
+const int NUM_RANDOM_RAYS = 100000;
+
+bool sameHit(const HitRecord &a, const HitRecord &b) {
+	return a.t == b.t && a.interceptPt == b.interceptPt && a.normal == b.normal &&
+			a.material.diffuse == b.material.diffuse;
+}
+
+bool sameLayers(const LayeredHit &a, const LayeredHit &b) {
+	if (a.numLayers != b.numLayers || a.tComplete != b.tComplete || !sameHit(a.opaque, b.opaque)) {
+		return false;
+	}
+	for (int i = 0; i < a.numLayers; i++) {
+		if (!sameHit(a.layers[i], b.layers[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void buildScene(IScene &scene) {
+	scene.addOpaqueObject(new VisibleIShape(new IPlane(dvec3(0, -10, 0), Y_AXIS), tin));
+	scene.addTransparentObject(new VisibleIShape(new IPlane(dvec3(0, 0, -30), Z_AXIS), copper), 0.5);
+	for (int i = 0; i < 5; i++) {
+		double x = -8.0 + 4.0 * i;
+		scene.addOpaqueObject(new VisibleIShape(new ISphere(dvec3(x, 4, 0), 1.5), gold));
+		scene.addTransparentObject(new VisibleIShape(new ISphere(dvec3(x + 1, 4, 3), 1.5), cyanPlastic), 0.5);
+		scene.addTransparentObject(new VisibleIShape(new ICylinderY(dvec3(x, 0, -4), 1.0, 2.0), silver), 0.5);
+		scene.addOpaqueObject(new VisibleIShape(new IClosedCylinderY(dvec3(x, 0, 4), 1.0, 2.0), brass));
+		scene.addTransparentObject(new VisibleIShape(new ICylinderZ(dvec3(x, -4, 0), 0.75, 1.5), bronze), 0.5);
+		scene.addTransparentObject(new VisibleIShape(new IEllipsoid(dvec3(x, 8, -2), dvec3(1.5, 0.75, 1.0)), pewter), 0.5);
+		scene.addOpaqueObject(new VisibleIShape(new IDisk(dvec3(x, -7, 2), glm::normalize(dvec3(1, 1, 1)), 1.25), chrome));
+		scene.addTransparentObject(new VisibleIShape(new ITriangle(dvec3(x, 1, 8), dvec3(x + 2, 1, 8), dvec3(x + 1, 3, 7)), redPlastic), 0.5);
+	}
+}
+
+int checkRay(const IScene &scene, const Ray &ray, const LayeredHit &layers) {
+	const BVH &sceneBVH = scene.getSceneBVH();
+	HitRecord opaque = scene.getOpaqueBVH().findIntersection(ray);
+	HitRecord transparent = scene.getTransparentBVH().findIntersection(ray);
+	int errors = 0;
+	if (layers.opaqueIsKnown() && !sameHit(layers.opaque, opaque)) {
+		errors++;
+	}
+	if (transparent.t < opaque.t) {
+		errors += layers.numLayers > 0 && sameHit(layers.layers[0], transparent) ? 0 : 1;
+	} else {
+		errors += layers.numLayers == 0 ? 0 : 1;
+	}
+	for (int i = 0; i < layers.numLayers; i++) {
+		const HitRecord &layer = layers.layers[i];
+		if (!sceneBVH.isTransparent(layer.surface) || layer.t >= opaque.t ||
+			layer.t > layers.tComplete || (i > 0 && layer.t < layers.layers[i - 1].t)) {
+			errors++;
+		}
+	}
+	if (layers.numLayers == 0 && !layers.opaqueIsKnown()) {
+		errors++;
+	}
+	return errors;
+}
+
+int checkPacket(const IScene &scene, const Ray rays[], int numRays) {
+	LayeredHit layers[RayPacket::SIZE];
+	scene.getSceneBVH().findLayers(rays, numRays, layers);
+	int errors = 0;
+	for (int i = 0; i < numRays; i++) {
+		LayeredHit single;
+		scene.getSceneBVH().findLayers(rays[i], single);
+		if (!sameLayers(layers[i], single)) {
+			errors++;
+		}
+		errors += checkRay(scene, rays[i], single);
+	}
+	return errors;
+}
+
+long long countSecondaryRays(const IScene &scene, int rayBudget, int width, int height) {
+	FrameBuffer frameBuffer(width, height);
+	RayTracer rayTracer(lightGray);
+	rayTracer.rayBudget = rayBudget;
+	rayTracer.raytraceScene(frameBuffer, 3, scene);
+	return RenderStats::lastFrame().get(SECONDARY_RAYS);
+}
+
+int main(int argc, char *argv[]) {
+	const int W = 400, H = 300;
+	PerspectiveCamera camera(dvec3(0, 0, 25), ORIGIN3D, Y_AXIS, PI_2);
+	camera.calculateViewingParameters(W, H);
+	IScene scene(&camera);
+	buildScene(scene);
+
+	int numRays = 0;
+	int numErrors = 0;
+	Ray rays[RayPacket::SIZE];
+	for (int by = 0; by < H; by += RayPacket::BLOCK_HEIGHT) {
+		for (int bx = 0; bx < W; bx += RayPacket::BLOCK_WIDTH) {
+			int n = 0;
+			for (int y = by; y < by + RayPacket::BLOCK_HEIGHT; y++) {
+				for (int x = bx; x < bx + RayPacket::BLOCK_WIDTH; x++) {
+					rays[n++] = camera.getRay(x, y);
+				}
+			}
+			numErrors += checkPacket(scene, rays, n);
+			numRays += n;
+		}
+	}
+
+	// A ray straight through a transparent sphere crosses it twice.
+	LayeredHit through;
+	scene.getSceneBVH().findLayers(Ray(dvec3(-7, 4, 20), dvec3(0, 0, -1)), through);
+	if (through.numLayers != 2 || through.layers[0].surface != through.layers[1].surface) {
+		numErrors++;
+	}
+
+	std::mt19937 rng(386);
+	std::uniform_real_distribution<double> U(-1.0, 1.0);
+	for (int r = 0; r < NUM_RANDOM_RAYS; r++) {
+		dvec3 origin(20.0 * U(rng), 20.0 * U(rng), 20.0 + 5.0 * U(rng));
+		dvec3 target(10.0 * U(rng), 10.0 * U(rng), 10.0 * U(rng));
+		Ray ray(origin, target - origin);
+		LayeredHit layers;
+		scene.getSceneBVH().findLayers(ray, layers);
+		numErrors += checkRay(scene, ray, layers);
+		numRays++;
+	}
+
+	const int BW = 100, BH = 75;
+	camera.calculateViewingParameters(BW, BH);
+	long long noBudget = countSecondaryRays(scene, 0, BW, BH);
+	long long oneRay = countSecondaryRays(scene, 1, BW, BH);
+	long long twoRays = countSecondaryRays(scene, 2, BW, BH);
+	if (noBudget != 0 || oneRay != 0 || twoRays == 0 || twoRays > BW * BH) {
+		numErrors++;
+	}
+
+	cout << "Rays traced: " << numRays << endl;
+	cout << "Secondary rays with budgets 0, 1 and 2: " << noBudget << ", " << oneRay << ", " << twoRays << endl;
+	cout << "Errors: " << numErrors << endl;
+	cout << (numErrors == 0 ? "PASSED" : "FAILED") << endl;
+	return numErrors == 0 ? 0 : 1;
+}
+
+/*
+Rays traced: 220000
+Secondary rays with budgets 0, 1 and 2: 0, 0, 7500
+Errors: 0
+PASSED
+*/
@@ -127,10 +127,108 @@ color totalColor(const Material &mat, const LightColor &lightColor,
 	dvec3 speccy = specularColor(mat.specular, lightColor.specular, mat.shininess, r, v);
 	dvec3 diffy = diffuseColor(mat.diffuse, lightColor.diffuse, l, n);
 	dvec3 ambby = ambientColor(mat.ambient, lightColor.ambient);
+	if (attenuationOn) {
+		double AT = ATparams.factor(glm::distance(lightPos, intersectionPt));
+		speccy = AT * speccy;
+		diffy = AT * diffy;
+	}
 	color answer = speccy + diffy + ambby;
 	return answer;
 }
 
+/**
+ * @fn	bool isInSpotlightCone(const dvec3 &spotPos, const dvec3 &spotDir, double spotFOV, const dvec3 &intercept)
+ * @brief	Determines if a point is inside a spot light's cone.
+ * @param	spotPos  	The spot light's position.
+ * @param	spotDir  	The direction the spot light points in.
+ * @param	spotFOV  	The spot light's field of view; the full angle of the cone.
+ * @param	intercept	The point.
+ * @return	True iff the point is inside the cone.
+ */
+
+bool isInSpotlightCone(const dvec3 &spotPos, const dvec3 &spotDir, double spotFOV, const dvec3 &intercept) {
+	dvec3 spotToIntercept = glm::normalize(intercept - spotPos);
+	return glm::dot(glm::normalize(spotDir), spotToIntercept) > std::cos(spotFOV / 2.0);
+}
+
+/**
+ * @fn	bool LightInfluence::contains(const dvec3 &pt) const
+ * @brief	Determines if a point is inside the influence volume.
+ * @param	pt	The point.
+ * @return	True iff the light may add more than its ambient color at pt.
+ */
+
+bool LightInfluence::contains(const dvec3 &pt) const {
+	dvec3 toPt = pt - center;
+	double distSquared = glm::dot(toPt, toPt);
+	if (distSquared > radiusSquared) {
+		return false;
+	}
+	// the same test as isInSpotlightCone, so the two always agree
+	return cosHalfAngle < -1.0 || glm::dot(axis, glm::normalize(toPt)) > cosHalfAngle;
+}
+
+/**
+ * @fn	double PositionalLight::influenceRadius(double minContribution) const
+ * @brief	Distance beyond which attenuation leaves the light's diffuse and specular
+ * 			color below minContribution in every channel.
+ * @param	minContribution	The largest contribution that counts as negligible.
+ * @return	The distance; DBL_MAX if the light is not attenuated.
+ */
+
+double PositionalLight::influenceRadius(double minContribution) const {
+	if (!attenuationIsTurnedOn) {
+		return DBL_MAX;
+	}
+	color peak = lightColor.diffuse + lightColor.specular;
+	double K = std::max(std::max(peak.r, peak.g), peak.b) / minContribution;
+	const double &C = atParams.constant;
+	const double &L = atParams.linear;
+	const double &Q = atParams.quadratic;
+	// solve C + L*d + Q*d^2 = K, the distance where factor(d) * peak = minContribution
+	if (C >= K) {
+		return 0.0;
+	} else if (Q > 0.0) {
+		return (-L + std::sqrt(L * L + 4.0 * Q * (K - C))) / (2.0 * Q);
+	} else if (L > 0.0) {
+		return (K - C) / L;
+	}
+	return DBL_MAX;
+}
+
+/**
+ * @fn	LightInfluence PositionalLight::influence(double minContribution) const
+ * @brief	Computes the region this light noticeably reaches: the sphere given by
+ * 			influenceRadius.
+ * @param	minContribution	The largest contribution that counts as negligible.
+ * @return	The influence volume.
+ */
+
+LightInfluence PositionalLight::influence(double minContribution) const {
+	LightInfluence result;
+	result.center = pos;
+	double R = influenceRadius(minContribution);
+	result.radiusSquared = R == DBL_MAX ? DBL_MAX : R * R;
+	result.axis = dvec3(0, 0, 0);
+	result.cosHalfAngle = -2.0;
+	return result;
+}
+
+/**
+ * @fn	LightInfluence SpotLight::influence(double minContribution) const
+ * @brief	Computes the region this light noticeably reaches: the part of the sphere
+ * 			given by influenceRadius that lies inside the cone.
+ * @param	minContribution	The largest contribution that counts as negligible.
+ * @return	The influence volume.
+ */
+
+LightInfluence SpotLight::influence(double minContribution) const {
+	LightInfluence result = PositionalLight::influence(minContribution);
+	result.axis = glm::normalize(spotDir);
+	result.cosHalfAngle = std::cos(fov / 2.0);
+	return result;
+}
+
 /**
  * @fn	color PositionalLight::illuminate(const dvec3 &interceptWorldCoords, const dvec3 &normal, const Material &material, const Frame &eyeFrame, bool inShadow) const
  * @brief	Computes the color this light produces in raytracing applications.
@@ -167,29 +265,6 @@ color PositionalLight::illuminate(const dvec3 &interceptWorldCoords,
 	return material.ambient;
 }
 
-color PositionalLight::illuminate(const dvec3& interceptWorldCoords, const dvec3& normal, const Material& material, const Frame& eyeFrame, bool inShadow)
-{
-	if (!inShadow && isOn) {
-		dvec3 color;
-		dvec3 tempy;
-		tempy.x = eyeFrame.origin.x - interceptWorldCoords.x;
-		tempy.y = eyeFrame.origin.y - interceptWorldCoords.y;
-		tempy.z = eyeFrame.origin.z - interceptWorldCoords.z;
-		color = totalColor(material, lightColor, normalize(tempy), normalize(normal), pos, interceptWorldCoords, attenuationIsTurnedOn, atParams); // I tried finding v as e-point (eyeframe-vec)
-		return color;
-	}
-	else if (isOn && inShadow) {
-		dvec3 ambby = ambientColor(material.ambient, lightColor.ambient);
-		return ambby;
-	}
-	else if (!isOn) {
-		return black;
-	}
-	return material.ambient;
-}
-
-
-
 /**
  * @fn	color SpotLight::illuminate(const dvec3 &interceptWorldCoords, const dvec3 &normal, const Material &material, const Frame &eyeFrame, bool inShadow) const
  * @brief	Computes the color this light produces in raytracing applications.
@@ -205,6 +280,8 @@ color SpotLight::illuminate(const dvec3 &interceptWorldCoords,
 							const dvec3 &normal,
 							const Material &material,
 							const Frame &eyeFrame, bool inShadow) const {
+	// outside the cone the point gets only ambient light, as if it were in shadow
+	inShadow = inShadow || !isInSpotlightCone(pos, spotDir, fov, interceptWorldCoords);
 	if (!inShadow && isOn) {
 		dvec3 color;
 		dvec3 tempy;
@@ -31,6 +31,20 @@ struct LightATParams {
 	friend ostream &operator << (ostream &os, const LightATParams &at);
 };
 
+/**
+ * @struct	LightInfluence
+ * @brief	The region where a light adds more than its ambient color: a sphere
+ * 			around the light, cut down to a cone for spot lights.
+ */
+
+struct LightInfluence {
+	dvec3 center;			//!< Position of the light.
+	double radiusSquared;	//!< Square of the sphere's radius; DBL_MAX if unbounded.
+	dvec3 axis;				//!< Unit direction of the cone's axis.
+	double cosHalfAngle;	//!< Cosine of half the cone's angle; below -1 if there is no cone.
+	bool contains(const dvec3 &pt) const;
+};
+
 /**
  * @struct	LightColor
  * @brief	Represents the colors of each light component.
@@ -94,8 +108,9 @@ struct PositionalLight : public LightSource {
 							const dvec3 &normal,
 							const Material &material,
 							const Frame &eyeFrame, bool inShadow) const;
+	double influenceRadius(double minContribution) const;
+	virtual LightInfluence influence(double minContribution) const;
 	friend ostream &operator << (ostream &os, const PositionalLight &pl);
-	color illuminate(const dvec3& interceptWorldCoords, const dvec3& normal, const Material& material, const Frame& eyeFrame, bool inShadow);
 };
 
 /**
@@ -115,12 +130,14 @@ struct SpotLight : public PositionalLight {
 							const dvec3 &normal,
 							const Material &material,
 							const Frame &eyeFrame, bool inShadow) const;
+	virtual LightInfluence influence(double minContribution) const;
 	friend ostream &operator << (ostream &os, const SpotLight &pl);
 };
 
 const LightColor pureWhiteLight(vector<double>{1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0});
 
 color ambientColor(const color &matAmbient, const color &lightAmbient);
+bool isInSpotlightCone(const dvec3 &spotPos, const dvec3 &spotDir, double spotFOV, const dvec3 &intercept);
 color diffuseColor(const color &matDiffuse, const color &lightDiffuse,
 					const dvec3 &l, const dvec3 &n);
 color specularColor(const color &mat, const color &light,
@@ -0,0 +1,159 @@
+#include <iostream>
+#include <random>
+#include "Defs.h"
+#include "IShape.h"
+#include "IScene.h"
+#include "Camera.h"
+#include "RayPacket.h"
+#include "RayGenerator.h"
+
+/**
+ * Traces rays in packets and checks that every ray gets exactly the hit that
+ * BVH::findIntersection gives it on its own. Coherent packets come from blocks of
+ * camera pixels; incoherent ones are random rays, which split up early and
+ * exercise the fallback to single rays. Partial packets are covered too. Rays
+ * with a random [tMin, tMax] interval are also checked against a linear search
+ * of the scene, for both the closest hit and the any-hit query. The camera rays
+ * come from a RayGenerator, whose rays must equal the camera's own getRay.
+ */
+
+const int NUM_RANDOM_PACKETS = 20000;
+const int NUM_INTERVAL_PACKETS = 5000;
+
+bool sameHit(const HitRecord &a, const HitRecord &b) {
+	return a.t == b.t && a.interceptPt == b.interceptPt && a.normal == b.normal &&
+			a.material.diffuse == b.material.diffuse;
+}
+
+void buildScene(IScene &scene) {
+	scene.addOpaqueObject(new VisibleIShape(new IPlane(dvec3(0, -10, 0), Y_AXIS), tin));
+	scene.addOpaqueObject(new VisibleIShape(new IPlane(dvec3(0, 0, -30), Z_AXIS), copper));
+	for (int i = 0; i < 5; i++) {
+		double x = -8.0 + 4.0 * i;
+		scene.addOpaqueObject(new VisibleIShape(new ISphere(dvec3(x, 4, 0), 1.5), gold));
+		scene.addOpaqueObject(new VisibleIShape(new ICylinderY(dvec3(x, 0, -4), 1.0, 2.0), silver));
+		scene.addOpaqueObject(new VisibleIShape(new IClosedCylinderY(dvec3(x, 0, 4), 1.0, 2.0), brass));
+		scene.addOpaqueObject(new VisibleIShape(new ICylinderZ(dvec3(x, -4, 0), 0.75, 1.5), bronze));
+		scene.addOpaqueObject(new VisibleIShape(new IEllipsoid(dvec3(x, 8, -2), dvec3(1.5, 0.75, 1.0)), pewter));
+		scene.addOpaqueObject(new VisibleIShape(new IDisk(dvec3(x, -7, 2), glm::normalize(dvec3(1, 1, 1)), 1.25), chrome));
+		scene.addOpaqueObject(new VisibleIShape(new ITriangle(dvec3(x, 1, 8), dvec3(x + 2, 1, 8), dvec3(x + 1, 3, 7)), redPlastic));
+	}
+}
+
+int checkPacket(const BVH &bvh, const Ray rays[], int numRays) {
+	HitRecord hits[RayPacket::SIZE];
+	bvh.findIntersections(rays, numRays, hits);
+	int mismatches = 0;
+	for (int i = 0; i < numRays; i++) {
+		if (!sameHit(hits[i], bvh.findIntersection(rays[i]))) {
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+int checkIntervals(const IScene &scene, const Ray rays[], int numRays) {
+	const BVH &bvh = scene.getOpaqueBVH();
+	int mismatches = checkPacket(bvh, rays, numRays);
+	for (int i = 0; i < numRays; i++) {
+		HitRecord hit = VisibleIShape::findIntersection(rays[i], scene.opaqueObjs);
+		bool blocked = hit.t != FLT_MAX;
+		if (!sameHit(hit, bvh.findIntersection(rays[i])) || bvh.occluded(rays[i]) != blocked ||
+			VisibleIShape::occluded(rays[i], scene.opaqueObjs) != blocked ||
+			(blocked && !rays[i].inRange(hit.t))) {
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+int checkRayGenerator(const RaytracingCamera &camera, int W, int H) {
+	RayGenerator generator;
+	generator.setView(camera, W, H);
+	int mismatches = 0;
+	Ray rays[RayPacket::SIZE];
+	for (int by = 0; by < H; by += RayPacket::BLOCK_HEIGHT) {
+		for (int bx = 0; bx < W; bx += RayPacket::BLOCK_WIDTH) {
+			Tile block = { bx, by, std::min(bx + RayPacket::BLOCK_WIDTH, W), std::min(by + RayPacket::BLOCK_HEIGHT, H) };
+			int n = generator.getRays(block, rays);
+			for (int y = block.y0; y < block.y1; y++) {
+				for (int x = block.x0; x < block.x1; x++) {
+					Ray expected = camera.getRay(x, y);
+					Ray ray = generator.getRay(x, y);
+					const Ray &inBlock = rays[(y - block.y0) * (block.x1 - block.x0) + (x - block.x0)];
+					if (ray.origin != expected.origin || ray.dir != expected.dir ||
+						inBlock.origin != expected.origin || inBlock.dir != expected.dir) {
+						mismatches++;
+					}
+				}
+			}
+			mismatches += n == block.area() ? 0 : 1;
+		}
+	}
+	return mismatches;
+}
+
+int main(int argc, char *argv[]) {
+	const int W = 400, H = 300;
+	PerspectiveCamera camera(dvec3(0, 0, 25), ORIGIN3D, Y_AXIS, PI_2);
+	camera.calculateViewingParameters(W, H);
+	IScene scene(&camera);
+	buildScene(scene);
+	const BVH &bvh = scene.getOpaqueBVH();
+
+	int numPackets = 0;
+	int numMismatches = checkRayGenerator(camera, W, H);
+	OrthographicCamera orthoCamera(dvec3(0, 0, 25), ORIGIN3D, Y_AXIS, 10.0);
+	orthoCamera.calculateViewingParameters(W - 3, H - 5);
+	numMismatches += checkRayGenerator(orthoCamera, W - 3, H - 5);
+
+	RayGenerator generator;
+	generator.setView(camera, W, H);
+	Ray rays[RayPacket::SIZE];
+	for (int by = 0; by < H; by += RayPacket::BLOCK_HEIGHT) {
+		for (int bx = 0; bx < W; bx += RayPacket::BLOCK_WIDTH) {
+			Tile block = { bx, by, bx + RayPacket::BLOCK_WIDTH, by + RayPacket::BLOCK_HEIGHT };
+			int numRays = generator.getRays(block, rays);
+			numMismatches += checkPacket(bvh, rays, numRays);
+			numPackets++;
+		}
+	}
+
+	std::mt19937 rng(386);
+	std::uniform_real_distribution<double> U(-1.0, 1.0);
+	for (int p = 0; p < NUM_RANDOM_PACKETS; p++) {
+		int numRays = 1 + p % RayPacket::SIZE;
+		for (int i = 0; i < numRays; i++) {
+			dvec3 origin(20.0 * U(rng), 20.0 * U(rng), 20.0 + 5.0 * U(rng));
+			dvec3 target(10.0 * U(rng), 10.0 * U(rng), 10.0 * U(rng));
+			rays[i] = Ray(origin, target - origin);
+		}
+		numMismatches += checkPacket(bvh, rays, numRays);
+		numPackets++;
+	}
+
+	for (int p = 0; p < NUM_INTERVAL_PACKETS; p++) {
+		int numRays = 1 + p % RayPacket::SIZE;
+		for (int i = 0; i < numRays; i++) {
+			dvec3 origin(20.0 * U(rng), 20.0 * U(rng), 20.0 + 5.0 * U(rng));
+			dvec3 target(10.0 * U(rng), 10.0 * U(rng), 10.0 * U(rng));
+			double tMin = 15.0 + 15.0 * U(rng);
+			rays[i] = Ray(origin, target - origin, tMin, tMin + 20.0 + 20.0 * U(rng));
+		}
+		numMismatches += checkIntervals(scene, rays, numRays);
+		numPackets++;
+	}
+
+	cout << "SIMD: " << SIMD_NAME << ", " << RayPacket::SIZE << " rays per packet" << endl;
+	cout << "Packets traced: " << numPackets << endl;
+	cout << "Mismatches: " << numMismatches << endl;
+	cout << (numMismatches == 0 ? "PASSED" : "FAILED") << endl;
+	return numMismatches == 0 ? 0 : 1;
+}
+
+/*
+SIMD: AVX2, 8 rays per packet
+Packets traced: 40000
+Mismatches: 0
+PASSED
+*/
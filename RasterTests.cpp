@@ -0,0 +1,291 @@
+#include <iostream>
+#include <cstdlib>
+#include <new>
+#include <atomic>
+#include "Defs.h"
+#include "EShape.h"
+#include "VertexOps.h"
+#include "RenderStats.h"
+
+/**
+ * Renders the same frames through the pipeline twice, drawing the triangles at once
+ * and through a BinnedRasterizer, and checks that the color and depth buffers agree
+ * at every pixel. The scene has closed shapes, shapes crossing the window's edges,
+ * and two coplanar quads of different colors, whose pixels depend on draw order.
+ *
+ * Also counts heap allocations while frames are rendered again: once the pipeline's
+ * buffers have grown to fit, neither drawing a frame at once nor taking one through
+ * the vertex stage into the bins should allocate anything.
+ *
+ * Then renders closed spheres with and without their back faces. Culling must
+ * remove about half of the triangles and change no pixel, also for a sphere cut
+ * by the near plane.
+ *
+ * Finally renders into a viewport inset in the window, with a floor reaching far
+ * beyond the guard band. Nothing may be drawn outside the viewport, and drawing
+ * at once and binning must agree. The floor is cut by the near plane and again by
+ * the guard band, yet each of its triangles counts as clipped once. The shapes
+ * drawn after the floor cross the viewport's sides, within the guard band, so none
+ * of them may be clipped.
+ *
+ * Last, draws a quad under the floor with the depth test turned off, and turns it
+ * back on before flushing. The binned quad must still cover the floor.
+ */
+
+const int W = 397, H = 251;
+const int NUM_FRAMES = 6;
+
+static std::atomic<long long> numAllocations(0);
+
+void *operator new(size_t size) {
+	numAllocations++;
+	void *p = std::malloc(size > 0 ? size : 1);
+	if (p == nullptr) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void *p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+	std::free(p);
+}
+
+EShapeData board = EShape::createECheckerBoard(copper, polishedCopper, 10, 10, 10);
+EShapeData sphere = EShape::createESphere(gold, 1.0, 24);
+EShapeData cone = EShape::createECone(brass, 1.0, 1.5, 16);
+EShapeData cylinder = EShape::createECylinder(silver, 0.5, 2.0, 16);
+EShapeData cube = EShape::createECube(redPlastic);
+EShapeData quad = EShape::createEPlanes(cyanPlastic, { dvec4(-1, -1, 0, 1), dvec4(1, -1, 0, 1),
+														dvec4(1, 1, 0, 1), dvec4(-1, 1, 0, 1) });
+EShapeData otherQuad = EShape::createEPlanes(greenPlastic, { dvec4(-1, -1, 0, 1), dvec4(1, -1, 0, 1),
+															dvec4(1, 1, 0, 1), dvec4(-1, 1, 0, 1) });
+
+void renderFrame(FrameBuffer &frameBuffer, const vector<LightSourcePtr> &lights, double angle) {
+	frameBuffer.clearColorAndDepthBuffers();
+	VertexOps::viewingTrans = glm::lookAt(dvec3(3 * std::sin(angle), 2, 6 * std::cos(angle)), ORIGIN3D, Y_AXIS);
+	VertexOps::projectionTrans = glm::perspective(PI_3, (double)W / H, 0.5, 80.0);
+	VertexOps::setViewport(0, W - 1, 0, H - 1);
+	VertexOps::render(frameBuffer, board, lights, T(0, -1, 0));
+	VertexOps::render(frameBuffer, sphere, lights, T(-1.5, 0, 0));
+	VertexOps::render(frameBuffer, cone, lights, T(1.5, 0, 0) * Rx(angle));
+	VertexOps::render(frameBuffer, cylinder, lights, T(0, 0, -2) * Rz(angle));
+	VertexOps::render(frameBuffer, cube, lights, T(0, 1, 1) * Ry(angle) * S(0.75));
+	VertexOps::render(frameBuffer, quad, lights, T(0, 0.5, 2) * S(3, 0.75, 1));
+	VertexOps::render(frameBuffer, otherQuad, lights, T(0.5, 0.5, 2) * S(3, 0.75, 1));
+}
+
+/**
+ * A closed sphere of radius 1 whose triangles wind counterclockwise seen from
+ * outside. EShape::createESphere is left as an exercise, so the test makes its own.
+ */
+
+EShapeData makeClosedSphere(const Material &mat, int slices, int stacks) {
+	auto corner = [&](int i, int j) {
+		double theta = 2.0 * PI * i / slices;
+		double phi = PI * j / stacks;
+		return dvec4(std::sin(phi) * std::sin(theta), std::cos(phi), std::sin(phi) * std::cos(theta), 1.0);
+	};
+	vector<dvec4> pts;
+	for (int j = 0; j < stacks; j++) {
+		for (int i = 0; i < slices; i++) {
+			dvec4 a = corner(i, j), b = corner(i, j + 1), c = corner(i + 1, j + 1), d = corner(i + 1, j);
+			if (j > 0) {
+				pts.insert(pts.end(), { a, b, d });
+			}
+			if (j < stacks - 1) {
+				pts.insert(pts.end(), { b, c, d });
+			}
+		}
+	}
+	return EShape::createETriangles(mat, pts);
+}
+
+RenderStats renderSpheres(FrameBuffer &frameBuffer, const vector<LightSourcePtr> &lights,
+							const EShapeData &closedSphere) {
+	RenderStats::beginFrame();
+	frameBuffer.clearColorAndDepthBuffers();
+	VertexOps::viewingTrans = glm::lookAt(dvec3(0, 0, 6), ORIGIN3D, Y_AXIS);
+	VertexOps::projectionTrans = glm::perspective(PI_3, (double)W / H, 0.5, 80.0);
+	VertexOps::setViewport(0, W - 1, 0, H - 1);
+	VertexOps::render(frameBuffer, closedSphere, lights, T(-2.5, 0, 0));
+	VertexOps::render(frameBuffer, closedSphere, lights, T(2.5, 0.5, -1) * S(1.5));
+	VertexOps::render(frameBuffer, closedSphere, lights, T(0, -1.5, 5.2));
+	return RenderStats::endFrame();
+}
+
+const BoundingBoxi inset(40, W - 61, 30, H - 41);
+
+RenderStats renderInset(FrameBuffer &frameBuffer, const vector<LightSourcePtr> &lights,
+							RenderStats &floorStats) {
+	frameBuffer.clearColorAndDepthBuffers();
+	VertexOps::viewingTrans = glm::lookAt(dvec3(1, 1, 4), ORIGIN3D, Y_AXIS);
+	VertexOps::projectionTrans = glm::perspective(PI_3, (double)inset.width() / inset.height(), 0.5, 80.0);
+	VertexOps::setViewport(inset);
+	RenderStats::beginFrame();
+	VertexOps::render(frameBuffer, quad, lights, T(0, -1, 0) * Rx(-PI_2) * S(5000));
+	floorStats = RenderStats::endFrame();
+	RenderStats::beginFrame();
+	VertexOps::render(frameBuffer, sphere, lights, T(-1.5, 0, 0));
+	VertexOps::render(frameBuffer, cylinder, lights, T(0, 0, -2) * Rz(1.0));
+	VertexOps::render(frameBuffer, otherQuad, lights, T(0.5, 0.5, 2) * S(3, 0.75, 1));
+	return RenderStats::endFrame();
+}
+
+void renderOverlay(FrameBuffer &frameBuffer, const vector<LightSourcePtr> &lights) {
+	renderFrame(frameBuffer, lights, 1.0);
+	FragmentOps::performDepthTest = false;
+	FragmentOps::readonlyDepthBuffer = true;
+	VertexOps::render(frameBuffer, quad, lights, T(0, -2, 0) * Rx(-PI_2) * S(2));
+	FragmentOps::performDepthTest = true;
+	FragmentOps::readonlyDepthBuffer = false;
+}
+
+int countDifferences(const FrameBuffer &a, const FrameBuffer &b) {
+	int differences = 0;
+	for (int y = 0; y < H; y++) {
+		for (int x = 0; x < W; x++) {
+			if (a.getColor(x, y) != b.getColor(x, y) || a.getDepth(x, y) != b.getDepth(x, y)) {
+				differences++;
+			}
+		}
+	}
+	return differences;
+}
+
+int main(int argc, char *argv[]) {
+	vector<LightSourcePtr> lights = { new PositionalLight(dvec3(2, 1, 3), pureWhiteLight) };
+	FrameBuffer serial(W, H);
+	FrameBuffer binned(W, H);
+	serial.setClearColor(lightGray);
+	binned.setClearColor(lightGray);
+
+	const int threadCounts[] = { 1, 3, 8 };
+	const int tileSizes[] = { BinnedRasterizer::DEFAULT_TILE_SIZE, 37, 7 };
+	int numFrames = 0;
+	int numErrors = 0;
+	long long numPixelsDrawn = 0;
+	for (int f = 0; f < NUM_FRAMES; f++) {
+		double angle = f * PI / NUM_FRAMES;
+		VertexOps::binnedRasterizer = nullptr;
+		renderFrame(serial, lights, angle);
+		for (int y = 0; y < H; y++) {
+			for (int x = 0; x < W; x++) {
+				numPixelsDrawn += serial.getDepth(x, y) < 1.0 ? 1 : 0;
+			}
+		}
+		for (int numThreads : threadCounts) {
+			for (int tileSize : tileSizes) {
+				BinnedRasterizer rasterizer(numThreads, tileSize);
+				VertexOps::binnedRasterizer = &rasterizer;
+				renderFrame(binned, lights, angle);
+				rasterizer.flush();
+				numErrors += countDifferences(serial, binned);
+				numFrames++;
+			}
+		}
+	}
+	VertexOps::binnedRasterizer = nullptr;
+
+	// The frames above grew the buffers of drawing at once; these must not grow them again.
+	long long before = numAllocations;
+	for (int f = 0; f < NUM_FRAMES; f++) {
+		renderFrame(serial, lights, f * PI / NUM_FRAMES);
+	}
+	long long serialAllocations = numAllocations - before;
+
+	BinnedRasterizer rasterizer(1);
+	VertexOps::binnedRasterizer = &rasterizer;
+	long long binningAllocations = 0;
+	for (int round = 0; round < 2; round++) {
+		for (int f = 0; f < NUM_FRAMES; f++) {
+			before = numAllocations;
+			renderFrame(binned, lights, f * PI / NUM_FRAMES);
+			if (round > 0) {
+				binningAllocations += numAllocations - before;
+			}
+			rasterizer.flush();
+		}
+	}
+	VertexOps::binnedRasterizer = nullptr;
+
+	EShapeData closedSphere = makeClosedSphere(gold, 24, 12);
+	VertexOps::renderBackFaces = true;
+	RenderStats withBackFaces = renderSpheres(serial, lights, closedSphere);
+	VertexOps::renderBackFaces = false;
+	RenderStats culled = renderSpheres(binned, lights, closedSphere);
+	VertexOps::renderBackFaces = true;
+	double culledFraction = (double)culled.get(TRIANGLES_CULLED) / culled.get(TRIANGLES_SUBMITTED);
+	int cullingErrors = countDifferences(serial, binned);
+	// Seen from near by, less than half of a sphere faces the eye, so somewhat more is culled.
+	bool culledHalf = withBackFaces.get(TRIANGLES_CULLED) == 0 && culledFraction > 0.45 && culledFraction < 0.7;
+
+	RenderStats floorStats;
+	RenderStats insetStats = renderInset(serial, lights, floorStats);
+	long long floorClipped = floorStats.get(TRIANGLES_CLIPPED);
+	long long floorTriangles = floorStats.get(TRIANGLES_SUBMITTED);
+	int drawnOutside = 0;
+	for (int y = 0; y < H; y++) {
+		for (int x = 0; x < W; x++) {
+			bool inside = x >= inset.lx && x <= inset.rx && y >= inset.ly && y <= inset.ry;
+			drawnOutside += !inside && serial.getDepth(x, y) < 1.0 ? 1 : 0;
+		}
+	}
+	VertexOps::binnedRasterizer = &rasterizer;
+	renderInset(binned, lights, floorStats);
+	rasterizer.flush();
+	VertexOps::binnedRasterizer = nullptr;
+	int insetErrors = countDifferences(serial, binned);
+	long long insetClipped = insetStats.get(TRIANGLES_CLIPPED);
+	VertexOps::setViewport(0, W - 1, 0, H - 1);
+
+	renderOverlay(serial, lights);
+	VertexOps::binnedRasterizer = &rasterizer;
+	renderOverlay(binned, lights);
+	rasterizer.flush();
+	VertexOps::binnedRasterizer = nullptr;
+	int overlayErrors = countDifferences(serial, binned);
+
+	bool passed = numErrors == 0 && serialAllocations == 0 && binningAllocations == 0 &&
+					culledHalf && cullingErrors == 0 &&
+					drawnOutside == 0 && insetErrors == 0 && insetClipped == 0 &&
+					floorClipped == floorTriangles &&
+					overlayErrors == 0;
+	cout << "Binned frames: " << numFrames << endl;
+	cout << "Pixels drawn per frame: " << numPixelsDrawn / NUM_FRAMES << endl;
+	cout << "Pixels differing: " << numErrors << endl;
+	cout << "Allocations drawing frames: " << serialAllocations << endl;
+	cout << "Allocations binning frames: " << binningAllocations << endl;
+	cout << "Triangles culled: " << culled.get(TRIANGLES_CULLED) << " of " << culled.get(TRIANGLES_SUBMITTED) << endl;
+	cout << "Fragments without back faces: " << culled.get(FRAGMENTS_GENERATED) << " of "
+		<< withBackFaces.get(FRAGMENTS_GENERATED) << endl;
+	cout << "Pixels differing when culling: " << cullingErrors << endl;
+	cout << "Floor triangles clipped: " << floorClipped << " of " << floorTriangles << endl;
+	cout << "Triangles clipped after the floor: " << insetClipped << " of "
+		<< insetStats.get(TRIANGLES_SUBMITTED) << endl;
+	cout << "Pixels drawn outside the inset viewport: " << drawnOutside << endl;
+	cout << "Pixels differing in the inset viewport: " << insetErrors << endl;
+	cout << "Pixels differing with the depth test off: " << overlayErrors << endl;
+	cout << (passed ? "PASSED" : "FAILED") << endl;
+	return passed ? 0 : 1;
+}
+
+/*
+Binned frames: 54
+Pixels drawn per frame: 62550
+Pixels differing: 0
+Allocations drawing frames: 0
+Allocations binning frames: 0
+Triangles culled: 1032 of 1584
+Fragments without back faces: 14101 of 28202
+Pixels differing when culling: 0
+Floor triangles clipped: 2 of 2
+Triangles clipped after the floor: 0 of 4
+Pixels drawn outside the inset viewport: 0
+Pixels differing in the inset viewport: 0
+Pixels differing with the depth test off: 0
+PASSED
+*/
@@ -7,8 +7,10 @@
  * permission is granted..
  ****************************************************/
 
+#include <algorithm>
 #include <cmath>
 #include "Rasterization.h"
+#include "SIMD.h"
 
 /**
 * @fn	template <class T> T barycentricWeighting(double w1, double w2, double w3, const T &i1, const T &i2, const T &i3)
@@ -534,62 +536,123 @@ void drawManyWireFrameTriangles(FrameBuffer &frameBuffer,
 }
 
 /**
- * @fn	static inline double f01(const VertexData &v0, const VertexData &v1, const VertexData &v2, double x, double y)
- * @brief	Computes f01. Implicit equation for the line between v0 and v1.
- * @see		*** page in textbook.
- * @param	v0	v0.
- * @param	v1	v1.
- * @param	v2	v2.
- * @param	x 	x coordinate.
- * @param	y 	y coordinate.
- * @return	f01.
+ * @struct	EdgeFunction
+ * @brief	The implicit equation of one edge of a triangle, E(x, y) = a*x + b*y + c,
+ * 			in fixed point with SUBPIXEL_BITS fractional bits. The vertices are
+ * 			snapped to that grid, so every value is an integer: stepping E from
+ * 			pixel to pixel by additions is exact, and so are the doubles holding
+ * 			it, as long as window coordinates stay below MAX_WINDOW_COORD.
  */
 
-static inline double f01(const VertexData &v0, const VertexData &v1, const VertexData &v2, double x, double y) {
-	return (v0.pos.y - v1.pos.y) * x + (v1.pos.x - v0.pos.x) * y +
-		(v0.pos.x * v1.pos.y) - (v1.pos.x * v0.pos.y);
-
-}
+static const int SUBPIXEL_BITS = 8;
+static const double SUBPIXEL_SCALE = 1 << SUBPIXEL_BITS;
+static const double MAX_WINDOW_COORD = 1 << 15;
+static const int RASTER_BLOCK_SIZE = 8;
+
+struct EdgeFunction {
+	double a, b, c;		//!< coefficients, with x and y in fixed point
+	double bias;		//!< 1 if points on the edge belong to the neighbouring triangle, else 0
+	double dx, dy;		//!< change of E from one pixel to the next in x and in y
+	EdgeFunction(const dvec2 &p, const dvec2 &q) {
+		a = p.y - q.y;
+		b = q.x - p.x;
+		c = p.x * q.y - q.x * p.y;
+		bias = 0.0;
+		dx = a * SUBPIXEL_SCALE;
+		dy = b * SUBPIXEL_SCALE;
+	}
+	double at(double X, double Y) const {
+		return a * X + b * Y + c;
+	}
+	double atPixel(int x, int y) const {
+		return a * (x * SUBPIXEL_SCALE) + b * (y * SUBPIXEL_SCALE) + c;
+	}
+	void flip() {
+		a = -a;
+		b = -b;
+		c = -c;
+		dx = -dx;
+		dy = -dy;
+	}
+};
 
 /**
- * @fn	static inline double f12(const VertexData &v0, const VertexData &v1, const VertexData &v2, double x, double y)
- * @brief	Computes f12. Implicit equation for the line between v1 and v2.
- * @see		*** page in textbook.
- * @param	v0	v0.
- * @param	v1	v1.
- * @param	v2	v2.
- * @param	x 	x coordinate.
- * @param	y 	y coordinate.
- * @return	f12.
+ * @fn	static void emitFragment(FrameBuffer &frameBuffer, const dvec3 &eyePos, const vector<LightSourcePtr> &lights, const VertexData &v0, const VertexData &v1, const VertexData &v2, int x, int y, double alpha, double beta, double gamma, const dmat4 &viewingMatrix)
+ * @brief	Interpolates the vertex attributes at a covered pixel and processes the fragment.
+ * @param [in,out]	frameBuffer  	Framebuffer.
+ * @param 		  	eyePos		 	Eye position.
+ * @param 		  	lights		 	Vector of lights in scene.
+ * @param 		  	v0			 	v0.
+ * @param 		  	v1			 	v1.
+ * @param 		  	v2			 	v2.
+ * @param 		  	x			 	The x coordinate of the pixel.
+ * @param 		  	y			 	The y coordinate of the pixel.
+ * @param 		  	alpha		 	Weight of v0.
+ * @param 		  	beta		 	Weight of v1.
+ * @param 		  	gamma		 	Weight of v2.
+ * @param 		  	viewingMatrix	Viewing matrix.
  */
 
-static inline double f12(const VertexData &v0, const VertexData &v1, const VertexData &v2, double x, double y) {
-	return (v1.pos.y - v2.pos.y) * x + (v2.pos.x - v1.pos.x) * y +
-		(v1.pos.x * v2.pos.y) - (v2.pos.x * v1.pos.y);
-
+static void emitFragment(FrameBuffer &frameBuffer, const dvec3 &eyePos, const vector<LightSourcePtr> &lights,
+							const VertexData &v0, const VertexData &v1, const VertexData &v2,
+							int x, int y, double alpha, double beta, double gamma,
+							const dmat4 &viewingMatrix) {
+	Fragment fragment;
+
+	// Interpolate vertex attributes using alpha, beta, and gamma weights. The
+	// material's fields are weighted here rather than through Material's operators,
+	// which build a temporary Material for every product and sum.
+	const Material &m0 = v0.material, &m1 = v1.material, &m2 = v2.material;
+	fragment.material.ambient = barycentricWeighting(alpha, beta, gamma, m0.ambient, m1.ambient, m2.ambient);
+	fragment.material.diffuse = barycentricWeighting(alpha, beta, gamma, m0.diffuse, m1.diffuse, m2.diffuse);
+	fragment.material.specular = barycentricWeighting(alpha, beta, gamma, m0.specular, m1.specular, m2.specular);
+	fragment.material.shininess = m0.shininess;
+	fragment.material.alpha = barycentricWeighting(alpha, beta, gamma, m0.alpha, m1.alpha, m2.alpha);
+	fragment.worldNormal = barycentricWeighting(alpha, beta, gamma,
+												v0.normal, v1.normal, v2.normal);
+	fragment.worldPos = barycentricWeighting(alpha, beta, gamma,
+												v0.worldPos, v1.worldPos, v2.worldPos);
+	double z = barycentricWeighting(alpha, beta, gamma,
+									v0.pos.z, v1.pos.z, v2.pos.z);
+	fragment.windowPos = dvec3(x, y, z);
+	FragmentOps::processFragment(frameBuffer, eyePos, lights, fragment, viewingMatrix);
 }
 
 /**
- * @fn	static inline double f20(const VertexData &v0, const VertexData &v1, const VertexData &v2, double x, double y)
- * @brief	Computes f20. Implicit equation for the line between v2 and v0.
- * @see		*** page in textbook.
- * @param	v0	v0.
- * @param	v1	v1.
- * @param	v2	v2.
- * @param	x 	x coordinate.
- * @param	y 	y coordinate.
- * @return	f02.
+ * @fn	void drawFilledTriangle(FrameBuffer &frameBuffer, const dvec3 &eyePos, const vector<LightSourcePtr> &lights, const VertexData &v0, const VertexData &v1, const VertexData &v2, const dmat4 &viewingMatrix)
+ * @brief	Draw filled triangle. A pixel is covered if its integer coordinates lie
+ * 			inside the triangle. A pixel exactly on an edge is covered only if the
+ * 			off-screen point (-1, -1) lies on the same side of that edge as the
+ * 			triangle, so pixels on an edge shared by two triangles are drawn once.
+ *
+ * 			The part of the bounding box inside the window is walked in blocks of
+ * 			RASTER_BLOCK_SIZE x RASTER_BLOCK_SIZE pixels. The edge functions are
+ * 			evaluated at a block's corners: a block outside one edge is skipped, a
+ * 			block inside all three is drawn without testing its pixels, and the
+ * 			pixels of the other blocks are tested SIMD_WIDTH at a time. Vertices are
+ * 			snapped to 1/256 of a pixel first.
+ * @param [in,out]	frameBuffer  	Framebuffer.
+ * @param 		  	eyePos		 	Eye position.
+ * @param 		  	lights		 	Vector of lights in scene.
+ * @param 		  	v0			 	v0.
+ * @param 		  	v1			 	v1.
+ * @param 		  	v2			 	v2.
+ * @param 		  	viewingMatrix	Viewing matrix.
  */
 
-static inline double f20(const VertexData &v0, const VertexData &v1, const VertexData &v2, double x, double y) {
-	return (v2.pos.y - v0.pos.y) * x + (v0.pos.x - v2.pos.x) * y +
-		(v2.pos.x * v0.pos.y) - (v0.pos.x * v2.pos.y);
-
+void drawFilledTriangle(FrameBuffer &frameBuffer, const dvec3 &eyePos, const vector<LightSourcePtr> &lights,
+						const VertexData &v0, const VertexData &v1, const VertexData &v2,
+						const dmat4 &viewingMatrix) {
+	BoundingBoxi window(0, frameBuffer.getWindowWidth() - 1, 0, frameBuffer.getWindowHeight() - 1);
+	drawFilledTriangle(frameBuffer, eyePos, lights, v0, v1, v2, viewingMatrix, window);
 }
 
 /**
- * @fn	void drawFilledTriangle(FrameBuffer &frameBuffer, const dvec3 &eyePos, const vector<LightSourcePtr> &lights, const VertexData &v0, const VertexData &v1, const VertexData &v2, const dmat4 &viewingMatrix)
- * @brief	Draw filled triangle.
+ * @fn	void drawFilledTriangle(FrameBuffer &frameBuffer, const dvec3 &eyePos, const vector<LightSourcePtr> &lights, const VertexData &v0, const VertexData &v1, const VertexData &v2, const dmat4 &viewingMatrix, const BoundingBoxi &scissor)
+ * @brief	Draw the pixels of a filled triangle that lie in a scissor rectangle.
+ * 			Each pixel gets exactly the fragment it would get from drawing the
+ * 			whole triangle, so a triangle drawn piecewise through scissors that
+ * 			tile the window looks the same as one drawn at once.
  * @param [in,out]	frameBuffer  	Framebuffer.
  * @param 		  	eyePos		 	Eye position.
  * @param 		  	lights		 	Vector of lights in scene.
@@ -597,47 +660,114 @@ static inline double f20(const VertexData &v0, const VertexData &v1, const Verte
  * @param 		  	v1			 	v1.
  * @param 		  	v2			 	v2.
  * @param 		  	viewingMatrix	Viewing matrix.
+ * @param 		  	scissor		 	The pixels that may be drawn, edges included.
  */
 
 void drawFilledTriangle(FrameBuffer &frameBuffer, const dvec3 &eyePos, const vector<LightSourcePtr> &lights,
 						const VertexData &v0, const VertexData &v1, const VertexData &v2,
-						const dmat4 &viewingMatrix) {
-	// Find minimimum and maximum x and y limits for the triangle
-	double xMin = glm::floor(min(v0.pos.x, v1.pos.x, v2.pos.x));
-	double xMax = glm::ceil(max(v0.pos.x, v1.pos.x, v2.pos.x));
-	double yMin = glm::floor(min(v0.pos.y, v1.pos.y, v2.pos.y));
-	double yMax = glm::ceil(max(v0.pos.y, v1.pos.y, v2.pos.y));
-
-	double fAlpha = f12(v0, v1, v2, v0.pos.x, v0.pos.y);
-	double fBeta = f20(v0, v1, v2, v1.pos.x, v1.pos.y);
-	double fGamma = f01(v0, v1, v2, v2.pos.x, v2.pos.y);
-
-	for (double y = yMin; y <= yMax; y++) {
-		for (double x = xMin; x <= xMax; x++) {	
-			// Calculate the weights for inperpolation
-			// If any weight is negative, the fragment is not in the triangle
-			double alpha = f12(v0, v1, v2, x, y) / fAlpha;
-			double beta = f20(v0, v1, v2, x, y) / fBeta;
-			double gamma = f01(v0, v1, v2, x, y) / fGamma;
-
-			// Determine if the pixel position is inside the triangle
-			if (alpha >= 0 && beta >= 0 && gamma >= 0) {
-				if ((alpha > 0 || fAlpha * f12(v0, v1, v2, -1, -1) > 0) &&
-					(beta > 0 || fBeta * f20(v0, v1, v2, -1, -1) > 0) &&
-					(gamma > 0 || fGamma * f01(v0, v1, v2, -1, -1) > 0)) {
-						Fragment fragment;
-
-						// Interpolate vertex attributes using alpha, beta, and gamma weights
-						fragment.material = barycentricWeighting(alpha, beta, gamma,
-																v0.material, v1.material, v2.material);
-						fragment.worldNormal = barycentricWeighting(alpha, beta, gamma,
-																	v0.normal, v1.normal, v2.normal);
-						fragment.worldPos = barycentricWeighting(alpha, beta, gamma,
-																	v0.worldPos, v1.worldPos, v2.worldPos);
-						double z = barycentricWeighting(alpha, beta, gamma,
-														v0.pos.z, v1.pos.z, v2.pos.z);
-						fragment.windowPos = dvec3(x, y, z);
-						FragmentOps::processFragment(frameBuffer, eyePos, lights, fragment, viewingMatrix);
+						const dmat4 &viewingMatrix, const BoundingBoxi &scissor) {
+	const dvec2 p[3] = { dvec2(v0.pos.x, v0.pos.y), dvec2(v1.pos.x, v1.pos.y), dvec2(v2.pos.x, v2.pos.y) };
+	dvec2 P[3];
+	for (int i = 0; i < 3; i++) {
+		if (!(std::abs(p[i].x) < MAX_WINDOW_COORD && std::abs(p[i].y) < MAX_WINDOW_COORD)) {
+			return;
+		}
+		P[i] = dvec2(std::round(p[i].x * SUBPIXEL_SCALE), std::round(p[i].y * SUBPIXEL_SCALE));
+	}
+
+	// Find minimimum and maximum x and y limits for the triangle inside the scissor
+	int xMin = std::max({ 0, scissor.lx, (int)std::floor(min(p[0].x, p[1].x, p[2].x)) });
+	int xMax = std::min({ frameBuffer.getWindowWidth() - 1, scissor.rx, (int)std::ceil(max(p[0].x, p[1].x, p[2].x)) });
+	int yMin = std::max({ 0, scissor.ly, (int)std::floor(min(p[0].y, p[1].y, p[2].y)) });
+	int yMax = std::min({ frameBuffer.getWindowHeight() - 1, scissor.ry, (int)std::ceil(max(p[0].y, p[1].y, p[2].y)) });
+	if (xMin > xMax || yMin > yMax) {
+		return;
+	}
+
+	// e[0] is zero on the edge opposite v0 and equals area at v0, and so on.
+	EdgeFunction e[3] = { EdgeFunction(P[1], P[2]), EdgeFunction(P[2], P[0]), EdgeFunction(P[0], P[1]) };
+	double area = e[0].at(P[0].x, P[0].y);
+	if (area == 0.0) {
+		return;
+	}
+	for (int k = 0; k < 3; k++) {
+		if (area < 0.0) {
+			e[k].flip();
+		}
+		e[k].bias = e[k].at(-SUBPIXEL_SCALE, -SUBPIXEL_SCALE) > 0.0 ? 0.0 : 1.0;
+	}
+	const double invArea = 1.0 / std::abs(area);
+
+	// Within a row, lane i of a SIMD vector holds E at the i-th pixel of a group.
+	alignas(64) double laneIndices[SIMD_WIDTH];
+	for (int i = 0; i < SIMD_WIDTH; i++) {
+		laneIndices[i] = i;
+	}
+	const vdouble lanes = vload(laneIndices);
+	const vdouble zero = vset1(0.0);
+	vdouble laneSteps[3], groupSteps[3];
+	for (int k = 0; k < 3; k++) {
+		laneSteps[k] = vmul(lanes, vset1(e[k].dx));
+		groupSteps[k] = vset1(SIMD_WIDTH * e[k].dx);
+	}
+
+	const int B = RASTER_BLOCK_SIZE;
+	for (int by = yMin; by <= yMax; by += B) {
+		const int h = std::min(B, yMax - by + 1);
+		for (int bx = xMin; bx <= xMax; bx += B) {
+			const int w = std::min(B, xMax - bx + 1);
+			// A pixel is covered iff E - bias >= 0 for all three edges.
+			double rowE[3];
+			bool outside = false;
+			bool inside = true;
+			for (int k = 0; k < 3; k++) {
+				rowE[k] = e[k].atPixel(bx, by) - e[k].bias;
+				double spanX = (w - 1) * e[k].dx;
+				double spanY = (h - 1) * e[k].dy;
+				outside = outside || rowE[k] + std::max(spanX, 0.0) + std::max(spanY, 0.0) < 0.0;
+				inside = inside && rowE[k] + std::min(spanX, 0.0) + std::min(spanY, 0.0) >= 0.0;
+			}
+			if (outside) {
+				continue;
+			}
+			if (inside) {
+				for (int y = by; y < by + h; y++) {
+					for (int x = 0; x < w; x++) {
+						double alpha = (rowE[0] + x * e[0].dx + e[0].bias) * invArea;
+						double beta = (rowE[1] + x * e[1].dx + e[1].bias) * invArea;
+						double gamma = (rowE[2] + x * e[2].dx + e[2].bias) * invArea;
+						emitFragment(frameBuffer, eyePos, lights, v0, v1, v2,
+										bx + x, y, alpha, beta, gamma, viewingMatrix);
+					}
+					for (int k = 0; k < 3; k++) {
+						rowE[k] += e[k].dy;
+					}
+				}
+				continue;
+			}
+			for (int y = by; y < by + h; y++) {
+				vdouble E[3];
+				for (int k = 0; k < 3; k++) {
+					E[k] = vadd(vset1(rowE[k]), laneSteps[k]);
+				}
+				for (int x = 0; x < w; x += SIMD_WIDTH) {
+					unsigned covered = (1u << std::min(SIMD_WIDTH, w - x)) - 1;
+					covered &= vbits(vand(vge(E[0], zero), vand(vge(E[1], zero), vge(E[2], zero))));
+					for (int i = 0; covered != 0; i++, covered >>= 1) {
+						if ((covered & 1) != 0) {
+							double alpha = (rowE[0] + (x + i) * e[0].dx + e[0].bias) * invArea;
+							double beta = (rowE[1] + (x + i) * e[1].dx + e[1].bias) * invArea;
+							double gamma = (rowE[2] + (x + i) * e[2].dx + e[2].bias) * invArea;
+							emitFragment(frameBuffer, eyePos, lights, v0, v1, v2,
+											bx + x + i, y, alpha, beta, gamma, viewingMatrix);
+						}
+					}
+					for (int k = 0; k < 3; k++) {
+						E[k] = vadd(E[k], groupSteps[k]);
+					}
+				}
+				for (int k = 0; k < 3; k++) {
+					rowE[k] += e[k].dy;
 				}
 			}
 		}
@@ -664,3 +794,23 @@ void drawManyFilledTriangles(FrameBuffer &frameBuffer, const dvec3 &eyePos,
 		drawFilledTriangle(frameBuffer, eyePos, lights, Vi, Vi1, Vi2, viewingMatrix);
 	}
 }
+
+/**
+ * @fn	void drawManyFilledTriangles(FrameBuffer &frameBuffer, const dvec3 &eyePos, const vector<LightSourcePtr> &lights, const vector<VertexData> &vertices, const dmat4 &viewingMatrix, const BoundingBoxi &scissor)
+ * @brief	Draw the pixels of many filled triangles that lie in a scissor rectangle.
+ * @param [in,out]	frameBuffer  	Framebuffer.
+ * @param 		  	eyePos		 	Eye position.
+ * @param 		  	lights		 	Vector of lights in scene.
+ * @param 		  	vertices	 	The vector of vertice-triplets.
+ * @param 		  	viewingMatrix	Viewing matrix.
+ * @param 		  	scissor		 	The pixels that may be drawn, edges included.
+ */
+
+void drawManyFilledTriangles(FrameBuffer &frameBuffer, const dvec3 &eyePos,
+							const vector<LightSourcePtr> &lights, const vector<VertexData> &vertices,
+							const dmat4 &viewingMatrix, const BoundingBoxi &scissor) {
+	for (size_t i = 0; i + 2 < vertices.size(); i += 3) {
+		drawFilledTriangle(frameBuffer, eyePos, lights, vertices[i], vertices[i + 1], vertices[i + 2],
+							viewingMatrix, scissor);
+	}
+}
@@ -27,14 +27,20 @@ void drawManyLines(FrameBuffer &frameBuffer, const dvec3 &eyePos,
 void drawWireFrameTriangle(FrameBuffer &frameBuffer, const dvec3 &eyePos,
 							const vector<LightSourcePtr> &lights, const VertexData &v0, const VertexData &v1, const VertexData &v2,
 							const dmat4 &viewingMatrix);
-void drawFilledTriangle(FrameBuffer &frameBuffer, const dvec3 &eyePos, vector<LightSourcePtr> &lights, const VertexData &v0,
+void drawFilledTriangle(FrameBuffer &frameBuffer, const dvec3 &eyePos, const vector<LightSourcePtr> &lights, const VertexData &v0,
 						const VertexData &v1, const VertexData &v2,
 						const dmat4 &viewingMatrix);
+void drawFilledTriangle(FrameBuffer &frameBuffer, const dvec3 &eyePos, const vector<LightSourcePtr> &lights, const VertexData &v0,
+						const VertexData &v1, const VertexData &v2,
+						const dmat4 &viewingMatrix, const BoundingBoxi &scissor);
 void drawManyWireFrameTriangles(FrameBuffer &frameBuffer, const dvec3 &eyePos, 
 								const vector<LightSourcePtr> &lights, const vector<VertexData> &vertices,
 								const dmat4 &viewingMatrix);
 void drawManyFilledTriangles(FrameBuffer &frameBuffer, const dvec3 &eyePos,
 							const vector<LightSourcePtr> &lights, const vector<VertexData> &vertices,
 							const dmat4 &viewingMatrix);
+void drawManyFilledTriangles(FrameBuffer &frameBuffer, const dvec3 &eyePos,
+							const vector<LightSourcePtr> &lights, const vector<VertexData> &vertices,
+							const dmat4 &viewingMatrix, const BoundingBoxi &scissor);
 void drawArc(FrameBuffer &fb, const dvec2 &center, double R,
 				double startRads, double lengthInRads, const color &rgb);
\ No newline at end of file
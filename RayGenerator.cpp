@@ -0,0 +1,94 @@
+/****************************************************
+ * 2016-2020 Eric Bachmann and Mike Zmuda
+ * All Rights Reserved.
+ * NOTICE:
+ * Dissemination of this information or reproduction
+ * of this material is prohibited unless prior written
+ * permission is granted..
+ ****************************************************/
+
+#include "RayGenerator.h"
+
+/**
+ * @fn	RayGenerator::RayGenerator()
+ * @brief	Constructs a generator with no view; setView must be called before
+ * 			any rays are made.
+ */
+
+RayGenerator::RayGenerator() : camera(nullptr), projection(OTHER) {
+}
+
+/**
+ * @fn	void RayGenerator::setView(const RaytracingCamera &camera, int width, int height)
+ * @brief	Prepares the rays of a camera for a window. Costs one projection per row
+ * 			and column, so it can be called at the start of every frame. The camera
+ * 			must not change until the frame's rays have been made.
+ * @param	camera	The camera, whose viewing parameters are up to date.
+ * @param	width 	The window's width.
+ * @param	height	The window's height.
+ */
+
+void RayGenerator::setView(const RaytracingCamera &camera, int width, int height) {
+	this->camera = &camera;
+	const Frame &frame = camera.cameraFrame;
+	const PerspectiveCamera *perspective = dynamic_cast<const PerspectiveCamera *>(&camera);
+	if (perspective != nullptr) {
+		projection = PERSPECTIVE;
+		base = -perspective->distToPlane * frame.w;
+	} else if (dynamic_cast<const OrthographicCamera *>(&camera) != nullptr) {
+		projection = ORTHOGRAPHIC;
+		base = frame.origin;
+		dir = -frame.w;
+	} else {
+		projection = OTHER;
+		return;
+	}
+
+	// Same expressions as getProjectionPlaneCoordinates, so the sums match getRay.
+	columnTerms.resize(width);
+	for (int x = 0; x < width; x++) {
+		columnTerms[x] = camera.getProjectionPlaneCoordinates(x, 0).x * frame.u;
+	}
+	rowTerms.resize(height);
+	for (int y = 0; y < height; y++) {
+		rowTerms[y] = camera.getProjectionPlaneCoordinates(0, y).y * frame.v;
+	}
+}
+
+/**
+ * @fn	int RayGenerator::getRays(const Tile &block, Ray rays[]) const
+ * @brief	Gets the primary rays of a block of pixels, row by row.
+ * @param 		  	block	The pixels.
+ * @param [in,out]	rays 	Receives block.area() rays.
+ * @return	The number of rays made.
+ */
+
+int RayGenerator::getRays(const Tile &block, Ray rays[]) const {
+	if (projection == OTHER) {
+		int n = 0;
+		for (int y = block.y0; y < block.y1; y++) {
+			for (int x = block.x0; x < block.x1; x++) {
+				rays[n++] = camera->getRay(x, y);
+			}
+		}
+		return n;
+	}
+	const dvec3 &origin = camera->cameraFrame.origin;
+	int n = 0;
+	for (int y = block.y0; y < block.y1; y++) {
+		dvec3 rowBase = base + rowTerms[y];
+		for (int x = block.x0; x < block.x1; x++) {
+			Ray &ray = rays[n++];
+			if (projection == PERSPECTIVE) {
+				ray.origin = origin;
+				ray.dir = glm::normalize(rowBase + columnTerms[x]);
+			} else {
+				ray.origin = rowBase + columnTerms[x];
+				ray.dir = dir;
+			}
+			ray.tMin = 0.0;
+			ray.tMax = FLT_MAX;
+		}
+	}
+	return n;
+}
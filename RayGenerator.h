@@ -0,0 +1,62 @@
+/****************************************************
+ * 2016-2020 Eric Bachmann and Mike Zmuda
+ * All Rights Reserved.
+ * NOTICE:
+ * Dissemination of this information or reproduction
+ * of this material is prohibited unless prior written
+ * permission is granted..
+ ****************************************************/
+
+#pragma once
+#include "IShape.h"
+#include "Camera.h"
+#include "TileScheduler.h"
+
+/**
+ * @struct	RayGenerator
+ * @brief	Makes the primary rays of a camera for one frame. setView splits the
+ * 			camera's ray through pixel (x, y) into a term that depends only on the
+ * 			column and one that depends only on the row, so that a ray costs two
+ * 			additions and, for a perspective camera, a single normalization. The
+ * 			rays are bit for bit those of the camera's getRay. A camera of any
+ * 			other type falls back to its own getRay.
+ *
+ * 			The generator is only read while rendering, so any number of threads
+ * 			may make rays from it at once.
+ */
+
+struct RayGenerator {
+	RayGenerator();
+	void setView(const RaytracingCamera &camera, int width, int height);
+	Ray getRay(int x, int y) const;
+	int getRays(const Tile &block, Ray rays[]) const;
+protected:
+	enum Projection { PERSPECTIVE, ORTHOGRAPHIC, OTHER };
+	const RaytracingCamera *camera;
+	Projection projection;
+	dvec3 base;						//!< Perspective: -distToPlane * w. Orthographic: the camera's position.
+									//!< A row's term is added to it first, so a block adds it once per row.
+	dvec3 dir;						//!< Direction of every orthographic ray.
+	vector<dvec3> columnTerms;		//!< Projection plane u coordinate of each column, times u.
+	vector<dvec3> rowTerms;			//!< Projection plane v coordinate of each row, times v.
+};
+
+/**
+ * @fn	inline Ray RayGenerator::getRay(int x, int y) const
+ * @brief	Gets the primary ray through pixel (x, y).
+ * @param	x	The x coordinate, less than the width given to setView.
+ * @param	y	The y coordinate, less than the height given to setView.
+ * @return	The same ray as the camera's getRay(x, y).
+ */
+
+inline Ray RayGenerator::getRay(int x, int y) const {
+	switch (projection) {
+	case PERSPECTIVE:
+		return Ray::withUnitDir(camera->cameraFrame.origin,
+								glm::normalize(base + rowTerms[y] + columnTerms[x]));
+	case ORTHOGRAPHIC:
+		return Ray::withUnitDir(base + rowTerms[y] + columnTerms[x], dir);
+	default:
+		return camera->getRay(x, y);
+	}
+}
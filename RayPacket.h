@@ -0,0 +1,94 @@
+/****************************************************
+ * 2016-2020 Eric Bachmann and Mike Zmuda
+ * All Rights Reserved.
+ * NOTICE:
+ * Dissemination of this information or reproduction
+ * of this material is prohibited unless prior written
+ * permission is granted..
+ ****************************************************/
+
+#pragma once
+#include "SIMD.h"
+#include "IShape.h"
+
+#ifndef RAY_PACKET_SIZE
+#define RAY_PACKET_SIZE 8				//!< Rays per packet: 4, 8 or 16.
+#endif
+
+/**
+ * @struct	RayPacket
+ * @brief	A group of rays that are traced together. Each ray component is kept in
+ * 			its own array, so SIMD_WIDTH neighbouring lanes can be loaded into one
+ * 			vector register. Every lane tracks its own closest hit. Queries take a
+ * 			bit mask of lanes, and lanes whose bit is clear are left untouched.
+ */
+
+struct RayPacket {
+	static const int SIZE = RAY_PACKET_SIZE;
+	static const int BLOCK_WIDTH = SIZE >= 8 ? 4 : 2;		//!< Width of the pixel block traced as one packet.
+	static const int BLOCK_HEIGHT = SIZE / BLOCK_WIDTH;		//!< Height of the pixel block traced as one packet.
+	static const unsigned ALL_LANES = (1u << SIZE) - 1;		//!< Mask with every lane set.
+
+	alignas(64) double ox[SIZE];
+	alignas(64) double oy[SIZE];
+	alignas(64) double oz[SIZE];			//!< origins
+	alignas(64) double dx[SIZE];
+	alignas(64) double dy[SIZE];
+	alignas(64) double dz[SIZE];			//!< unit directions
+	alignas(64) double idx[SIZE];
+	alignas(64) double idy[SIZE];
+	alignas(64) double idz[SIZE];			//!< reciprocals of the directions
+	alignas(64) double tMin[SIZE];			//!< hits at or before this t are ignored
+	alignas(64) double closestT[SIZE];		//!< closest t found so far; the ray's tMax if none
+	const VisibleIShape *closest[SIZE];		//!< the surface that produced closestT
+	const Ray *rays;						//!< the rays the lanes were loaded from
+	bool sameOrigin;						//!< true if every lane starts at rays[0].origin
+
+	RayPacket(const Ray rays[], int numRays);
+	static int countLanes(unsigned lanes);
+};
+
+static_assert(RayPacket::SIZE % SIMD_WIDTH == 0 && RayPacket::SIZE >= 4 && RayPacket::SIZE <= 16,
+				"RAY_PACKET_SIZE must be 4, 8 or 16, and a multiple of SIMD_WIDTH");
+
+/**
+ * @fn	inline RayPacket::RayPacket(const Ray rays[], int numRays)
+ * @brief	Loads up to SIZE rays into the lanes. Lanes past numRays repeat the
+ * 			first ray and should be masked off by the caller.
+ * @param	rays   	The rays, which must outlive the packet.
+ * @param	numRays	Number of rays; 1 to SIZE.
+ */
+
+inline RayPacket::RayPacket(const Ray rays[], int numRays) : rays(rays), sameOrigin(true) {
+	for (int i = 0; i < SIZE; i++) {
+		const Ray &ray = rays[i < numRays ? i : 0];
+		sameOrigin = sameOrigin && ray.origin == rays[0].origin;
+		ox[i] = ray.origin.x;
+		oy[i] = ray.origin.y;
+		oz[i] = ray.origin.z;
+		dx[i] = ray.dir.x;
+		dy[i] = ray.dir.y;
+		dz[i] = ray.dir.z;
+		idx[i] = 1.0 / ray.dir.x;
+		idy[i] = 1.0 / ray.dir.y;
+		idz[i] = 1.0 / ray.dir.z;
+		tMin[i] = ray.tMin;
+		closestT[i] = ray.tMax;
+		closest[i] = nullptr;
+	}
+}
+
+/**
+ * @fn	inline int RayPacket::countLanes(unsigned lanes)
+ * @brief	Counts the lanes set in a mask.
+ * @param	lanes	The mask.
+ * @return	The number of bits set.
+ */
+
+inline int RayPacket::countLanes(unsigned lanes) {
+	int count = 0;
+	for (; lanes != 0; lanes &= lanes - 1) {
+		count++;
+	}
+	return count;
+}
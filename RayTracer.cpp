@@ -8,9 +8,13 @@
  ****************************************************/
 
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include "RayTracer.h"
 #include "IShape.h"
 #include "Light.h"
+#include "RenderStats.h"
 
 
 /**
@@ -20,147 +24,602 @@
  */
 
 RayTracer::RayTracer(const color &defa)
-	: defaultColor(defa) {
+	: defaultColor(defa), tileSize(DEFAULT_TILE_SIZE), usePackets(true), useGBuffer(false), useShadowCache(true),
+		useLightInfluence(true), useOriginTerms(true), rayBudget(DEFAULT_RAY_BUDGET), minPathWeight(DEFAULT_MIN_PATH_WEIGHT),
+		minLightContribution(DEFAULT_MIN_LIGHT_CONTRIBUTION), maxSamples(DEFAULT_MAX_SAMPLES),
+		edgeContrast(DEFAULT_EDGE_CONTRAST), edgeDepthRatio(DEFAULT_EDGE_DEPTH_RATIO), frameBudgetMs(0.0) {
+}
+
+/**
+ * @fn	void RayTracer::setNumThreads(int numThreads)
+ * @brief	Sets the number of threads used by raytraceScene. The output does not
+ * 			depend on the number of threads.
+ * @param	numThreads	Number of threads; 1 traces serially, and values less than 1
+ * 						use every hardware thread.
+ */
+
+void RayTracer::setNumThreads(int numThreads) {
+	if (numThreads < 1) {
+		numThreads = TileScheduler::defaultNumThreads();
+	}
+	if (numThreads == 1) {
+		scheduler.reset();
+	} else if (scheduler == nullptr || scheduler->getNumThreads() != numThreads) {
+		scheduler.reset(new TileScheduler(numThreads));
+	}
+}
+
+/**
+ * @fn	int RayTracer::getNumThreads() const
+ * @brief	Gets the number of threads used by raytraceScene.
+ * @return	The number of threads.
+ */
+
+int RayTracer::getNumThreads() const {
+	return scheduler == nullptr ? 1 : scheduler->getNumThreads();
 }
 
 /**
  * @fn	void RayTracer::raytraceScene(FrameBuffer &frameBuffer, int depth, const IScene &theScene) const
- * @brief	Raytrace scene
+ * @brief	Raytrace scene. With more than one thread, the window is split into tiles
+ * 			that are shared out among the scheduler's workers. The call is one
+ * 			RenderStats frame, unless the caller has already begun one.
+ *
+ * 			With useGBuffer set, the primary hits are kept, and a later frame with
+ * 			the same window, camera and geometry is shaded from them without casting
+ * 			primary rays. Lights and materials may change in between.
+ *
+ * 			With maxSamples above 1, the frame is antialiased adaptively: after every
+ * 			pixel has its first sample, the pixels on an edge are refined by
+ * 			refineTile. The number of refined pixels and extra samples is counted
+ * 			in the frame's RenderStats.
+ *
+ * 			With frameBudgetMs set, the frame is traced by traceProgressively instead.
+ * 			With useGBuffer set as well, the primary hits are kept as its levels are
+ * 			traced, and once the view is traced at full resolution, a change of
+ * 			lights is shaded from them at full resolution.
  * @param [in,out]	frameBuffer	Framebuffer.
- * @param 		  	depth	   	The current depth of recursion.
+ * @param 		  	depth	   	Number of reflections traced beyond the first hit.
  * @param 		  	theScene   	The scene.
  */
 
 void RayTracer::raytraceScene(FrameBuffer &frameBuffer, int depth,
 								const IScene &theScene) const {
-	const RaytracingCamera &camera = *theScene.camera;
-	const vector<VisibleIShapePtr> &objs = theScene.opaqueObjs;
-	const vector<PositionalLightPtr> &lights = theScene.lights;
-	//PositionalLight posLight(dvec3(-10, 10, 10), pureWhiteLight);
-
-	for (int y = 0; y < frameBuffer.getWindowHeight(); ++y) {
-		for (int x = 0; x < frameBuffer.getWindowWidth(); ++x) {
-			DEBUG_PIXEL = (x == xDebug && y == yDebug);
-			if (DEBUG_PIXEL) {
-				cout << "";
+	RenderStats::beginFrame();
+	// Build the hierarchies before any worker needs them.
+	const BVH &opaqueBVH = theScene.getOpaqueBVH();
+	const BVH &sceneBVH = theScene.getSceneBVH();
+	const int W = frameBuffer.getWindowWidth();
+	const int H = frameBuffer.getWindowHeight();
+	lightInfluences.clear();
+	if (useLightInfluence) {
+		for (PositionalLightPtr light : theScene.lights) {
+			lightInfluences.push_back(light->influence(minLightContribution));
+		}
+	}
+
+	rayGenerator.setView(*theScene.camera, W, H);
+
+	bool progressive = frameBudgetMs > 0.0;
+	// Progressive tracing fills the G-buffer level by level; it is complete once the last level is.
+	bool reshade = !progressive && useGBuffer && refinement.stride == 0 &&
+					gBuffer.isCurrent(*theScene.camera, theScene, W, H);
+	if (!useGBuffer) {
+		gBuffer.invalidate();
+	} else if (!progressive && !reshade) {
+		gBuffer.setView(*theScene.camera, theScene, W, H);
+	}
+	// Every primary ray of a perspective camera starts at the camera.
+	if (useOriginTerms && !reshade && dynamic_cast<const PerspectiveCamera *>(theScene.camera) != nullptr) {
+		theScene.setRayOrigin(theScene.camera->cameraFrame.origin);
+	}
+	if (maxSamples > 1) {
+		firstSamples.resize((size_t)W * H);
+	} else {
+		firstSamples.clear();
+	}
+	if (progressive) {
+		traceProgressively(frameBuffer, depth, theScene, opaqueBVH, sceneBVH);
+		frameBuffer.showColorBuffer();
+		RenderStats::endFrame();
+		return;
+	}
+
+	vector<Tile> tiles;
+	if (scheduler == nullptr || scheduler->getNumThreads() == 1) {
+		tiles.push_back({ 0, 0, W, H });
+	} else {
+		tiles = Tile::makeTiles(W, H, tileSize);
+	}
+	forEachTile(tiles, [&](const Tile &tile) {
+		if (reshade) {
+			reshadeTile(frameBuffer, tile, depth, theScene, opaqueBVH, sceneBVH);
+		} else {
+			traceTile(frameBuffer, tile, depth, theScene, opaqueBVH, sceneBVH);
+		}
+	});
+	// Edges are found from the neighbours' first samples, so every pixel needs
+	// one before any pixel is refined.
+	if (maxSamples > 1) {
+		forEachTile(tiles, [&](const Tile &tile) {
+			refineTile(frameBuffer, tile, depth, theScene, opaqueBVH, sceneBVH);
+		});
+	}
+	frameBuffer.showColorBuffer();
+	RenderStats::endFrame();
+}
+
+/**
+ * @fn	void RayTracer::forEachTile(const vector<Tile> &tiles, const std::function<void(const Tile &)> &work) const
+ * @brief	Does the work for every tile, shared out among the scheduler's workers
+ * 			when there is more than one thread.
+ * @param	tiles	The tiles.
+ * @param	work 	The work, which may run on several tiles at once.
+ */
+
+void RayTracer::forEachTile(const vector<Tile> &tiles, const std::function<void(const Tile &)> &work) const {
+	if (scheduler == nullptr || scheduler->getNumThreads() == 1) {
+		for (const Tile &tile : tiles) {
+			work(tile);
+		}
+	} else {
+		scheduler->run(tiles, [&](const Tile &tile, int) {
+			work(tile);
+		});
+	}
+}
+
+/**
+ * @fn	bool RayTracer::isRefining() const
+ * @brief	Determines if progressive tracing has more to do for the current view. An
+ * 			interactive application keeps asking for frames while this is true.
+ * @return	True iff frameBudgetMs is set and the last view is not yet traced at full
+ * 			resolution, or not yet antialiased.
+ */
+
+bool RayTracer::isRefining() const {
+	return frameBudgetMs > 0.0 && (refinement.stride > 0 || (maxSamples > 1 && !refinement.antialiased));
+}
+
+/**
+ * @fn	void RayTracer::restartRefinement()
+ * @brief	Makes the next progressive frame start over at reduced resolution. Moving
+ * 			the camera, objects or lights, editing lights, or resizing the window,
+ * 			restarts it by itself; other edits, such as to materials or the number
+ * 			of reflections, need this call.
+ */
+
+void RayTracer::restartRefinement() {
+	refinement.view.invalidate();
+}
+
+/**
+ * @fn	void RayTracer::traceProgressively(FrameBuffer &frameBuffer, int depth, const IScene &theScene, const BVH &opaqueBVH, const BVH &sceneBVH) const
+ * @brief	Traces as much of the view as fits in frameBudgetMs. When the view has
+ * 			changed since the last frame, it is first traced in full at every
+ * 			firstStride-th pixel: the smallest power of two, up to MAX_STRIDE, at
+ * 			which the cost per pixel measured on the previous view fits the budget. Each level
+ * 			after that halves the spacing and traces only the pixels
+ * 			the earlier levels skipped, and the last one antialiases. A traced pixel
+ * 			fills its whole stride x stride block, so the window is always covered.
+ * 			Once everything is done, every pixel has the color of a full frame.
+ *
+ * 			With useGBuffer set, every traced pixel's primary hits are kept. When
+ * 			only the lights have changed since the view was traced at full
+ * 			resolution, the whole window is shaded again from them, without
+ * 			primary rays, and only the antialiasing is redone over later frames.
+ * @param [in,out]	frameBuffer   	Framebuffer.
+ * @param 		  	depth		  	Number of reflections traced beyond the first hit.
+ * @param 		  	theScene	  	The scene.
+ * @param 		  	opaqueBVH	  	Hierarchy over the scene's opaque objects.
+ * @param 		  	sceneBVH	  	Hierarchy over all the scene's objects.
+ */
+
+void RayTracer::traceProgressively(FrameBuffer &frameBuffer, int depth, const IScene &theScene,
+									const BVH &opaqueBVH, const BVH &sceneBVH) const {
+	auto start = std::chrono::steady_clock::now();
+	auto elapsedMs = [&]() {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	};
+	const int W = frameBuffer.getWindowWidth();
+	const int H = frameBuffer.getWindowHeight();
+	Refinement &r = refinement;
+
+	vector<dvec4> lights;
+	for (PositionalLightPtr light : theScene.lights) {
+		const SpotLight *spot = dynamic_cast<const SpotLight *>(light);
+		lights.push_back(dvec4(light->pos, light->isOn ? 1.0 : 0.0));
+		lights.push_back(dvec4(light->atParams.constant, light->atParams.linear, light->atParams.quadratic,
+								light->attenuationIsTurnedOn ? 1.0 : 0.0));
+		lights.push_back(spot != nullptr ? dvec4(spot->spotDir, spot->fov) : dvec4(0.0));
+		lights.push_back(dvec4(light->lightColor.ambient, 0.0));
+		lights.push_back(dvec4(light->lightColor.diffuse, 0.0));
+		lights.push_back(dvec4(light->lightColor.specular, 0.0));
+	}
+	bool sameView = r.view.matches(*theScene.camera, theScene, W, H);
+	if (sameView && lights != r.lights && useGBuffer && r.stride == 0 &&
+		gBuffer.isCurrent(*theScene.camera, theScene, W, H)) {
+		r.lights = lights;
+		forEachTile(r.tiles, [&](const Tile &tile) {
+			reshadeTile(frameBuffer, tile, depth, theScene, opaqueBVH, sceneBVH);
+		});
+		r.antialiased = false;
+		r.tileDone.assign(r.tiles.size(), 0);
+	}
+	bool restart = !sameView || lights != r.lights;
+	if (restart) {
+		r.view.set(*theScene.camera, theScene, W, H);
+		r.lights = lights;
+		if (useGBuffer) {
+			gBuffer.setView(*theScene.camera, theScene, W, H);
+		}
+		// Every finished level samples the whole window, so the view's average cost
+		// is a fair estimate for the next one.
+		if (r.pixelsTraced > 0) {
+			r.msPerPixel = r.tracingMs / r.pixelsTraced;
+		}
+		r.tracingMs = 0.0;
+		r.pixelsTraced = 0;
+		r.firstStride = 1;
+		while (r.firstStride < MAX_STRIDE &&
+				(r.msPerPixel == 0.0 || r.msPerPixel * W * H / (r.firstStride * r.firstStride) > frameBudgetMs)) {
+			r.firstStride *= 2;
+		}
+		r.stride = r.firstStride;
+		r.antialiased = false;
+		r.tiles = Tile::makeTiles(W, H, tileSize);
+		r.tileDone.assign(r.tiles.size(), 0);
+	}
+
+	// A new view covers the window before the budget is looked at.
+	bool mustFinish = restart;
+	while (isRefining() && (mustFinish || elapsedMs() < frameBudgetMs)) {
+		int stride = r.stride;
+		int coarserStride = stride == r.firstStride ? 0 : 2 * stride;
+		double levelStart = elapsedMs();
+		std::atomic<long long> levelPixels(0);
+		forEachTile(r.tiles, [&](const Tile &tile) {
+			size_t i = &tile - r.tiles.data();
+			if (r.tileDone[i] || (!mustFinish && elapsedMs() >= frameBudgetMs)) {
+				return;
 			}
-			Ray ray = camera.getRay(x, y);
-			HitRecord hit = VisibleIShape::findIntersection(ray, theScene.opaqueObjs);
-			HitRecord hit2 = VisibleIShape::findIntersection(ray, theScene.transparentObjs);
-			color totalColor;
-			color transColor;
-			bool inShadow = false;
-			bool inShadowTrans = false;
-			
-
-			for (PositionalLightPtr light : theScene.lights) { // can I include both transparent and not transparent in one loop or separate into two?
-				// determine distance to light from intersection
-				dvec3 distance = light->pos - hit.interceptPt;
-				double d = glm::distance(light->pos, hit.interceptPt);
-				// determine direction to light source from intersection. How?
-				dvec3 direction(light->pos.x - hit.interceptPt.x, light->pos.y - hit.interceptPt.y, light->pos.z - hit.interceptPt.z);
-				normalize(direction);
-
-				// make a shadow feeler using intersection as origin and direction as light vector
-				//ShadowFeeler shadow = ShadowFeeler(hit.interceptPt, direction);
-				Ray shadowFeeler = Ray(hit.interceptPt + 0.001 * hit.normal, direction);
-				Ray shadowFeeler2 = Ray((hit2.interceptPt + 0.001 * hit2.normal), direction);
-				// check the shadow feeler for intersection with object in scene to find the first object it hits (using hitrecotd?)
-				HitRecord shadowHit = VisibleIShape::findIntersection(shadowFeeler, theScene.opaqueObjs);
-				HitRecord shadowHitTrans = VisibleIShape::findIntersection(shadowFeeler2, theScene.opaqueObjs);
-				dvec3 newDistance = light->pos - shadowHit.interceptPt;
-				dvec3 newDistance2 = light->pos - shadowHitTrans.interceptPt;
-				if (newDistance.z < distance.z) {
-					inShadow = true;
-				}
-				else {
-					inShadow = false;
-				}
+			if (stride > 0) {
+				traceTileLevel(frameBuffer, tile, stride, coarserStride, depth, theScene, opaqueBVH, sceneBVH);
+				int columns = (tile.x1 - tile.x0 + stride - 1) / stride;
+				int rows = (tile.y1 - tile.y0 + stride - 1) / stride;
+				levelPixels += (long long)columns * rows;
+			} else {
+				refineTile(frameBuffer, tile, depth, theScene, opaqueBVH, sceneBVH);
+			}
+			r.tileDone[i] = 1;
+		});
+		if (stride > 0) {
+			r.tracingMs += elapsedMs() - levelStart;
+			r.pixelsTraced += levelPixels;
+		}
+		if (std::find(r.tileDone.begin(), r.tileDone.end(), 0) != r.tileDone.end()) {
+			break;
+		}
+		if (stride > 0) {
+			r.stride /= 2;
+		} else {
+			r.antialiased = true;
+		}
+		r.tileDone.assign(r.tiles.size(), 0);
+		mustFinish = false;
+	}
+}
 
-				if (newDistance2.z < distance.z) {
-					inShadowTrans = true;
-				}
-				else {
-					inShadowTrans = false;
-				}
-				// if there is no hit or if distance to the intersection > distance to the light then do below
-				if (hit.texture != nullptr) {
-					color C = hit.texture->getPixelUV(hit.u, hit.v);
-					totalColor = totalColor + C;
-				}
-				color c = light->illuminate(hit.interceptPt, hit.normal, hit.material, camera.cameraFrame, inShadow);
-				color transLight = light->illuminate(hit2.interceptPt, hit2.normal, hit2.material, camera.cameraFrame, inShadow);
-				// color trans = hit2.material.ambient * hit2.material.alpha; // hit2.interceptPt, hit2.normal, hit2.material, camera.cameraFrame, false);
-				totalColor = totalColor + c /*+ trans*/;
-				transColor = totalColor + c + transLight;
-				dvec3 n = hit.normal;
-				if (glm::dot(n, ray.dir) > 0) {
-					n = -n;
+/**
+ * @fn	void RayTracer::traceTileLevel(FrameBuffer &frameBuffer, const Tile &tile, int stride, int coarserStride, int depth, const IScene &theScene, const BVH &opaqueBVH, const BVH &sceneBVH) const
+ * @brief	Traces the pixels of a tile that lie on a grid with the given spacing,
+ * 			counted from the tile's corner, and fills each one's stride x stride
+ * 			block with its color. Pixels on the coarser level's grid were traced
+ * 			already and are skipped. In packet mode the pixels are intersected
+ * 			RayPacket::SIZE at a time. With useGBuffer set, their primary hits are kept.
+ * @param [in,out]	frameBuffer   	Framebuffer.
+ * @param 		  	tile		  	The pixels to trace.
+ * @param 		  	stride		  	Spacing of the pixels traced.
+ * @param 		  	coarserStride 	Spacing of the pixels already traced; 0 if none are.
+ * @param 		  	depth		  	Number of reflections traced beyond the first hit.
+ * @param 		  	theScene	  	The scene.
+ * @param 		  	opaqueBVH	  	Hierarchy over the scene's opaque objects.
+ * @param 		  	sceneBVH	  	Hierarchy over all the scene's objects.
+ */
+
+void RayTracer::traceTileLevel(FrameBuffer &frameBuffer, const Tile &tile, int stride, int coarserStride, int depth,
+								const IScene &theScene, const BVH &opaqueBVH, const BVH &sceneBVH) const {
+	Ray rays[RayPacket::SIZE];
+	static thread_local LayeredHit hits[RayPacket::SIZE];
+	int xs[RayPacket::SIZE];
+	int ys[RayPacket::SIZE];
+	int numRays = 0;
+	auto traceRays = [&]() {
+		RenderStats::count(PRIMARY_RAYS, numRays);
+		if (usePackets) {
+			sceneBVH.findLayers(rays, numRays, hits);
+		} else {
+			for (int i = 0; i < numRays; i++) {
+				sceneBVH.findLayers(rays[i], hits[i]);
+			}
+		}
+		for (int i = 0; i < numRays; i++) {
+			if (useGBuffer) {
+				storeHits(xs[i], ys[i], hits[i]);
+			}
+			color C = shadePixel(frameBuffer, xs[i], ys[i], depth, theScene, opaqueBVH, sceneBVH,
+									rays[i], hits[i]);
+			for (int y = ys[i]; y < std::min(ys[i] + stride, tile.y1); ++y) {
+				for (int x = xs[i]; x < std::min(xs[i] + stride, tile.x1); ++x) {
+					frameBuffer.setColor(x, y, C);
 				}
-				hit.normal = n;
 			}
+		}
+		numRays = 0;
+	};
 
-
-			color transAndBackground = ((hit2.material.ambient * hit2.material.alpha) * defaultColor);
-			//color transAndBackground = (transColor * defaultColor);
-			color trans = hit2.material.ambient;
-			color C = (1 - hit.material.alpha) * totalColor + (hit2.material.alpha * trans);
-			// frameBuffer.setColor(x, y, totalColor);
-			if (hit.interceptPt == dvec3(0,0,0)) {
-				frameBuffer.setColor(x, y, defaultColor);
+	for (int y = tile.y0; y < tile.y1; y += stride) {
+		for (int x = tile.x0; x < tile.x1; x += stride) {
+			if (coarserStride > 0 && (x - tile.x0) % coarserStride == 0 && (y - tile.y0) % coarserStride == 0) {
+				continue;
+			}
+			rays[numRays] = rayGenerator.getRay(x, y);
+			xs[numRays] = x;
+			ys[numRays] = y;
+			if (++numRays == RayPacket::SIZE) {
+				traceRays();
 			}
-			else if (hit.material.alpha > 0.95) {
-				frameBuffer.setColor(x, y, totalColor);
+		}
+	}
+	if (numRays > 0) {
+		traceRays();
+	}
+}
+
+/**
+ * @fn	void RayTracer::traceTile(FrameBuffer &frameBuffer, const Tile &tile, int depth, const IScene &theScene, const BVH &opaqueBVH, const BVH &sceneBVH) const
+ * @brief	Traces every pixel of a tile. In packet mode the tile is covered with
+ * 			RayPacket::BLOCK_WIDTH x RayPacket::BLOCK_HEIGHT blocks whose primary rays
+ * 			are intersected together; shading is still done one pixel at a time.
+ * @param [in,out]	frameBuffer   	Framebuffer.
+ * @param 		  	tile		  	The pixels to trace.
+ * @param 		  	depth		  	Number of reflections traced beyond the first hit.
+ * @param 		  	theScene	  	The scene.
+ * @param 		  	opaqueBVH	  	Hierarchy over the scene's opaque objects.
+ * @param 		  	sceneBVH	  	Hierarchy over all the scene's objects.
+ */
+
+void RayTracer::traceTile(FrameBuffer &frameBuffer, const Tile &tile, int depth, const IScene &theScene,
+							const BVH &opaqueBVH, const BVH &sceneBVH) const {
+	if (!usePackets) {
+		for (int y = tile.y0; y < tile.y1; ++y) {
+			for (int x = tile.x0; x < tile.x1; ++x) {
+				tracePixel(frameBuffer, x, y, depth, theScene, opaqueBVH, sceneBVH);
 			}
-			else if (hit2.interceptPt != dvec3(0,0,0) && hit.interceptPt == dvec3(0,0,0)) {
-				frameBuffer.setColor(x, y, transAndBackground);
+		}
+		return;
+	}
+
+	Ray rays[RayPacket::SIZE];
+	static thread_local LayeredHit hits[RayPacket::SIZE];
+	int xs[RayPacket::SIZE];
+	int ys[RayPacket::SIZE];
+	for (int by = tile.y0; by < tile.y1; by += RayPacket::BLOCK_HEIGHT) {
+		for (int bx = tile.x0; bx < tile.x1; bx += RayPacket::BLOCK_WIDTH) {
+			Tile block = { bx, by, std::min(bx + RayPacket::BLOCK_WIDTH, tile.x1),
+							std::min(by + RayPacket::BLOCK_HEIGHT, tile.y1) };
+			int numRays = 0;
+			for (int y = block.y0; y < block.y1; ++y) {
+				for (int x = block.x0; x < block.x1; ++x) {
+					xs[numRays] = x;
+					ys[numRays] = y;
+					numRays++;
+				}
 			}
-			else if (hit2.interceptPt != dvec3(0, 0, 0) && hit.interceptPt != dvec3(0, 0, 0)) {
-				frameBuffer.setColor(x, y, C);
+			rayGenerator.getRays(block, rays);
+			RenderStats::count(PRIMARY_RAYS, numRays);
+			sceneBVH.findLayers(rays, numRays, hits);
+			for (int i = 0; i < numRays; i++) {
+				if (useGBuffer) {
+					storeHits(xs[i], ys[i], hits[i]);
+				}
+				shadePixel(frameBuffer, xs[i], ys[i], depth, theScene, opaqueBVH, sceneBVH,
+							rays[i], hits[i]);
 			}
-			//if no hit default color
-			//if solid hit only totalColor
-			//if both below
-			//if transparent hit only mix trans and background color
-			/*if (both are hit && hit1 > hit2) {
-				frameBuffer.setColor(x, y, C);
-			}*/
+		}
+	}
+}
 
-			/* Reflection pseudocode (I think it goes in here, not in traceIndividualRay)
-			Check the ray against every object to find closest intersection
-			If the ray hits an object
+/**
+ * @fn	void RayTracer::reshadeTile(FrameBuffer &frameBuffer, const Tile &tile, int depth, const IScene &theScene, const BVH &opaqueBVH, const BVH &sceneBVH) const
+ * @brief	Shades every pixel of a tile from the primary hits in the G-buffer. Only
+ * 			shadow feelers and reflected or transmitted rays are traced.
+ * @param [in,out]	frameBuffer   	Framebuffer.
+ * @param 		  	tile		  	The pixels to shade.
+ * @param 		  	depth		  	Number of reflections traced beyond the first hit.
+ * @param 		  	theScene	  	The scene.
+ * @param 		  	opaqueBVH	  	Hierarchy over the scene's opaque objects.
+ * @param 		  	sceneBVH	  	Hierarchy over all the scene's objects.
+ */
 
-				Initialize total illumination to emissive color of the object
-				For each light source do
+void RayTracer::reshadeTile(FrameBuffer &frameBuffer, const Tile &tile, int depth, const IScene &theScene,
+							const BVH &opaqueBVH, const BVH &sceneBVH) const {
+	HitRecord hit, hit2;
+	for (int y = tile.y0; y < tile.y1; ++y) {
+		for (int x = tile.x0; x < tile.x1; ++x) {
+			gBuffer.load(x, y, hit, hit2);
+			shadePixel(frameBuffer, x, y, depth, theScene, opaqueBVH, sceneBVH,
+						rayGenerator.getRay(x, y), LayeredHit(hit, hit2));
+		}
+	}
+}
+
+/**
+ * @fn	void RayTracer::tracePixel(FrameBuffer &frameBuffer, int x, int y, int depth, const IScene &theScene, const BVH &opaqueBVH, const BVH &sceneBVH) const
+ * @brief	Computes and stores the color of a single pixel. Only touches pixel (x, y),
+ * 			so different pixels can be traced concurrently.
+ * @param [in,out]	frameBuffer   	Framebuffer.
+ * @param 		  	x			  	The x coordinate of the pixel.
+ * @param 		  	y			  	The y coordinate of the pixel.
+ * @param 		  	depth		  	Number of reflections traced beyond the first hit.
+ * @param 		  	theScene	  	The scene.
+ * @param 		  	opaqueBVH	  	Hierarchy over the scene's opaque objects.
+ * @param 		  	sceneBVH	  	Hierarchy over all the scene's objects.
+ */
 
-					Use a shadow feeler to check if the light source is blocked
-					If the light source is not blocked
+void RayTracer::tracePixel(FrameBuffer &frameBuffer, int x, int y, int depth, const IScene &theScene,
+							const BVH &opaqueBVH, const BVH &sceneBVH) const {
+	Ray ray = rayGenerator.getRay(x, y);
+	RenderStats::count(PRIMARY_RAYS);
+	static thread_local LayeredHit hits;
+	sceneBVH.findLayers(ray, hits);
+	if (useGBuffer) {
+		storeHits(x, y, hits);
+	}
+	shadePixel(frameBuffer, x, y, depth, theScene, opaqueBVH, sceneBVH, ray, hits);
+}
+
+/**
+ * @fn	color RayTracer::shadePixel(FrameBuffer &frameBuffer, int x, int y, int depth, const IScene &theScene, const BVH &opaqueBVH, const BVH &sceneBVH, const Ray &ray, const LayeredHit &hits) const
+ * @brief	Computes and stores the color of a pixel whose primary ray has already been
+ * 			intersected with the scene.
+ * @param [in,out]	frameBuffer   	Framebuffer.
+ * @param 		  	x			  	The x coordinate of the pixel.
+ * @param 		  	y			  	The y coordinate of the pixel.
+ * @param 		  	depth		  	Number of reflections traced beyond the first hit.
+ * @param 		  	theScene	  	The scene.
+ * @param 		  	opaqueBVH	  	Hierarchy over the scene's opaque objects.
+ * @param 		  	sceneBVH	  	Hierarchy over all the scene's objects.
+ * @param 		  	ray			  	The pixel's primary ray.
+ * @param 		  	hits		  	What the primary ray hits.
+ * @return	The pixel's color.
+ */
 
-						Add illumination for the light source to total illumination
+color RayTracer::shadePixel(FrameBuffer &frameBuffer, int x, int y, int depth, const IScene &theScene,
+							const BVH &opaqueBVH, const BVH &sceneBVH,
+							const Ray &ray, const LayeredHit &hits) const {
+	DEBUG_PIXEL = (x == xDebug && y == yDebug);
+	if (DEBUG_PIXEL) {
+		cout << "";
+	}
+	color C = tracePath(ray, hits, depth, theScene, opaqueBVH, sceneBVH);
+	frameBuffer.setColor(x, y, C);
+	if (!firstSamples.empty()) {
+		const HitRecord &closest = hits.numLayers > 0 ? hits.layers[0] : hits.opaque;
+		PixelSample &sample = firstSamples[(size_t)y * frameBuffer.getWindowWidth() + x];
+		sample.C = C;
+		sample.surface = closest.t == FLT_MAX ? nullptr : closest.surface;
+		sample.t = closest.t;
+	}
+	return C;
+}
 
-				If the recursive base case has not been reached
+/**
+ * @fn	void RayTracer::refineTile(FrameBuffer &frameBuffer, const Tile &tile, int depth, const IScene &theScene, const BVH &opaqueBVH, const BVH &sceneBVH) const
+ * @brief	Supersamples the pixels of a tile that lie on an edge. An edge pixel is
+ * 			covered with a stratified grid of sqrt(maxSamples) x sqrt(maxSamples)
+ * 			samples, one at the center of each cell, and gets their average. With an
+ * 			odd grid the middle cell's sample is the pixel's first sample, so it is
+ * 			not traced again. Neighbours are read from firstSamples, never from the
+ * 			frame buffer, so tiles may be refined concurrently.
+ * @param [in,out]	frameBuffer   	Framebuffer, holding every pixel's first sample.
+ * @param 		  	tile		  	The pixels to refine.
+ * @param 		  	depth		  	Number of reflections traced beyond the first hit.
+ * @param 		  	theScene	  	The scene.
+ * @param 		  	opaqueBVH	  	Hierarchy over the scene's opaque objects.
+ * @param 		  	sceneBVH	  	Hierarchy over all the scene's objects.
+ */
 
-					Create a reflection ray
-					Recursively trace the reflection ray
-					Add the result of tracing the reflection ray to total illumination
-					Attenuate total illumination based on distance to closest intersection
-					Return total illumination
+void RayTracer::refineTile(FrameBuffer &frameBuffer, const Tile &tile, int depth, const IScene &theScene,
+							const BVH &opaqueBVH, const BVH &sceneBVH) const {
+	const RaytracingCamera &camera = *theScene.camera;
+	const int W = frameBuffer.getWindowWidth();
+	const int H = frameBuffer.getWindowHeight();
+	const int gridSize = (int)std::sqrt((double)maxSamples);
+	if (gridSize < 2) {
+		return;
+	}
+	static thread_local LayeredHit hits;
+	for (int y = tile.y0; y < tile.y1; ++y) {
+		for (int x = tile.x0; x < tile.x1; ++x) {
+			if (!isOnEdge(x, y, W, H)) {
+				continue;
+			}
+			color sum(0.0, 0.0, 0.0);
+			int numTraced = 0;
+			for (int j = 0; j < gridSize; j++) {
+				for (int i = 0; i < gridSize; i++) {
+					double dx = (i + 0.5) / gridSize - 0.5;
+					double dy = (j + 0.5) / gridSize - 0.5;
+					if (dx == 0.0 && dy == 0.0) {
+						sum += firstSamples[(size_t)y * W + x].C;
+						continue;
+					}
+					Ray ray = camera.getRay(x + dx, y + dy);
+					sceneBVH.findLayers(ray, hits);
+					sum += tracePath(ray, hits, depth, theScene, opaqueBVH, sceneBVH);
+					numTraced++;
+				}
+			}
+			frameBuffer.setColor(x, y, sum / (double)(gridSize * gridSize));
+			RenderStats::count(PIXELS_REFINED);
+			RenderStats::count(EXTRA_SAMPLES, numTraced);
+			RenderStats::count(PRIMARY_RAYS, numTraced);
+		}
+	}
+}
 
-			Else
+/**
+ * @fn	bool RayTracer::isOnEdge(int x, int y, int width, int height) const
+ * @brief	Determines if a pixel's first sample contrasts with that of one of its
+ * 			four neighbours: a different object, a depth differing by more than
+ * 			edgeDepthRatio of the nearer one, or a color component differing by more
+ * 			than edgeContrast.
+ * @param	x	  	The x coordinate of the pixel.
+ * @param	y	  	The y coordinate of the pixel.
+ * @param	width 	The window's width.
+ * @param	height	The window's height.
+ * @return	True iff the pixel should be supersampled.
+ */
 
-				return default color
-			*/
-			//frameBuffer.setColor(x, y, totalColor);
-			//frameBuffer.setColor(x, y, hit.material.diffuse);
-			// color c = illuminate(hit.interceptPt, hit.normal, hit.material, camera.cameraFrame, false);
-			// color c = lights[0]->illuminate(hit.interceptPt, hit.normal, hit.material, camera.cameraFrame, false);
-			// frameBuffer.showAxes(x, y, ray, 0.25);			// Displays R/x, G/y, B/z axes
-			// HitRecord hit = VisibleIShape::findIntersection(ray, theScene.opaqueObjs);
+bool RayTracer::isOnEdge(int x, int y, int width, int height) const {
+	static const int DX[] = { 1, -1, 0, 0 };
+	static const int DY[] = { 0, 0, 1, -1 };
+	const PixelSample &sample = firstSamples[(size_t)y * width + x];
+	for (int k = 0; k < 4; k++) {
+		int nx = x + DX[k];
+		int ny = y + DY[k];
+		if (nx < 0 || nx >= width || ny < 0 || ny >= height) {
+			continue;
+		}
+		const PixelSample &neighbour = firstSamples[(size_t)ny * width + nx];
+		if (neighbour.surface != sample.surface) {
+			return true;
+		}
+		if (sample.surface != nullptr &&
+			std::abs(sample.t - neighbour.t) > edgeDepthRatio * std::min(sample.t, neighbour.t)) {
+			return true;
+		}
+		color difference = glm::abs(sample.C - neighbour.C);
+		if (difference.r > edgeContrast || difference.g > edgeContrast || difference.b > edgeContrast) {
+			return true;
 		}
 	}
-	frameBuffer.showColorBuffer();
+	return false;
 }
 
+/**
+ * @fn	void RayTracer::storeHits(int x, int y, const LayeredHit &hits) const
+ * @brief	Saves a pixel's primary hits in the G-buffer: the opaque hit and the
+ * 			first transparent layer, which is all a reshade starts from.
+ * @param	x   	The x coordinate of the pixel.
+ * @param	y   	The y coordinate of the pixel.
+ * @param	hits	What the pixel's primary ray hits.
+ */
+
+void RayTracer::storeHits(int x, int y, const LayeredHit &hits) const {
+	gBuffer.store(x, y, hits.opaque, hits.numLayers > 0 ? hits.layers[0] : HitRecord());
+}
 
 /**
  * @fn	color RayTracer::traceIndividualRay(const Ray &ray, const IScene &theScene, int recursionLevel) const
@@ -172,15 +631,189 @@ void RayTracer::raytraceScene(FrameBuffer &frameBuffer, int depth,
  */
 
 color RayTracer::traceIndividualRay(const Ray &ray, const IScene &theScene, int recursionLevel) const {
-	/* CSE 386 - todo  */
-	HitRecord theHit = VisibleIShape::findIntersection(ray, theScene.opaqueObjs);
-	color result = defaultColor;
+	const BVH &opaqueBVH = theScene.getOpaqueBVH();
+	const BVH &sceneBVH = theScene.getSceneBVH();
+	LayeredHit hits;
+	sceneBVH.findLayers(ray, hits);
+	return tracePath(ray, hits, recursionLevel, theScene, opaqueBVH, sceneBVH);
+}
 
-	if (theHit.t < FLT_MAX) {
-		color totalColor = theHit.material.ambient;
-		result = defaultColor;
-	}
+/**
+ * @fn	color RayTracer::tracePath(const Ray &ray, const LayeredHit &hits, int depth, const IScene &theScene, const BVH &opaqueBVH, const BVH &sceneBVH) const
+ * @brief	Traces a ray and the reflected and transmitted rays it spawns. Instead of
+ * 			recursing, the rays still to be traced wait on a stack, each with the
+ * 			weight its color contributes to the result. A hit adds its local color
+ * 			times its coverage (alpha), spawns a reflected ray weighted by the
+ * 			material's specular color while reflections are left, and, if it is
+ * 			transparent, a ray straight through weighted by 1 - alpha. Rays whose
+ * 			weight is below minPathWeight are dropped, and no more than rayBudget
+ * 			rays are traced in total, the first one included. A budget below one
+ * 			allows just the first ray.
+ *
+ * 			A ray straight through a transparent hit continues along the same line,
+ * 			so its hits are taken from the layers already found for the ray that
+ * 			spawned it; it is only traced again once those run out.
+ * @param	ray			The first ray.
+ * @param	hits		What the first ray hits.
+ * @param	depth		Number of reflections traced beyond the first hit.
+ * @param	theScene	The scene.
+ * @param	opaqueBVH	Hierarchy over the scene's opaque objects.
+ * @param	sceneBVH	Hierarchy over all the scene's objects.
+ * @return	The color seen along the ray.
+ */
 
+color RayTracer::tracePath(const Ray &ray, const LayeredHit &hits, int depth,
+							const IScene &theScene, const BVH &opaqueBVH, const BVH &sceneBVH) const {
+	static thread_local vector<PathSegment> stack;
+	static thread_local LayeredHit tracedHits;
+	stack.clear();
+
+	color result(0.0, 0.0, 0.0);
+	int raysLeft = std::max(rayBudget, 1) - 1;	// the first ray is already traced
+	PathSegment segment = { ray, color(1.0, 1.0, 1.0), depth, 0 };
+	const LayeredHit *current = &hits;
+	while (true) {
+		// segment.layer indexes current's layers; past them lies the opaque hit
+		bool hitsTransparent = segment.layer < current->numLayers;
+		const HitRecord &closest = hitsTransparent ? current->layers[segment.layer] : current->opaque;
+		if (closest.t == FLT_MAX) {
+			result += segment.weight * defaultColor;
+		} else {
+			double coverage = hitsTransparent ? closest.material.alpha : 1.0;
+			dvec3 n = closest.normal;
+			if (glm::dot(n, segment.ray.dir) > 0) {
+				n = -n;
+			}
+			result += (segment.weight * coverage) * shadeSurface(closest, n, segment.ray, theScene, opaqueBVH);
+
+			color reflected = (segment.weight * coverage) * closest.material.specular;
+			if (segment.reflectionsLeft > 0 && isSignificant(reflected)) {
+				dvec3 dir = segment.ray.dir - 2.0 * glm::dot(segment.ray.dir, n) * n;
+				Ray reflection(closest.interceptPt + EPSILON * n, dir);
+				stack.push_back({ reflection, reflected, segment.reflectionsLeft - 1, NEEDS_TRACING });
+			}
+			// Pushed last, so it is popped next, while current still describes its line.
+			color transmitted = segment.weight * (1.0 - coverage);
+			if (hitsTransparent && isSignificant(transmitted)) {
+				Ray transmission(closest.interceptPt + EPSILON * segment.ray.dir, segment.ray.dir);
+				stack.push_back({ transmission, transmitted, segment.reflectionsLeft, segment.layer + 1 });
+			}
+		}
+
+		if (stack.empty() || raysLeft == 0) {
+			break;
+		}
+		segment = stack.back();
+		stack.pop_back();
+		raysLeft--;
+		RenderStats::count(SECONDARY_RAYS);
+		if (segment.layer == NEEDS_TRACING ||
+			(segment.layer >= current->numLayers && !current->opaqueIsKnown())) {
+			sceneBVH.findLayers(segment.ray, tracedHits);
+			current = &tracedHits;
+			segment.layer = 0;
+		}
+	}
 	return result;
 }
 
+/**
+ * @fn	bool RayTracer::isSignificant(const color &weight) const
+ * @brief	Determines if a ray with the given weight is worth tracing.
+ * @param	weight	The weight of the ray's color in the pixel.
+ * @return	True iff some component of weight is at least minPathWeight.
+ */
+
+bool RayTracer::isSignificant(const color &weight) const {
+	return weight.r >= minPathWeight || weight.g >= minPathWeight || weight.b >= minPathWeight;
+}
+
+/**
+ * @fn	color RayTracer::shadeSurface(const HitRecord &hit, const dvec3 &n, const Ray &ray, const IScene &theScene, const BVH &opaqueBVH) const
+ * @brief	Computes the local color of a hit: its texture plus the light from every
+ * 			light source that is on and not blocked by an opaque object. A light
+ * 			whose influence volume does not contain the hit adds only its ambient
+ * 			color, without a shadow feeler.
+ * @param	hit		 	The hit.
+ * @param	n		 	The hit's normal, facing back along the ray.
+ * @param	ray		 	The ray that found the hit.
+ * @param	theScene 	The scene.
+ * @param	opaqueBVH	Hierarchy over the scene's opaque objects, for shadow feelers.
+ * @return	The color of the hit.
+ */
+
+color RayTracer::shadeSurface(const HitRecord &hit, const dvec3 &n, const Ray &ray,
+								const IScene &theScene, const BVH &opaqueBVH) const {
+	// Lights see the surface from wherever the ray started, which is the camera
+	// only for primary rays.
+	Frame eyeFrame = theScene.camera->cameraFrame;
+	eyeFrame.origin = ray.origin;
+
+	color totalColor(0.0, 0.0, 0.0);
+	if (hit.texture != nullptr) {
+		totalColor += hit.texture->getPixelUV(hit.u, hit.v);
+	}
+	dvec3 feelerOrigin = hit.interceptPt + EPSILON * n;
+	for (unsigned i = 0; i < theScene.lights.size(); i++) {
+		const PositionalLightPtr light = theScene.lights[i];
+		if (!light->isOn) {
+			continue;				// contributes black, so needs no shadow feeler
+		}
+		if (i < lightInfluences.size() && !lightInfluences[i].contains(hit.interceptPt)) {
+			RenderStats::count(LIGHTS_CULLED);
+			totalColor += ambientColor(hit.material.ambient, light->lightColor.ambient);
+			continue;
+		}
+		// ask only whether anything lies between the feeler's origin and the light
+		Ray shadowFeeler(feelerOrigin, light->pos - feelerOrigin, 0.0, glm::distance(light->pos, feelerOrigin));
+		bool inShadow = isOccluded(shadowFeeler, i, theScene, opaqueBVH);
+		totalColor += light->illuminate(hit.interceptPt, n, hit.material, eyeFrame, inShadow);
+	}
+	return totalColor;
+}
+
+/**
+ * @fn	bool RayTracer::isOccluded(const Ray &shadowFeeler, int lightIndex, const IScene &theScene, const BVH &opaqueBVH) const
+ * @brief	Determines if a shadow feeler is blocked by an opaque object. With
+ * 			useShadowCache set, the object that last blocked a feeler toward the same
+ * 			light on this thread is tried first, since neighbouring pixels are
+ * 			usually shadowed by the same object. The answer does not depend on the
+ * 			cache.
+ * @param	shadowFeeler	The shadow feeler, whose tMax is the distance to the light.
+ * @param	lightIndex  	Index of the light in theScene.lights.
+ * @param	theScene		The scene.
+ * @param	opaqueBVH   	Hierarchy over the scene's opaque objects.
+ * @return	True iff some opaque object is hit within the feeler's interval.
+ */
+
+bool RayTracer::isOccluded(const Ray &shadowFeeler, int lightIndex,
+							const IScene &theScene, const BVH &opaqueBVH) const {
+	RenderStats::count(SHADOW_RAYS);
+	if (!useShadowCache) {
+		return opaqueBVH.occluded(shadowFeeler);
+	}
+
+	// The cache is thrown away whenever this thread moves on to another scene or
+	// the scene's objects change; no two scenes share a geometry version, so it
+	// only ever holds objects of theScene.
+	static thread_local ShadowCache cache;
+	if (cache.geometryVersion != theScene.getGeometryVersion()) {
+		cache.geometryVersion = theScene.getGeometryVersion();
+		cache.lastOccluders.clear();
+	}
+	if (cache.lastOccluders.size() < theScene.lights.size()) {
+		cache.lastOccluders.resize(theScene.lights.size(), nullptr);
+	}
+
+	const VisibleIShape *&lastOccluder = cache.lastOccluders[lightIndex];
+	if (lastOccluder != nullptr && lastOccluder->occluded(shadowFeeler)) {
+		RenderStats::count(SHADOW_CACHE_HITS);
+		return true;
+	}
+	RenderStats::count(SHADOW_CACHE_MISSES);
+	const VisibleIShape *occluder = opaqueBVH.findOccluder(shadowFeeler);
+	if (occluder != nullptr) {
+		lastOccluder = occluder;
+	}
+	return occluder != nullptr;
+}
@@ -13,6 +13,9 @@
 #include "FrameBuffer.h"
 #include "Camera.h"
 #include "IScene.h"
+#include "TileScheduler.h"
+#include "GBuffer.h"
+#include "RayGenerator.h"
 
 /**
  * @struct	RayTracer
@@ -20,10 +23,116 @@
  */
 
 struct RayTracer {
+	static const int DEFAULT_TILE_SIZE = 16;
+	static const int DEFAULT_RAY_BUDGET = 16;
+	static constexpr double DEFAULT_MIN_PATH_WEIGHT = 0.02;
+	static constexpr double DEFAULT_MIN_LIGHT_CONTRIBUTION = 1.0 / 512.0;
+	static const int DEFAULT_MAX_SAMPLES = 1;
+	static constexpr double DEFAULT_EDGE_CONTRAST = 0.1;
+	static constexpr double DEFAULT_EDGE_DEPTH_RATIO = 0.1;
+	static const int MAX_STRIDE = 8;
 	color defaultColor;
+	int tileSize;					//!< Width and height of the tiles handed to each thread.
+	bool usePackets;				//!< Trace primary rays in SIMD packets of RayPacket::SIZE rays.
+	bool useGBuffer;				//!< Reuse the last frame's primary hits while the view is unchanged.
+	bool useShadowCache;			//!< Test each light's last occluder before the full shadow query.
+	bool useLightInfluence;			//!< Skip lights whose influence volume does not reach the hit.
+	bool useOriginTerms;			//!< Precompute each object's camera-origin terms once per frame.
+	int rayBudget;					//!< Most rays traced for one pixel, not counting shadow feelers; at least 1.
+	double minPathWeight;			//!< Reflected and transmitted rays weighing less are not traced.
+	double minLightContribution;	//!< Attenuated light below this bounds each light's influence.
+	int maxSamples;					//!< Most samples per pixel on an edge; 1 turns antialiasing off.
+	double edgeContrast;			//!< Color difference from a neighbour that puts a pixel on an edge.
+	double edgeDepthRatio;			//!< Relative depth difference from a neighbour that does the same.
+	double frameBudgetMs;			//!< If positive, a changing view is traced at reduced resolution to stay
+									//!< within this time, and refined over later frames while it holds still.
 	RayTracer(const color &defaultColor);
 	void raytraceScene(FrameBuffer &frameBuffer, int depth,
 						const IScene &theScene) const;
+	void setNumThreads(int numThreads);
+	int getNumThreads() const;
+	bool isRefining() const;
+	void restartRefinement();
 protected:
+	static const int NEEDS_TRACING = -1;
+	/**
+	 * @struct	PathSegment
+	 * @brief	A ray waiting to be traced, and the weight of its color in the pixel.
+	 * 			A ray continuing through a transparent hit knows which of the layers
+	 * 			already found it reaches next; any other ray has NEEDS_TRACING.
+	 */
+	struct PathSegment {
+		Ray ray;
+		color weight;
+		int reflectionsLeft;
+		int layer;
+	};
+	/**
+	 * @struct	PixelSample
+	 * @brief	What a pixel's first sample saw, kept for finding edges when antialiasing.
+	 */
+	struct PixelSample {
+		color C;						//!< the pixel's color from its first sample
+		const VisibleIShape *surface;	//!< the closest object hit; null if nothing was hit
+		double t;						//!< the t value of that hit
+	};
+	/**
+	 * @struct	Refinement
+	 * @brief	How far progressive tracing of the current view has got. The view is
+	 * 			traced in levels, each with half the pixel spacing of the one before,
+	 * 			and then antialiased; a level's tiles may be spread over several frames.
+	 */
+	struct Refinement {
+		FrameView view;
+		vector<dvec4> lights;			//!< position, on/off state, attenuation, spot cone and colors of each light
+		int firstStride = 0;			//!< pixel spacing of the first level
+		int stride = 0;					//!< pixel spacing of the current level; 0 once every pixel is traced
+		bool antialiased = false;
+		vector<Tile> tiles;
+		vector<char> tileDone;			//!< which tiles of the current level are finished
+		double tracingMs = 0.0;			//!< time spent tracing the view's pixels so far
+		long long pixelsTraced = 0;		//!< pixels of the view traced so far
+		double msPerPixel = 0.0;		//!< cost of a pixel of the previous view, for choosing firstStride
+	};
+	/**
+	 * @struct	ShadowCache
+	 * @brief	For one thread, the object that last blocked a shadow feeler toward
+	 * 			each light of a scene.
+	 */
+	struct ShadowCache {
+		unsigned geometryVersion = 0;	//!< of the scene the occluders belong to; 0 for none
+		vector<const VisibleIShape *> lastOccluders;
+	};
+	void reshadeTile(FrameBuffer &frameBuffer, const Tile &tile, int depth, const IScene &theScene,
+					const BVH &opaqueBVH, const BVH &sceneBVH) const;
+	void traceTile(FrameBuffer &frameBuffer, const Tile &tile, int depth, const IScene &theScene,
+					const BVH &opaqueBVH, const BVH &sceneBVH) const;
+	void traceProgressively(FrameBuffer &frameBuffer, int depth, const IScene &theScene,
+					const BVH &opaqueBVH, const BVH &sceneBVH) const;
+	void traceTileLevel(FrameBuffer &frameBuffer, const Tile &tile, int stride, int coarserStride, int depth,
+					const IScene &theScene, const BVH &opaqueBVH, const BVH &sceneBVH) const;
+	void forEachTile(const vector<Tile> &tiles, const std::function<void(const Tile &)> &work) const;
+	void tracePixel(FrameBuffer &frameBuffer, int x, int y, int depth, const IScene &theScene,
+					const BVH &opaqueBVH, const BVH &sceneBVH) const;
+	color shadePixel(FrameBuffer &frameBuffer, int x, int y, int depth, const IScene &theScene,
+					const BVH &opaqueBVH, const BVH &sceneBVH,
+					const Ray &ray, const LayeredHit &hits) const;
+	void refineTile(FrameBuffer &frameBuffer, const Tile &tile, int depth, const IScene &theScene,
+					const BVH &opaqueBVH, const BVH &sceneBVH) const;
+	bool isOnEdge(int x, int y, int width, int height) const;
+	void storeHits(int x, int y, const LayeredHit &hits) const;
 	color traceIndividualRay(const Ray &ray, const IScene &theScene, int recursionLevel) const;
+	color tracePath(const Ray &ray, const LayeredHit &hits, int depth,
+					const IScene &theScene, const BVH &opaqueBVH, const BVH &sceneBVH) const;
+	color shadeSurface(const HitRecord &hit, const dvec3 &n, const Ray &ray,
+					const IScene &theScene, const BVH &opaqueBVH) const;
+	bool isOccluded(const Ray &shadowFeeler, int lightIndex,
+					const IScene &theScene, const BVH &opaqueBVH) const;
+	bool isSignificant(const color &weight) const;
+	std::shared_ptr<TileScheduler> scheduler;	//!< Null when tracing serially.
+	mutable GBuffer gBuffer;					//!< Primary hits of the last frame traced with useGBuffer.
+	mutable vector<LightInfluence> lightInfluences;	//!< Influence volume of each light, found once per frame.
+	mutable RayGenerator rayGenerator;			//!< The camera's primary rays for the frame being traced.
+	mutable vector<PixelSample> firstSamples;	//!< First sample of every pixel, while antialiasing.
+	mutable Refinement refinement;				//!< Progress of the view traced with frameBudgetMs.
 };
\ No newline at end of file
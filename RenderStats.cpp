@@ -0,0 +1,192 @@
+/****************************************************
+ * 2016-2020 Eric Bachmann and Mike Zmuda
+ * All Rights Reserved.
+ * NOTICE:
+ * Dissemination of this information or reproduction
+ * of this material is prohibited unless prior written
+ * permission is granted..
+ ****************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include "RenderStats.h"
+
+bool RenderStats::logFrames = false;
+
+/**
+ * The bookkeeping shared by all threads. Every thread that has counted something
+ * has its counters listed in threads; when a thread exits, whatever it counted
+ * since the last endFrame is moved to retired so it still lands in the frame.
+ */
+
+static std::mutex statsMutex;
+static vector<long long *> threads;
+static long long retired[NUM_RENDER_COUNTERS];
+static int frameDepth = 0;
+static int framesFinished = 0;
+static std::chrono::steady_clock::time_point frameStart;
+static RenderStats finishedFrame;
+
+static const char *COUNTER_NAMES[NUM_RENDER_COUNTERS] = {
+	"primary rays", "secondary rays", "shadow rays", "shadow cache hits", "shadow cache misses",
+	"lights culled", "ray hits", "pixels refined", "extra samples",
+	"sphere tests", "ellipsoid tests", "cylinder tests", "plane tests", "disk tests",
+	"triangle tests", "other shape tests",
+	"triangles submitted", "triangles clipped", "triangles culled",
+	"fragments generated", "fragments depth rejected", "fragments shaded"
+};
+
+/**
+ * @fn	RenderStats::RenderStats()
+ * @brief	Constructs a record with every count zero.
+ */
+
+RenderStats::RenderStats() : frameTimeMs(0.0), frameNumber(0) {
+	std::fill(counts, counts + NUM_RENDER_COUNTERS, 0);
+}
+
+/**
+ * @fn	long long RenderStats::shapeTests() const
+ * @brief	Total number of ray/shape intersection tests, of every type.
+ * @return	The sum of the shape test counters.
+ */
+
+long long RenderStats::shapeTests() const {
+	long long total = 0;
+	for (int c = SPHERE_TESTS; c <= OTHER_SHAPE_TESTS; c++) {
+		total += counts[c];
+	}
+	return total;
+}
+
+/**
+ * @fn	const char *RenderStats::counterName(RenderCounter counter)
+ * @brief	A readable name for a counter.
+ * @param	counter	The counter.
+ * @return	The name, such as "shadow rays".
+ */
+
+const char *RenderStats::counterName(RenderCounter counter) {
+	return COUNTER_NAMES[counter];
+}
+
+/**
+ * @fn	RenderStats::ThreadCounters::ThreadCounters()
+ * @brief	Zeroes a thread's counters and adds them to the list endFrame reads.
+ */
+
+RenderStats::ThreadCounters::ThreadCounters() {
+	std::fill(counts, counts + NUM_RENDER_COUNTERS, 0);
+	std::lock_guard<std::mutex> lock(statsMutex);
+	threads.push_back(counts);
+}
+
+/**
+ * @fn	RenderStats::ThreadCounters::~ThreadCounters()
+ * @brief	Moves an exiting thread's counts to the retired totals and takes its
+ * 			counters off the list.
+ */
+
+RenderStats::ThreadCounters::~ThreadCounters() {
+	std::lock_guard<std::mutex> lock(statsMutex);
+	for (int c = 0; c < NUM_RENDER_COUNTERS; c++) {
+		retired[c] += counts[c];
+	}
+	threads.erase(std::find(threads.begin(), threads.end(), counts));
+}
+
+/**
+ * @fn	void RenderStats::beginFrame()
+ * @brief	Starts a frame: clears every counter and starts the frame timer. Does
+ * 			nothing if a frame is already in progress.
+ */
+
+void RenderStats::beginFrame() {
+	threadCounters();
+	std::lock_guard<std::mutex> lock(statsMutex);
+	if (frameDepth++ > 0) {
+		return;
+	}
+	for (long long *counts : threads) {
+		std::fill(counts, counts + NUM_RENDER_COUNTERS, 0);
+	}
+	std::fill(retired, retired + NUM_RENDER_COUNTERS, 0);
+	frameStart = std::chrono::steady_clock::now();
+}
+
+/**
+ * @fn	RenderStats RenderStats::endFrame()
+ * @brief	Finishes a frame: adds up the counters of every thread, remembers the
+ * 			result for lastFrame and, if logFrames is set, prints it. An endFrame
+ * 			that closes a nested beginFrame only returns the counts so far.
+ * @return	The frame's statistics.
+ */
+
+RenderStats RenderStats::endFrame() {
+	auto now = std::chrono::steady_clock::now();
+	RenderStats stats;
+	{
+		std::lock_guard<std::mutex> lock(statsMutex);
+		for (int c = 0; c < NUM_RENDER_COUNTERS; c++) {
+			stats.counts[c] = retired[c];
+			for (const long long *counts : threads) {
+				stats.counts[c] += counts[c];
+			}
+		}
+		stats.frameTimeMs = std::chrono::duration<double, std::milli>(now - frameStart).count();
+		stats.frameNumber = framesFinished;
+		if (frameDepth == 0 || --frameDepth > 0) {
+			return stats;
+		}
+		finishedFrame = stats;
+		framesFinished++;
+	}
+	if (logFrames) {
+		cout << stats << endl;
+	}
+	return stats;
+}
+
+/**
+ * @fn	RenderStats RenderStats::lastFrame()
+ * @brief	The statistics of the most recently finished frame.
+ * @return	The statistics; all zero if no frame has finished yet.
+ */
+
+RenderStats RenderStats::lastFrame() {
+	std::lock_guard<std::mutex> lock(statsMutex);
+	return finishedFrame;
+}
+
+/**
+ * @fn	ostream &operator << (ostream &os, const RenderStats &stats)
+ * @brief	Writes the statistics as a single log line.
+ * @param [in,out]	os   	The output stream.
+ * @param 		  	stats	The statistics.
+ * @return	The output stream.
+ */
+
+ostream &operator << (ostream &os, const RenderStats &stats) {
+	os << "Frame " << stats.frameNumber << ": " << stats.frameTimeMs << " ms";
+	os << " | rays: " << stats.counts[PRIMARY_RAYS] << " primary, "
+		<< stats.counts[SECONDARY_RAYS] << " secondary, " << stats.counts[SHADOW_RAYS] << " shadow, "
+		<< stats.counts[RAY_HITS] << " hits";
+	os << " | shadow cache: " << stats.counts[SHADOW_CACHE_HITS] << " hits, "
+		<< stats.counts[SHADOW_CACHE_MISSES] << " misses";
+	os << " | lights culled: " << stats.counts[LIGHTS_CULLED];
+	os << " | antialiasing: " << stats.counts[PIXELS_REFINED] << " pixels refined, "
+		<< stats.counts[EXTRA_SAMPLES] << " extra samples";
+	os << " | shape tests: " << stats.shapeTests();
+	for (int c = SPHERE_TESTS; c <= OTHER_SHAPE_TESTS; c++) {
+		if (stats.counts[c] != 0) {
+			os << ", " << stats.counts[c] << ' ' << COUNTER_NAMES[c];
+		}
+	}
+	os << " | triangles: " << stats.counts[TRIANGLES_SUBMITTED] << " submitted, "
+		<< stats.counts[TRIANGLES_CLIPPED] << " clipped, " << stats.counts[TRIANGLES_CULLED] << " culled";
+	os << " | fragments: " << stats.counts[FRAGMENTS_GENERATED] << " generated, "
+		<< stats.counts[FRAGMENTS_DEPTH_REJECTED] << " depth rejected, "
+		<< stats.counts[FRAGMENTS_SHADED] << " shaded";
+	return os;
+}
@@ -0,0 +1,87 @@
+/****************************************************
+ * 2016-2020 Eric Bachmann and Mike Zmuda
+ * All Rights Reserved.
+ * NOTICE:
+ * Dissemination of this information or reproduction
+ * of this material is prohibited unless prior written
+ * permission is granted..
+ ****************************************************/
+
+#pragma once
+#include "Defs.h"
+
+/**
+ * @enum	RenderCounter
+ * @brief	The events counted while rendering. The shape test counters are in the
+ * 			same order as CompiledShapeType.
+ */
+
+enum RenderCounter {
+	PRIMARY_RAYS, SECONDARY_RAYS, SHADOW_RAYS, SHADOW_CACHE_HITS, SHADOW_CACHE_MISSES, LIGHTS_CULLED, RAY_HITS,
+	PIXELS_REFINED, EXTRA_SAMPLES,
+	SPHERE_TESTS, ELLIPSOID_TESTS, CYLINDER_TESTS, PLANE_TESTS, DISK_TESTS,
+	TRIANGLE_TESTS, OTHER_SHAPE_TESTS,
+	TRIANGLES_SUBMITTED, TRIANGLES_CLIPPED, TRIANGLES_CULLED,
+	FRAGMENTS_GENERATED, FRAGMENTS_DEPTH_REJECTED, FRAGMENTS_SHADED,
+	NUM_RENDER_COUNTERS
+};
+
+/**
+ * @struct	RenderStats
+ * @brief	Counts of what happened while rendering one frame, and how long it took.
+ * 			Counting goes to a block of counters owned by the calling thread, so it
+ * 			costs one increment and takes no lock. endFrame adds up every thread's
+ * 			block, which must only happen while no other thread is rendering, for
+ * 			example after RayTracer::raytraceScene has returned.
+ *
+ * 			Frames may nest: only the outermost beginFrame/endFrame pair starts and
+ * 			finishes a frame. RayTracer::raytraceScene brackets itself, so an
+ * 			application that also rasterizes can bracket its whole render instead.
+ */
+
+struct RenderStats {
+	long long counts[NUM_RENDER_COUNTERS];	//!< Events counted during the frame.
+	double frameTimeMs;						//!< Time from beginFrame to endFrame.
+	int frameNumber;						//!< Frames finished before this one.
+	static bool logFrames;					//!< If true, endFrame prints a line for each frame.
+
+	RenderStats();
+	long long get(RenderCounter counter) const { return counts[counter]; }
+	long long shapeTests() const;
+	static const char *counterName(RenderCounter counter);
+
+	static void count(RenderCounter counter, long long n = 1);
+	static void beginFrame();
+	static RenderStats endFrame();
+	static RenderStats lastFrame();
+	friend ostream &operator << (ostream &os, const RenderStats &stats);
+protected:
+	struct ThreadCounters {
+		long long counts[NUM_RENDER_COUNTERS];
+		ThreadCounters();
+		~ThreadCounters();
+	};
+	static ThreadCounters &threadCounters();
+};
+
+/**
+ * @fn	inline void RenderStats::count(RenderCounter counter, long long n)
+ * @brief	Adds to one of the calling thread's counters.
+ * @param	counter	The counter.
+ * @param	n	   	The amount to add.
+ */
+
+inline void RenderStats::count(RenderCounter counter, long long n) {
+	threadCounters().counts[counter] += n;
+}
+
+/**
+ * @fn	inline RenderStats::ThreadCounters &RenderStats::threadCounters()
+ * @brief	Gets the calling thread's counters, registering them on first use.
+ * @return	The counters.
+ */
+
+inline RenderStats::ThreadCounters &RenderStats::threadCounters() {
+	static thread_local ThreadCounters counters;
+	return counters;
+}
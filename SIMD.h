@@ -0,0 +1,136 @@
+/****************************************************
+ * 2016-2020 Eric Bachmann and Mike Zmuda
+ * All Rights Reserved.
+ * NOTICE:
+ * Dissemination of this information or reproduction
+ * of this material is prohibited unless prior written
+ * permission is granted..
+ ****************************************************/
+
+#pragma once
+
+/**
+ * Thin wrappers over the widest double precision vector unit the compiler is
+ * targeting: AVX-512 (8 lanes), AVX/AVX2 (4 lanes), SSE2 (2 lanes), or plain
+ * scalar code (1 lane). Code written against vdouble/vmask compiles for all of
+ * them; SIMD_WIDTH tells it how many lanes each operation covers. The lanes of
+ * a vmask can be turned into the low SIMD_WIDTH bits of an unsigned with vbits.
+ */
+
+#if defined(__AVX512F__)
+
+#include <immintrin.h>
+#define SIMD_WIDTH 8
+#define SIMD_NAME "AVX-512"
+typedef __m512d vdouble;
+typedef __mmask8 vmask;
+inline vdouble vset1(double a) { return _mm512_set1_pd(a); }
+inline vdouble vload(const double *p) { return _mm512_load_pd(p); }
+inline void vstore(double *p, vdouble a) { _mm512_store_pd(p, a); }
+inline vdouble vadd(vdouble a, vdouble b) { return _mm512_add_pd(a, b); }
+inline vdouble vsub(vdouble a, vdouble b) { return _mm512_sub_pd(a, b); }
+inline vdouble vmul(vdouble a, vdouble b) { return _mm512_mul_pd(a, b); }
+inline vdouble vdiv(vdouble a, vdouble b) { return _mm512_div_pd(a, b); }
+inline vdouble vsqrt(vdouble a) { return _mm512_sqrt_pd(a); }
+inline vdouble vmin(vdouble a, vdouble b) { return _mm512_min_pd(a, b); }
+inline vdouble vmax(vdouble a, vdouble b) { return _mm512_max_pd(a, b); }
+inline vmask vlt(vdouble a, vdouble b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+inline vmask vle(vdouble a, vdouble b) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+inline vmask vgt(vdouble a, vdouble b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+inline vmask vge(vdouble a, vdouble b) { return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ); }
+inline vmask vand(vmask a, vmask b) { return (vmask)(a & b); }
+inline vmask vor(vmask a, vmask b) { return (vmask)(a | b); }
+inline vdouble vselect(vmask m, vdouble a, vdouble b) { return _mm512_mask_blend_pd(m, b, a); }
+inline unsigned vbits(vmask m) { return (unsigned)m; }
+inline vmask vmaskFromBits(unsigned bits) { return (vmask)bits; }
+
+#elif defined(__AVX2__) || defined(__AVX__)
+
+#include <immintrin.h>
+#define SIMD_WIDTH 4
+#define SIMD_NAME "AVX2"
+typedef __m256d vdouble;
+typedef __m256d vmask;
+inline vdouble vset1(double a) { return _mm256_set1_pd(a); }
+inline vdouble vload(const double *p) { return _mm256_load_pd(p); }
+inline void vstore(double *p, vdouble a) { _mm256_store_pd(p, a); }
+inline vdouble vadd(vdouble a, vdouble b) { return _mm256_add_pd(a, b); }
+inline vdouble vsub(vdouble a, vdouble b) { return _mm256_sub_pd(a, b); }
+inline vdouble vmul(vdouble a, vdouble b) { return _mm256_mul_pd(a, b); }
+inline vdouble vdiv(vdouble a, vdouble b) { return _mm256_div_pd(a, b); }
+inline vdouble vsqrt(vdouble a) { return _mm256_sqrt_pd(a); }
+inline vdouble vmin(vdouble a, vdouble b) { return _mm256_min_pd(a, b); }
+inline vdouble vmax(vdouble a, vdouble b) { return _mm256_max_pd(a, b); }
+inline vmask vlt(vdouble a, vdouble b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+inline vmask vle(vdouble a, vdouble b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+inline vmask vgt(vdouble a, vdouble b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+inline vmask vge(vdouble a, vdouble b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+inline vmask vand(vmask a, vmask b) { return _mm256_and_pd(a, b); }
+inline vmask vor(vmask a, vmask b) { return _mm256_or_pd(a, b); }
+inline vdouble vselect(vmask m, vdouble a, vdouble b) { return _mm256_blendv_pd(b, a, m); }
+inline unsigned vbits(vmask m) { return (unsigned)_mm256_movemask_pd(m); }
+inline vmask vmaskFromBits(unsigned bits) {
+	return _mm256_castsi256_pd(_mm256_set_epi64x(-(long long)((bits >> 3) & 1), -(long long)((bits >> 2) & 1),
+												-(long long)((bits >> 1) & 1), -(long long)(bits & 1)));
+}
+
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+#define SIMD_WIDTH 2
+#define SIMD_NAME "SSE2"
+typedef __m128d vdouble;
+typedef __m128d vmask;
+inline vdouble vset1(double a) { return _mm_set1_pd(a); }
+inline vdouble vload(const double *p) { return _mm_load_pd(p); }
+inline void vstore(double *p, vdouble a) { _mm_store_pd(p, a); }
+inline vdouble vadd(vdouble a, vdouble b) { return _mm_add_pd(a, b); }
+inline vdouble vsub(vdouble a, vdouble b) { return _mm_sub_pd(a, b); }
+inline vdouble vmul(vdouble a, vdouble b) { return _mm_mul_pd(a, b); }
+inline vdouble vdiv(vdouble a, vdouble b) { return _mm_div_pd(a, b); }
+inline vdouble vsqrt(vdouble a) { return _mm_sqrt_pd(a); }
+inline vdouble vmin(vdouble a, vdouble b) { return _mm_min_pd(a, b); }
+inline vdouble vmax(vdouble a, vdouble b) { return _mm_max_pd(a, b); }
+inline vmask vlt(vdouble a, vdouble b) { return _mm_cmplt_pd(a, b); }
+inline vmask vle(vdouble a, vdouble b) { return _mm_cmple_pd(a, b); }
+inline vmask vgt(vdouble a, vdouble b) { return _mm_cmpgt_pd(a, b); }
+inline vmask vge(vdouble a, vdouble b) { return _mm_cmpge_pd(a, b); }
+inline vmask vand(vmask a, vmask b) { return _mm_and_pd(a, b); }
+inline vmask vor(vmask a, vmask b) { return _mm_or_pd(a, b); }
+inline vdouble vselect(vmask m, vdouble a, vdouble b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+inline unsigned vbits(vmask m) { return (unsigned)_mm_movemask_pd(m); }
+inline vmask vmaskFromBits(unsigned bits) {
+	return _mm_castsi128_pd(_mm_set_epi64x(-(long long)((bits >> 1) & 1), -(long long)(bits & 1)));
+}
+
+#else
+
+#include <algorithm>
+#include <cmath>
+#define SIMD_WIDTH 1
+#define SIMD_NAME "scalar"
+typedef double vdouble;
+typedef bool vmask;
+inline vdouble vset1(double a) { return a; }
+inline vdouble vload(const double *p) { return *p; }
+inline void vstore(double *p, vdouble a) { *p = a; }
+inline vdouble vadd(vdouble a, vdouble b) { return a + b; }
+inline vdouble vsub(vdouble a, vdouble b) { return a - b; }
+inline vdouble vmul(vdouble a, vdouble b) { return a * b; }
+inline vdouble vdiv(vdouble a, vdouble b) { return a / b; }
+inline vdouble vsqrt(vdouble a) { return std::sqrt(a); }
+inline vdouble vmin(vdouble a, vdouble b) { return a < b ? a : b; }
+inline vdouble vmax(vdouble a, vdouble b) { return a > b ? a : b; }
+inline vmask vlt(vdouble a, vdouble b) { return a < b; }
+inline vmask vle(vdouble a, vdouble b) { return a <= b; }
+inline vmask vgt(vdouble a, vdouble b) { return a > b; }
+inline vmask vge(vdouble a, vdouble b) { return a >= b; }
+inline vmask vand(vmask a, vmask b) { return a && b; }
+inline vmask vor(vmask a, vmask b) { return a || b; }
+inline vdouble vselect(vmask m, vdouble a, vdouble b) { return m ? a : b; }
+inline unsigned vbits(vmask m) { return m ? 1u : 0u; }
+inline vmask vmaskFromBits(unsigned bits) { return (bits & 1) != 0; }
+
+#endif
+
+const unsigned SIMD_LANES = (1u << SIMD_WIDTH) - 1;		//!< vbits of a mask with every lane set.
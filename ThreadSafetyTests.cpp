@@ -0,0 +1,121 @@
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <random>
+#include "Defs.h"
+#include "IShape.h"
+#include "IScene.h"
+#include "Camera.h"
+
+/**
+ * Fires the same rays at the same scene from many threads at once and checks every
+ * result against a serial reference. The scene contains one or more of every kind
+ * of implicit shape, and each ray is traced both with a linear scan and the BVH.
+ */
+
+const int NUM_RAYS = 100000;
+const int NUM_ROUNDS = 3;
+
+bool sameHit(const HitRecord &a, const HitRecord &b) {
+	return a.t == b.t && a.interceptPt == b.interceptPt && a.normal == b.normal;
+}
+
+void buildScene(IScene &scene) {
+	scene.addOpaqueObject(new VisibleIShape(new IPlane(dvec3(0, -10, 0), Y_AXIS), tin));
+	scene.addOpaqueObject(new VisibleIShape(new IPlane(dvec3(0, 0, -30), Z_AXIS), copper));
+	for (int i = 0; i < 5; i++) {
+		double x = -8.0 + 4.0 * i;
+		scene.addOpaqueObject(new VisibleIShape(new ISphere(dvec3(x, 4, 0), 1.5), gold));
+		scene.addOpaqueObject(new VisibleIShape(new ICylinderY(dvec3(x, 0, -4), 1.0, 2.0), silver));
+		scene.addOpaqueObject(new VisibleIShape(new IClosedCylinderY(dvec3(x, 0, 4), 1.0, 2.0), brass));
+		scene.addOpaqueObject(new VisibleIShape(new ICylinderZ(dvec3(x, -4, 0), 0.75, 1.5), bronze));
+		scene.addOpaqueObject(new VisibleIShape(new IEllipsoid(dvec3(x, 8, -2), dvec3(1.5, 0.75, 1.0)), pewter));
+		scene.addOpaqueObject(new VisibleIShape(new IDisk(dvec3(x, -7, 2), glm::normalize(dvec3(1, 1, 1)), 1.25), chrome));
+		scene.addOpaqueObject(new VisibleIShape(new ITriangle(dvec3(x, 1, 8), dvec3(x + 2, 1, 8), dvec3(x + 1, 3, 7)), redPlastic));
+	}
+	scene.addTransparentObject(new VisibleIShape(new ISphere(dvec3(0, 0, 12), 3.0), cyanPlastic), 0.5);
+}
+
+vector<Ray> makeRays(int N) {
+	std::mt19937 rng(386);
+	std::uniform_real_distribution<double> U(-1.0, 1.0);
+	vector<Ray> rays;
+	for (int i = 0; i < N; i++) {
+		dvec3 origin(20.0 * U(rng), 20.0 * U(rng), 20.0 + 5.0 * U(rng));
+		dvec3 target(10.0 * U(rng), 10.0 * U(rng), 10.0 * U(rng));
+		rays.push_back(Ray(origin, glm::normalize(target - origin)));
+	}
+	return rays;
+}
+
+int main(int argc, char *argv[]) {
+	PerspectiveCamera camera(dvec3(0, 0, 25), ORIGIN3D, Y_AXIS, PI_2);
+	IScene scene(&camera);
+	buildScene(scene);
+	const BVH &bvh = scene.getOpaqueBVH();
+	const BVH &transparentBVH = scene.getTransparentBVH();
+
+	vector<Ray> rays = makeRays(NUM_RAYS);
+	vector<HitRecord> reference(NUM_RAYS);
+	vector<HitRecord> transparentReference(NUM_RAYS);
+	int numHits = 0;
+	for (int i = 0; i < NUM_RAYS; i++) {
+		reference[i] = VisibleIShape::findIntersection(rays[i], scene.opaqueObjs);
+		transparentReference[i] = VisibleIShape::findIntersection(rays[i], scene.transparentObjs);
+		if (reference[i].t < FLT_MAX) {
+			numHits++;
+		}
+	}
+
+	int numThreads = std::max(8, (int)std::thread::hardware_concurrency());
+	std::atomic<long long> numRays(0);
+	std::atomic<long long> numMismatches(0);
+	std::atomic<int> numDebugMismatches(0);
+	vector<std::thread> threads;
+	for (int id = 0; id < numThreads; id++) {
+		threads.push_back(std::thread([&, id] {
+			long long mismatches = 0;
+			for (int round = 0; round < NUM_ROUNDS; round++) {
+				// Each thread walks the rays in a different order so that threads
+				// hit the same shapes with different rays at the same time.
+				for (int k = 0; k < NUM_RAYS; k++) {
+					int i = (int)((k * 7919LL + id * 104729LL + round) % NUM_RAYS);
+					DEBUG_PIXEL = (i % numThreads == id);
+					const Ray &ray = rays[i];
+					HitRecord linearHit = VisibleIShape::findIntersection(ray, scene.opaqueObjs);
+					HitRecord bvhHit = bvh.findIntersection(ray);
+					HitRecord transparentHit = transparentBVH.findIntersection(ray);
+					if (!sameHit(linearHit, reference[i]) || !sameHit(bvhHit, reference[i]) ||
+						!sameHit(transparentHit, transparentReference[i])) {
+						mismatches++;
+					}
+					if (DEBUG_PIXEL != (i % numThreads == id)) {
+						numDebugMismatches++;
+					}
+				}
+			}
+			numRays += (long long)NUM_ROUNDS * NUM_RAYS * 3;
+			numMismatches += mismatches;
+		}));
+	}
+	for (std::thread &t : threads) {
+		t.join();
+	}
+
+	cout << "Threads: " << numThreads << endl;
+	cout << "Rays traced: " << numRays << endl;
+	cout << "Reference hits: " << numHits << " of " << NUM_RAYS << endl;
+	cout << "Mismatches: " << numMismatches << endl;
+	cout << "DEBUG_PIXEL mismatches: " << numDebugMismatches << endl;
+	cout << (numMismatches == 0 && numDebugMismatches == 0 ? "PASSED" : "FAILED") << endl;
+	return (numMismatches == 0 && numDebugMismatches == 0) ? 0 : 1;
+}
+
+/*
+Threads: 8
+Rays traced: 7200000
+Reference hits: 100000 of 100000
+Mismatches: 0
+DEBUG_PIXEL mismatches: 0
+PASSED
+*/
@@ -0,0 +1,194 @@
+/****************************************************
+ * 2016-2020 Eric Bachmann and Mike Zmuda
+ * All Rights Reserved.
+ * NOTICE:
+ * Dissemination of this information or reproduction
+ * of this material is prohibited unless prior written
+ * permission is granted..
+ ****************************************************/
+
+#include <algorithm>
+#include "TileScheduler.h"
+
+/**
+ * @fn	vector<Tile> Tile::makeTiles(int width, int height, int tileSize)
+ * @brief	Splits a width x height window into tiles, row by row. Tiles on the
+ * 			right and top edges may be smaller than tileSize.
+ * @param	width   	Width of the window.
+ * @param	height  	Height of the window.
+ * @param	tileSize	Width and height of a full tile.
+ * @return	The tiles covering the window.
+ */
+
+vector<Tile> Tile::makeTiles(int width, int height, int tileSize) {
+	vector<Tile> tiles;
+	tileSize = std::max(1, tileSize);
+	for (int y = 0; y < height; y += tileSize) {
+		for (int x = 0; x < width; x += tileSize) {
+			Tile tile;
+			tile.x0 = x;
+			tile.y0 = y;
+			tile.x1 = std::min(x + tileSize, width);
+			tile.y1 = std::min(y + tileSize, height);
+			tiles.push_back(tile);
+		}
+	}
+	return tiles;
+}
+
+/**
+ * @fn	int TileScheduler::defaultNumThreads()
+ * @brief	The number of hardware threads available, or 1 if that is unknown.
+ * @return	The default number of worker threads.
+ */
+
+int TileScheduler::defaultNumThreads() {
+	return std::max(1, (int)std::thread::hardware_concurrency());
+}
+
+/**
+ * @fn	TileScheduler::TileScheduler(int numThreads)
+ * @brief	Creates a scheduler and starts its worker threads.
+ * @param	numThreads	Total number of workers, including the calling thread.
+ * 						Values less than 1 select defaultNumThreads().
+ */
+
+TileScheduler::TileScheduler(int numThreads)
+	: currentTiles(nullptr), currentWork(nullptr),
+		generation(0), busyWorkers(0), shuttingDown(false) {
+	if (numThreads < 1) {
+		numThreads = defaultNumThreads();
+	}
+	for (int i = 0; i < numThreads; i++) {
+		queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+	}
+	for (int i = 1; i < numThreads; i++) {
+		threads.push_back(std::thread(&TileScheduler::workerLoop, this, i));
+	}
+}
+
+/**
+ * @fn	TileScheduler::~TileScheduler()
+ * @brief	Stops and joins the worker threads.
+ */
+
+TileScheduler::~TileScheduler() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		shuttingDown = true;
+	}
+	workReady.notify_all();
+	for (std::thread &t : threads) {
+		t.join();
+	}
+}
+
+/**
+ * @fn	void TileScheduler::run(const vector<Tile> &tiles, const TileWork &work)
+ * @brief	Applies work to every tile and returns once all tiles are done. Each tile
+ * 			is processed exactly once, by exactly one worker.
+ * @param	tiles	The tiles to process.
+ * @param	work 	The work to do for each tile.
+ */
+
+void TileScheduler::run(const vector<Tile> &tiles, const TileWork &work) {
+	const int N = getNumThreads();
+	const int numTiles = (int)tiles.size();
+	for (int w = 0; w < N; w++) {
+		WorkQueue &queue = *queues[w];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tileIndices.clear();
+		for (int i = w * numTiles / N; i < (w + 1) * numTiles / N; i++) {
+			queue.tileIndices.push_back(i);
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		currentTiles = &tiles;
+		currentWork = &work;
+		busyWorkers = N - 1;
+		generation++;
+	}
+	workReady.notify_all();
+
+	processTiles(0);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	workDone.wait(lock, [this] { return busyWorkers == 0; });
+	currentTiles = nullptr;
+	currentWork = nullptr;
+}
+
+/**
+ * @fn	void TileScheduler::workerLoop(int workerID)
+ * @brief	Body of each worker thread: wait for a run to start, help with it, repeat.
+ * @param	workerID	This worker's index.
+ */
+
+void TileScheduler::workerLoop(int workerID) {
+	int lastGeneration = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			workReady.wait(lock, [&] { return shuttingDown || generation != lastGeneration; });
+			if (shuttingDown) {
+				return;
+			}
+			lastGeneration = generation;
+		}
+
+		processTiles(workerID);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			busyWorkers--;
+		}
+		workDone.notify_one();
+	}
+}
+
+/**
+ * @fn	void TileScheduler::processTiles(int workerID)
+ * @brief	Processes tiles until none are left anywhere.
+ * @param	workerID	This worker's index.
+ */
+
+void TileScheduler::processTiles(int workerID) {
+	int tileIndex;
+	while (popOrSteal(workerID, tileIndex)) {
+		(*currentWork)((*currentTiles)[tileIndex], workerID);
+	}
+}
+
+/**
+ * @fn	bool TileScheduler::popOrSteal(int workerID, int &tileIndex)
+ * @brief	Takes the next tile from this worker's own queue. When that is empty,
+ * 			steals from the far end of another worker's queue.
+ * @param 		  	workerID 	This worker's index.
+ * @param [in,out]	tileIndex	The tile to process next.
+ * @return	False iff every queue is empty.
+ */
+
+bool TileScheduler::popOrSteal(int workerID, int &tileIndex) {
+	const int N = getNumThreads();
+	{
+		WorkQueue &own = *queues[workerID];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tileIndices.empty()) {
+			tileIndex = own.tileIndices.front();
+			own.tileIndices.pop_front();
+			return true;
+		}
+	}
+	for (int k = 1; k < N; k++) {
+		WorkQueue &victim = *queues[(workerID + k) % N];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tileIndices.empty()) {
+			tileIndex = victim.tileIndices.back();
+			victim.tileIndices.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,68 @@
+/****************************************************
+ * 2016-2020 Eric Bachmann and Mike Zmuda
+ * All Rights Reserved.
+ * NOTICE:
+ * Dissemination of this information or reproduction
+ * of this material is prohibited unless prior written
+ * permission is granted..
+ ****************************************************/
+
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include "Defs.h"
+
+/**
+ * @struct	Tile
+ * @brief	A rectangular block of pixels, [x0, x1) by [y0, y1).
+ */
+
+struct Tile {
+	int x0, y0;		//!< lower left corner (inclusive)
+	int x1, y1;		//!< upper right corner (exclusive)
+	int area() const { return (x1 - x0) * (y1 - y0); }
+	static vector<Tile> makeTiles(int width, int height, int tileSize);
+};
+
+typedef std::function<void(const Tile &tile, int workerID)> TileWork;
+
+/**
+ * @struct	TileScheduler
+ * @brief	A pool of worker threads that processes a set of tiles. Each worker
+ * 			starts with its own contiguous share of the tiles and, once that runs
+ * 			out, steals from the other workers' queues. The thread that calls run()
+ * 			acts as worker 0, so a scheduler with one thread runs entirely serially.
+ */
+
+struct TileScheduler {
+	TileScheduler(int numThreads);
+	~TileScheduler();
+	TileScheduler(const TileScheduler &) = delete;
+	TileScheduler &operator = (const TileScheduler &) = delete;
+	int getNumThreads() const { return (int)queues.size(); }
+	void run(const vector<Tile> &tiles, const TileWork &work);
+	static int defaultNumThreads();
+protected:
+	struct WorkQueue {
+		std::mutex mutex;
+		std::deque<int> tileIndices;
+	};
+	void workerLoop(int workerID);
+	void processTiles(int workerID);
+	bool popOrSteal(int workerID, int &tileIndex);
+	vector<std::thread> threads;					//!< Workers 1..N-1; worker 0 is the caller.
+	vector<std::unique_ptr<WorkQueue>> queues;		//!< One queue of tile indices per worker.
+	const vector<Tile> *currentTiles;				//!< Tiles of the run in progress.
+	const TileWork *currentWork;					//!< Work of the run in progress.
+	std::mutex mutex;								//!< Guards the fields below.
+	std::condition_variable workReady;
+	std::condition_variable workDone;
+	int generation;									//!< Incremented at the start of every run.
+	int busyWorkers;								//!< Workers that have not finished the current run.
+	bool shuttingDown;
+};
@@ -1336,9 +1336,10 @@ string extractBaseFilename(const string &str) {
 	return str.substr(pos + 1);
 }
 
-bool DEBUG_PIXEL = false;
+thread_local bool DEBUG_PIXEL = false;
 int xDebug = -1, yDebug = -1;
 
+#ifndef HEADLESS
 void mouseUtility(int b, int s, int x, int y) {
 	if (b == GLUT_RIGHT_BUTTON && s == GLUT_DOWN) {
 		xDebug = x;
@@ -1361,3 +1362,4 @@ void graphicsInit(int argc, char *argv [], const std::string &windowName) {
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     glPixelStorei(GL_PACK_ALIGNMENT, 1);
 }
+#endif
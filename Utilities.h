@@ -15,9 +15,11 @@
 #include "Defs.h"
 #include "ColorAndMaterials.h"
 
-extern bool DEBUG_PIXEL;
+extern thread_local bool DEBUG_PIXEL;	// Each thread tracks the pixel it is working on.
 extern int xDebug, yDebug;
+#ifndef HEADLESS
 void mouseUtility(int, int, int, int);
+#endif
 
 // Simple streaming for vectors and matrices.
 ostream &operator << (ostream &os, const dvec2 &v);
@@ -208,4 +210,6 @@ void addAll(vector<T> &vec, const vector<T> &newItems) {
 	}
 }
 
+#ifndef HEADLESS
 void graphicsInit(int argc, char *argv [], const std::string &fileName);
+#endif
@@ -7,8 +7,10 @@
  * permission is granted..
  ****************************************************/
 
+#include <algorithm>
 #include "Defs.h"
 #include "VertexOps.h"
+#include "RenderStats.h"
 
 // Pipeline transformation matrices
 dmat4 VertexOps::modelingTrans;
@@ -16,6 +18,7 @@ dmat4 VertexOps::viewingTrans;
 dmat4 VertexOps::projectionTrans;
 dmat4 VertexOps::viewportTrans;
 bool VertexOps::renderBackFaces = true;
+BinnedRasterizer *VertexOps::binnedRasterizer = nullptr;
 
 const BoundingBox3D VertexOps::ndc(-1, 1, -1, 1, -1, 1);	//l,r,b,t,n,f
 BoundingBoxi VertexOps::viewport(0, WINDOW_WIDTH - 1, 0, WINDOW_HEIGHT - 1);
@@ -31,61 +34,110 @@ vector<IPlane> VertexOps::allButNearNDCPlanes{ IPlane(dvec3(1, 0, 0), dvec3(-1,
 										};
 
 /**
- * @fn	vector<VertexData> triangulate(const vector<VertexData> &poly)
- * @brief	Triangulates the given polygon
- * @param	poly	The polygon to be decomposed into individual triangles.
- * @return	A vector of triangles, which comprise the original polygon.
+ * @fn	VertexOps::Scratch &VertexOps::scratch()
+ * @brief	Gets the calling thread's scratch buffers.
+ * @return	The buffers.
  */
 
-vector<VertexData> triangulate(const vector<VertexData> &poly) {
-	vector<VertexData> triangles;
-
-	for (unsigned int i = 1; i < poly.size() - 1; i++) {
-		triangles.push_back(poly[0]);
-		triangles.push_back(poly[i]);
-		triangles.push_back(poly[i + 1]);
-	}
-
-	return triangles;
+VertexOps::Scratch &VertexOps::scratch() {
+	static thread_local Scratch buffers;
+	return buffers;
 }
 
 /**
- * @fn	vector<VertexData> VertexOps::clipAgainstPlane(vector<VertexData> &verts, const IPlane &plane)
+ * @fn	void VertexOps::clipAgainstPlane(const vector<VertexData> &verts, const IPlane &plane, vector<VertexData> &output)
  * @brief	Clips a polygon against a single plane
- * @param [in,out]	verts	The array of vertices.
- * @param 		  	plane	The plane that will do the clipping.
- * @return	The polygon that exludes the portions outside the given plane.
+ * @param 		  	verts 	The polygon's vertices.
+ * @param 		  	plane 	The plane that will do the clipping.
+ * @param [in,out]	output	Replaced by the polygon that excludes the portions outside the given plane.
  */
 
-vector<VertexData> VertexOps::clipAgainstPlane(vector<VertexData> &verts, const IPlane &plane) {
-	vector<VertexData> output;
-
-	if (verts.size() > 2) {
-		verts.push_back(verts[0]);
+void VertexOps::clipAgainstPlane(const vector<VertexData> &verts, const IPlane &plane,
+									vector<VertexData> &output) {
+	output.clear();
 
-		for (unsigned int i = 1; i < verts.size(); i++) {
-			bool v0In = plane.onFrontSide(verts[i - 1].pos.xyz());
-			bool v1In = plane.onFrontSide(verts[i].pos.xyz());
+	const size_t N = verts.size();
+	if (N > 2) {
+		for (size_t i = 1; i <= N; i++) {
+			const VertexData &v0 = verts[i - 1];
+			const VertexData &v1 = verts[i % N];
+			bool v0In = plane.onFrontSide(v0.pos.xyz());
+			bool v1In = plane.onFrontSide(v1.pos.xyz());
 
 			if (v0In && v1In) {
-				output.push_back(verts[i]);
+				output.push_back(v1);
 			} else if (v0In || v1In) {
 				double t;
-				plane.findIntersection(verts[i - 1].pos.xyz(), verts[i].pos.xyz(), t);
-				VertexData I(1.0 - t, verts[i - 1], t, verts[i]);
-				output.push_back(I);
+				plane.findIntersection(v0.pos.xyz(), v1.pos.xyz(), t);
+				output.push_back(VertexData(1.0 - t, v0, t, v1));
 				if (!v0In && v1In) {
-					output.push_back(verts[i]);
+					output.push_back(v1);
 				}
 			}
 		}
 	}
-	return output;
+}
+
+/**
+ * @fn	bool VertexOps::onFrontSide(const vector<VertexData> &verts, const IPlane &plane)
+ * @brief	Determines if a polygon lies entirely on the front side of a plane.
+ * @param	verts	The polygon's vertices.
+ * @param	plane	The plane.
+ * @return	True iff every vertex is on the front side.
+ */
+
+bool VertexOps::onFrontSide(const vector<VertexData> &verts, const IPlane &plane) {
+	for (const VertexData &v : verts) {
+		if (!plane.onFrontSide(v.pos.xyz())) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @fn	bool VertexOps::clipTriangle(const VertexData &v0, const VertexData &v1, const VertexData &v2, const IPlane *planes, int numPlanes, vector<VertexData> &triangles)
+ * @brief	Clips a triangle against planes, and appends what is left of it, fanned
+ * 			into triangles, to a list of triangles. A plane that has the whole
+ * 			polygon on its front side is skipped.
+ * @param 		  	v0		 	The triangle's first vertex.
+ * @param 		  	v1		 	The triangle's second vertex.
+ * @param 		  	v2		 	The triangle's third vertex.
+ * @param 		  	planes   	The planes to clip against.
+ * @param 		  	numPlanes	The number of planes.
+ * @param [in,out]	triangles	The list of triangles.
+ * @return	True if some plane cut or removed the triangle.
+ */
+
+bool VertexOps::clipTriangle(const VertexData &v0, const VertexData &v1, const VertexData &v2,
+								const IPlane *planes, int numPlanes, vector<VertexData> &triangles) {
+	Scratch &buffers = scratch();
+	vector<VertexData> &polygon = buffers.polygon;
+	polygon.clear();
+	polygon.push_back(v0);
+	polygon.push_back(v1);
+	polygon.push_back(v2);
+
+	bool clipped = false;
+	for (int p = 0; p < numPlanes; p++) {
+		if (!onFrontSide(polygon, planes[p])) {
+			clipAgainstPlane(polygon, planes[p], buffers.clipped);
+			polygon.swap(buffers.clipped);
+			clipped = true;
+		}
+	}
+	for (size_t i = 1; i + 1 < polygon.size(); i++) {
+		triangles.push_back(polygon[0]);
+		triangles.push_back(polygon[i]);
+		triangles.push_back(polygon[i + 1]);
+	}
+	return clipped;
 }
 
 /**
  * @fn	vector<VertexData> VertexOps::clipPolygon(const vector<VertexData> &clipCoords)
- * @brief	Clip polygon against the normalized view volumn - 2x2x2 cube.
+ * @brief	Clip polygon against the normalized view volumn - 2x2x2 cube. Every
+ * 			triangle that some plane cuts or removes is counted as TRIANGLES_CLIPPED.
  * @param	clipCoords	The array of triangles.
  * @param	planes		Planes to clip against
  * @return	The array of triangles, after performing clipping.
@@ -95,27 +147,84 @@ vector<VertexData> VertexOps::clipPolygon(const vector<VertexData> &clipCoords,
 											const vector<IPlane> &planes) {
 	vector<VertexData> ndcCoords;
 
-	if (clipCoords.size() > 2) {
-		for (unsigned int i = 0; i < clipCoords.size() - 2; i += 3) {
-			vector<VertexData> polygon;
-			polygon.push_back(clipCoords[i]);
-			polygon.push_back(clipCoords[i + 1]);
-			polygon.push_back(clipCoords[i + 2]);
-
-			for (IPlane plane : planes) {
-				polygon = clipAgainstPlane(polygon, plane);
-			}
-			if (polygon.size() > 3) {
-				polygon = triangulate(polygon);
-			}
-			for (VertexData v : polygon) {
-				ndcCoords.push_back(v);
-			}
+	for (size_t i = 0; i + 2 < clipCoords.size(); i += 3) {
+		if (clipTriangle(clipCoords[i], clipCoords[i + 1], clipCoords[i + 2],
+							planes.data(), (int)planes.size(), ndcCoords)) {
+			RenderStats::count(TRIANGLES_CLIPPED);
 		}
 	}
 	return ndcCoords;
 }
 
+/**
+ * @fn	BoundingBoxd VertexOps::guardBand()
+ * @brief	Gets the guard band of the current viewport: the normalized device
+ * 			coordinates that map to window coordinates within GUARD_BAND.
+ * @return	The guard band, in normalized device coordinates.
+ */
+
+BoundingBoxd VertexOps::guardBand() {
+	double halfWidth = std::max(1, viewport.width()) / 2.0;
+	double halfHeight = std::max(1, viewport.height()) / 2.0;
+	return BoundingBoxd((-GUARD_BAND - viewport.lx) / halfWidth - 1.0, (GUARD_BAND - viewport.lx) / halfWidth - 1.0,
+						(-GUARD_BAND - viewport.ly) / halfHeight - 1.0, (GUARD_BAND - viewport.ly) / halfHeight - 1.0);
+}
+
+/**
+ * @fn	int VertexOps::outcode(const dvec4 &pos, const BoundingBoxd &guard)
+ * @brief	Computes the outcode of a vertex. The near plane is left out, as
+ * 			triangles are clipped against it before projection.
+ * @param	pos  	The vertex, in normalized device coordinates.
+ * @param	guard	The guard band.
+ * @return	The Outcode bits of the sides the vertex is outside.
+ */
+
+int VertexOps::outcode(const dvec4 &pos, const BoundingBoxd &guard) {
+	int code = (pos.x < ndc.lx ? OUT_LEFT : 0) | (pos.x > ndc.rx ? OUT_RIGHT : 0) |
+				(pos.y < ndc.ly ? OUT_BOTTOM : 0) | (pos.y > ndc.ry ? OUT_TOP : 0) |
+				(pos.z > ndc.lz ? OUT_FAR : 0);		// ndc keeps the far plane, z = 1, in lz
+	if (!(pos.x >= guard.lx && pos.x <= guard.rx && pos.y >= guard.ly && pos.y <= guard.ry)) {
+		code |= OUT_GUARD_BAND;
+	}
+	return code;
+}
+
+/**
+ * @fn	void VertexOps::clipTriangles(const vector<VertexData> &ndcCoords, const BoundingBoxd &guard, vector<VertexData> &triangles, vector<char> &clipped)
+ * @brief	Clips triangles against the view volume, using outcodes to skip the
+ * 			work wherever possible. A triangle with all its vertices outside one
+ * 			side is dropped, and one inside the view volume is kept as it is. So
+ * 			is one that only crosses the left, right, bottom or top sides within
+ * 			the guard band: the rasterizer's scissor removes what lies off the
+ * 			viewport. Only triangles crossing the far plane or the guard band are
+ * 			clipped against the planes; those and the dropped ones are marked in
+ * 			clipped, so that the caller can count each triangle it submitted once.
+ * @param 		  	ndcCoords	The triangles, in normalized device coordinates.
+ * @param 		  	guard	 	The guard band.
+ * @param [in,out]	triangles	The list the remaining triangles are appended to.
+ * @param [in,out]	clipped  	For each triangle, 1 if it was cut or dropped, 0 otherwise.
+ */
+
+void VertexOps::clipTriangles(const vector<VertexData> &ndcCoords, const BoundingBoxd &guard,
+								vector<VertexData> &triangles, vector<char> &clipped) {
+	clipped.assign(ndcCoords.size() / 3, 0);
+	for (size_t i = 0; i + 2 < ndcCoords.size(); i += 3) {
+		int c0 = outcode(ndcCoords[i].pos, guard);
+		int c1 = outcode(ndcCoords[i + 1].pos, guard);
+		int c2 = outcode(ndcCoords[i + 2].pos, guard);
+		if ((c0 & c1 & c2 & OUT_VIEW_VOLUME) != 0) {
+			clipped[i / 3] = 1;
+		} else if (((c0 | c1 | c2) & (OUT_FAR | OUT_GUARD_BAND)) == 0) {
+			triangles.push_back(ndcCoords[i]);
+			triangles.push_back(ndcCoords[i + 1]);
+			triangles.push_back(ndcCoords[i + 2]);
+		} else {
+			clipped[i / 3] = clipTriangle(ndcCoords[i], ndcCoords[i + 1], ndcCoords[i + 2],
+											allButNearNDCPlanes.data(), (int)allButNearNDCPlanes.size(), triangles);
+		}
+	}
+}
+
 /**
  * @fn	vector<VertexData> VertexOps::clipLineSegments(const vector<VertexData> &clipCoords)
  * @brief	Clip line segments against normalized view volume.
@@ -163,18 +272,39 @@ vector<VertexData> VertexOps::clipLineSegments(const vector<VertexData> &clipCoo
 	return ndcCoords;
 }
 
- /**
- * @fn	vector<VertexData> VertexOps::processBackwardFacingTriangles(const vector<VertexData> &triangleVerts)
- * @brief	Removes the backward facing triangles
- * @param	triangleVerts	The vector of triangle vertices.
- * @return	Vector of triangle vertices, without those facing backward.
+/**
+ * @fn	void VertexOps::processBackwardFacingTriangles(vector<VertexData> &triangleVerts)
+ * @brief	Removes the backward facing triangles, unless renderBackFaces is set. A
+ * 			triangle faces backward if its vertices wind clockwise on the screen.
+ * 			The triangles are in eye coordinates, before any clipping, so a
+ * 			culled triangle costs nothing further. The winding is the sign of
+ * 			the determinant of the vertices' clip coordinates x, y and w, which is
+ * 			right for perspective and parallel projections alike, and for
+ * 			triangles reaching behind the eye.
+ * @param [in,out]	triangleVerts	The vector of triangle vertices, in eye coordinates.
  */
 
-vector<VertexData> VertexOps::processBackwardFacingTriangles(const vector<VertexData> &triangleVerts) {
-	/* CSE 386 - todo  */
-	vector<VertexData> triangles;
-	triangles = triangleVerts;
-	return triangles;
+void VertexOps::processBackwardFacingTriangles(vector<VertexData> &triangleVerts) {
+	if (renderBackFaces) {
+		return;
+	}
+	size_t numKept = 0;
+	for (size_t i = 0; i + 2 < triangleVerts.size(); i += 3) {
+		dvec4 A = projectionTrans * triangleVerts[i].pos;
+		dvec4 B = projectionTrans * triangleVerts[i + 1].pos;
+		dvec4 C = projectionTrans * triangleVerts[i + 2].pos;
+		double winding = glm::dot(dvec3(A.x, A.y, A.w),
+									glm::cross(dvec3(B.x, B.y, B.w), dvec3(C.x, C.y, C.w)));
+		if (winding > 0.0) {
+			if (numKept != i) {
+				triangleVerts[numKept] = triangleVerts[i];
+				triangleVerts[numKept + 1] = triangleVerts[i + 1];
+				triangleVerts[numKept + 2] = triangleVerts[i + 2];
+			}
+			numKept += 3;
+		}
+	}
+	triangleVerts.erase(triangleVerts.begin() + numKept, triangleVerts.end());
 }
 
 /**
@@ -234,6 +364,13 @@ double computeNearPlane(const dmat4 &PM) {
 /**
  * @fn	void VertexOps::processTriangleVertices(FrameBuffer &frameBuffer, const dvec3 &eyePos, const vector<LightSourcePtr> &lights, const vector<VertexData> &objectCoords)
  * @brief	Transforms the triangle vertices through pipeline: object -> world -> eye -> clip/ndc -> window.
+ * 			The triangles are then drawn, or binned if binnedRasterizer is set.
+ * 			They go through in batches of TRIANGLE_BATCH_SIZE, each batch passing
+ * 			every stage in the calling thread's scratch buffers before the next
+ * 			one starts. Triangles crossing the viewport's edges within the guard
+ * 			band are not clipped but scissored to the viewport as they are drawn.
+ * 			A triangle that the near plane and then the view volume both cut is
+ * 			counted once as TRIANGLES_CLIPPED.
  * @param [in,out]	frameBuffer 	Buffer for frame data.
  * @param 		  	eyePos			The eye position.
  * @param 		  	lights			The lights.
@@ -243,39 +380,75 @@ double computeNearPlane(const dmat4 &PM) {
 void VertexOps::processTriangleVertices(FrameBuffer &frameBuffer, const dvec3 &eyePos,
 										const vector<LightSourcePtr> &lights,
 										const vector<VertexData> &objectCoords) {
-	vector<VertexData> worldCoords = transformVerticesToWorldCoordinates(modelingTrans, objectCoords);
-	vector<VertexData> eyeCoords = transformVertices(viewingTrans, worldCoords);
+	RenderStats::count(TRIANGLES_SUBMITTED, objectCoords.size() / 3);
 
-	double nearZ = computeNearPlane(VertexOps::projectionTrans);
-	vector <IPlane> nearPlane = { IPlane(dvec4(0.0, 0.0, nearZ, 1.0), -Z_AXIS) };
-	vector<VertexData> eyeCoordsClippedOnNearPlane = clipPolygon(eyeCoords, nearPlane);
+	// Create 3 x 3 matrix for transforming normal vectors to world coordinates
+	const dmat3 modelingTransformationForNormals = glm::transpose(glm::inverse(dmat3(modelingTrans)));
+	const IPlane nearPlane(dvec4(0.0, 0.0, computeNearPlane(projectionTrans), 1.0), -Z_AXIS);
+	const BoundingBoxd guard = guardBand();
+	auto toEyeCoords = [&](const VertexData &v) {
+		dvec4 worldPos = modelingTrans * v.pos;
+		return VertexData(viewingTrans * worldPos, modelingTransformationForNormals * v.normal,
+							v.material, worldPos.xyz());
+	};
+
+	Scratch &buffers = scratch();
+	vector<VertexData> &eyeCoords = buffers.eyeCoords;
+	vector<VertexData> &clipCoords = buffers.clipCoords;
+	vector<VertexData> &windowCoords = buffers.windowCoords;
+	vector<int> &sources = buffers.sources;
+	vector<char> &eyeClipped = buffers.eyeClipped;
+	const size_t numVerts = objectCoords.size() - objectCoords.size() % 3;
+	for (size_t batch = 0; batch < numVerts; batch += 3 * TRIANGLE_BATCH_SIZE) {
+		const size_t batchEnd = std::min(numVerts, batch + 3 * TRIANGLE_BATCH_SIZE);
+
+		eyeCoords.clear();
+		for (size_t i = batch; i < batchEnd; i++) {
+			eyeCoords.push_back(toEyeCoords(objectCoords[i]));
+		}
 
-	vector<VertexData> projCoords = transformVertices(projectionTrans, eyeCoordsClippedOnNearPlane);
-	vector<VertexData> clipCoords;
+		size_t numFacing = eyeCoords.size();
+		processBackwardFacingTriangles(eyeCoords);
+		RenderStats::count(TRIANGLES_CULLED, (numFacing - eyeCoords.size()) / 3);
+
+		clipCoords.clear();
+		sources.clear();
+		eyeClipped.assign(eyeCoords.size() / 3, 0);
+		for (size_t i = 0; i + 2 < eyeCoords.size(); i += 3) {
+			size_t numBefore = clipCoords.size();
+			eyeClipped[i / 3] = clipTriangle(eyeCoords[i], eyeCoords[i + 1], eyeCoords[i + 2], &nearPlane, 1, clipCoords);
+			sources.insert(sources.end(), (clipCoords.size() - numBefore) / 3, (int)(i / 3));
+		}
 
-	for (VertexData v : projCoords) {		// Perspective division
-		if (v.pos.w >= 0) {
-			v.pos /= v.pos.w;
-		} else {							// should not happen
-			v.pos.x /= -v.pos.w;
-			v.pos.y /= -v.pos.w;
-			v.pos.z = -std::abs(v.pos.z/-v.pos.w);
-			v.pos.w = 1.0;
+		for (VertexData &v : clipCoords) {		// Projection and perspective division
+			v.pos = projectionTrans * v.pos;
+			if (v.pos.w >= 0) {
+				v.pos /= v.pos.w;
+			} else {							// should not happen
+				v.pos.x /= -v.pos.w;
+				v.pos.y /= -v.pos.w;
+				v.pos.z = -std::abs(v.pos.z/-v.pos.w);
+				v.pos.w = 1.0;
+			}
 		}
-		clipCoords.push_back(v);
-	}
 
-	clipCoords = processBackwardFacingTriangles(clipCoords);	
+		windowCoords.clear();
+		clipTriangles(clipCoords, guard, windowCoords, buffers.viewClipped);
+		for (size_t k = 0; k < sources.size(); k++) {
+			eyeClipped[sources[k]] |= buffers.viewClipped[k];
+		}
+		RenderStats::count(TRIANGLES_CLIPPED, std::count(eyeClipped.begin(), eyeClipped.end(), 1));
 
-	vector<VertexData> ndcCoords = clipPolygon(clipCoords, allButNearNDCPlanes);
-	vector<VertexData> windowCoords = transformVertices(viewportTrans, ndcCoords);
+		for (VertexData &vd : windowCoords) {
+			vd.pos = viewportTrans * vd.pos;
+		}
 
-	for (VertexData &vd : windowCoords) {
-		vd.pos.x = glm::clamp(vd.pos.x, (double)viewport.lx, (double)viewport.rx);
-		vd.pos.y = glm::clamp(vd.pos.y, (double)viewport.ly, (double)viewport.ry);
+		if (binnedRasterizer != nullptr) {
+			binnedRasterizer->addTriangles(frameBuffer, eyePos, lights, windowCoords, viewingTrans, viewport);
+		} else {
+			drawManyFilledTriangles(frameBuffer, eyePos, lights, windowCoords, viewingTrans, viewport);
+		}
 	}
-
-	drawManyFilledTriangles(frameBuffer, eyePos, lights, windowCoords, viewingTrans);
 }
 
 /**
@@ -15,6 +15,7 @@
 #include "VertexData.h"
 #include "IScene.h"
 #include "Rasterization.h"
+#include "BinnedRasterizer.h"
 
 /**
  * @class	VertexOps
@@ -23,11 +24,17 @@
 
 class VertexOps {
 public:
-	static bool renderBackFaces;	//!< Typically false for closed body objects (e.g., sphere).
+	static const int TRIANGLE_BATCH_SIZE = 64;	//!< Triangles taken through the pipeline together.
+	static const int GUARD_BAND = 8192;			//!< Window coordinates, in pixels, within which triangles are
+												//!< drawn unclipped. The rasterizer is exact well beyond it.
+	static bool renderBackFaces;	//!< Typically false for closed body objects (e.g., sphere). If
+									//!< false, triangles wound clockwise on the screen are culled.
 	static dmat4 modelingTrans;		//!< Used to orient/scale/position objects. Changed often.
 	static dmat4 viewingTrans;		//!< Orient/position camera.
 	static dmat4 projectionTrans;	//!< Define projection. Typically set just once.
 	static dmat4 viewportTrans;		//!< Controls where NDCs map onto window.
+	static BinnedRasterizer *binnedRasterizer;	//!< If set, filled triangles are binned into it and
+												//!< drawn by its flush(), instead of drawn at once.
 
 	static const BoundingBox3D ndc;		//!< normalized device coordinate; the limits
 
@@ -50,13 +57,48 @@ public:
 	static void setViewport(const BoundingBoxi &vp);
 	static BoundingBoxi viewport;			//!< the currently active viewport
 protected:
+	/**
+	 * @struct	Scratch
+	 * @brief	The buffers one thread's triangles pass through. They are reused from
+	 * 			batch to batch and call to call, so once they have grown to fit,
+	 * 			the triangle pipeline allocates nothing.
+	 */
+	struct Scratch {
+		vector<VertexData> eyeCoords;		//!< a batch's triangles in eye coordinates
+		vector<VertexData> clipCoords;		//!< the batch's triangles, clipped on the near plane and projected
+		vector<VertexData> windowCoords;	//!< the batch's triangles, ready to draw
+		vector<VertexData> polygon;			//!< the polygon being clipped
+		vector<VertexData> clipped;			//!< the polygon clipped by one more plane
+		vector<int> sources;				//!< for each triangle in clipCoords, the triangle of eyeCoords it came from
+		vector<char> viewClipped;			//!< for each triangle in clipCoords, whether the view volume cut or removed it
+		vector<char> eyeClipped;			//!< for each triangle in eyeCoords, whether any clipping cut or removed it
+	};
+	/**
+	 * @enum	Outcode
+	 * @brief	The bits telling which sides of the view volume, or of the guard band
+	 * 			around it, a vertex in normalized device coordinates lies outside.
+	 */
+	enum Outcode {
+		OUT_LEFT = 1, OUT_RIGHT = 2, OUT_BOTTOM = 4, OUT_TOP = 8, OUT_FAR = 16,
+		OUT_GUARD_BAND = 32,
+		OUT_VIEW_VOLUME = OUT_LEFT | OUT_RIGHT | OUT_BOTTOM | OUT_TOP | OUT_FAR
+	};
+	static Scratch &scratch();
+	static BoundingBoxd guardBand();
+	static int outcode(const dvec4 &pos, const BoundingBoxd &guard);
+	static void clipTriangles(const vector<VertexData> &ndcCoords, const BoundingBoxd &guard,
+								vector<VertexData> &triangles, vector<char> &clipped);
 	static void setViewportTransformation();
-	static vector<VertexData> clipAgainstPlane(vector<VertexData> &verts, const IPlane &plane);
+	static bool onFrontSide(const vector<VertexData> &verts, const IPlane &plane);
+	static void clipAgainstPlane(const vector<VertexData> &verts, const IPlane &plane,
+									vector<VertexData> &output);
+	static bool clipTriangle(const VertexData &v0, const VertexData &v1, const VertexData &v2,
+								const IPlane *planes, int numPlanes, vector<VertexData> &triangles);
 	static vector<VertexData> clipPolygon(const vector<VertexData> &clipCoords,
 											const vector<IPlane> &planes);
 	static vector<VertexData> clipLineSegments(const vector<VertexData> &clipCoords,
 												const vector<IPlane> &planes);
-	static vector<VertexData> processBackwardFacingTriangles(const vector<VertexData> &triangleVerts);
+	static void processBackwardFacingTriangles(vector<VertexData> &triangleVerts);
 	static vector<VertexData> transformVerticesToWorldCoordinates(const dmat4 &modelMatrix, const vector<VertexData> &vertices);
 	static vector<VertexData> transformVertices(const dmat4 &TM, const vector<VertexData> &vertices);
 };
\ No newline at end of file